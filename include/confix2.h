@@ -47,6 +47,7 @@ extern "C"
 /* Emulate stdint.h */
 typedef unsigned char           cfx2_uint8_t;
 typedef unsigned short          cfx2_uint16_t;
+typedef unsigned int            cfx2_uint32_t;
 
 typedef signed char             cfx2_int8_t;
 typedef signed short            cfx2_int16_t;
@@ -62,7 +63,10 @@ typedef signed short            cfx2_int16_t;
 #define cfx2_attrib_not_found   7
 #define cfx2_missing_node_name  8
 #define cfx2_node_not_found     9
-#define cfx2_max_err            10
+#define cfx2_buffer_overflow    10
+#define cfx2_write_error        11
+#define cfx2_bad_format         12
+#define cfx2_max_err            13
 
 /* Callback Reactions */
 typedef int cfx2_Action;
@@ -81,6 +85,27 @@ typedef int cfx2_ResultType;
 #define cfx2_node               1
 #define cfx2_attrib             2
 
+/* Binary Document View Nodes */
+typedef cfx2_uint32_t cfx2_ViewNode;
+#define cfx2_view_root          0
+#define cfx2_no_view_node       ( ( cfx2_ViewNode ) 0xFFFFFFFFu )
+
+/* Frozen Document Nodes */
+typedef cfx2_uint32_t cfx2_FrozenNode;
+#define cfx2_frozen_root        0
+#define cfx2_no_frozen_node     ( ( cfx2_FrozenNode ) 0xFFFFFFFFu )
+
+/* Reader Flags */
+#define cfx2_mapped_input       1   /* cfx2_read_file: map the file instead of buffering it */
+#define cfx2_borrowed_input     2   /* cfx2_read: the document belongs to the caller and is not freed */
+#define cfx2_arena_document     4   /* allocate the whole tree from an arena owned by the root node (see cfx2_remove_child) */
+#define cfx2_use_allocator      8   /* use rd_opt->allocator instead of the global allocator */
+#define cfx2_parallel_input     16  /* cfx2_read: parse large documents on rd_opt->num_threads threads (0: one per processor) */
+
+/* Writer Flags */
+#define cfx2_output_buffer_size 1   /* buffer wr_opt->buffer_size bytes of output (0: none) instead of the default */
+#define cfx2_parallel_output    2   /* write top-level nodes on wr_opt->num_threads threads (0: one per processor) */
+
 /* Clone Flags */
 #define cfx2_clone_recursive    1
 
@@ -96,11 +121,46 @@ typedef int cfx2_ResultType;
 #define cfx2_left_children_first    256
 #define cfx2_right_children_first   512
 
+/* Memory Statistics Categories */
+#define cfx2_mem_node           0   /* node structures */
+#define cfx2_mem_list           1   /* child and attribute lists */
+#define cfx2_mem_string         2   /* names, texts and shared string buffers */
+#define cfx2_mem_arena          3   /* arena blocks */
+#define cfx2_mem_index          4   /* child/attribute indexes and intern tables */
+#define cfx2_mem_input          5   /* buffered input documents and views */
+#define cfx2_mem_parser         6   /* reader scratch memory and parallel parsing fixups */
+#define cfx2_mem_output         7   /* writer buffers and output streams */
+#define cfx2_mem_query          8   /* compiled queries, caches and iterators */
+#define cfx2_mem_other          9
+#define cfx2_mem_categories     10
+#define cfx2_mem_total          cfx2_mem_categories
+
 /* Structures */
+typedef struct cfx2_Arena cfx2_Arena;
+typedef struct cfx2_ChildIndex cfx2_ChildIndex;
+typedef struct cfx2_AttribIndex cfx2_AttribIndex;
+
+/*
+ *  Lists keep their first cfx2_list_local_size bytes of items in the list itself
+ *  (1 attribute or 2 children), so small nodes need no separate blocks for them.
+ *
+ *  API change: lists, and so nodes, must not be copied or moved (by memcpy or struct
+ *  assignment), as items may point into them. Earlier versions allowed this.
+ */
+#define cfx2_list_local_size    16
+
 typedef struct cfx2_List
 {
-    cfx2_uint8_t*   items;
+    cfx2_uint8_t*   items;      /* local.bytes or a block of its own */
     size_t          length;
+    size_t          capacity;   /* in bytes */
+
+    union
+    {
+        void*           align;
+        cfx2_uint8_t    bytes[cfx2_list_local_size];
+    }
+    local;
 }
 cfx2_List;
 
@@ -118,24 +178,98 @@ typedef struct cfx2_Node
     cfx2_List   attributes;
     cfx2_List   children;
     char*       shared;
+    cfx2_Arena* arena;      /* document arena or NULL */
+
+    /* lookup of children and attributes by name, kept for wide nodes as they grow */
+    cfx2_ChildIndex* child_index;
+    cfx2_AttribIndex* attrib_index;
+    struct cfx2_Node* index_parent; /* parent whose child_index lists this node, or NULL */
 }
 cfx2_Node;
 
+/*
+ *  Memory allocator; free must accept any pointer returned by alloc or realloc.
+ *  The global allocator (cfx2_set_allocator) is used for document trees and writer buffers.
+ *  A reader allocator (cfx2_use_allocator) is used for the input, the reader's scratch memory
+ *  and arena documents, and must outlive those.
+ *  Parallel reading and writing call the allocators from several threads at once.
+ */
+typedef struct cfx2_Allocator
+{
+    void* user;
+
+    void* ( *alloc )( void* user, size_t size );
+    void* ( *realloc )( void* user, void* ptr, size_t size );
+    void ( *free )( void* user, void* ptr );
+}
+cfx2_Allocator;
+
+/*
+ *  Allocation counts and live bytes of one memory category (or all of them).
+ *  Blocks allocated while the statistics were disabled are not counted when freed.
+ */
+typedef struct cfx2_MemoryStats
+{
+    size_t allocs, reallocs, frees;
+    size_t live_blocks, live_bytes, peak_bytes;
+}
+cfx2_MemoryStats;
+
+/*
+ *  Memory held by a document (or any subtree), as requested from the allocator.
+ *  used_bytes + index_bytes + wasted_bytes is everything the document holds.
+ *  Strings shared by several attributes are split evenly among them.
+ */
+typedef struct cfx2_DocumentStats
+{
+    size_t nodes, attribs;
+
+    size_t used_bytes;          /* nodes, list items and strings in use */
+    size_t index_bytes;         /* child and attribute indexes, attribute name tables */
+    size_t wasted_bytes;        /* list_slack + buffer_slack + dead_bytes */
+
+    size_t list_slack;          /* unused capacity of attribute and child lists */
+    size_t buffer_slack;        /* unused space at the end of string buffers and arena chunks */
+    size_t dead_bytes;          /* replaced or removed strings (and outgrown arena lists) */
+}
+cfx2_DocumentStats;
+
 /* Option Structures */
 typedef struct cfx2_RdOpt cfx2_RdOpt;
 typedef struct cfx2_WrOpt cfx2_WrOpt;
 
+typedef struct cfx2_Parser cfx2_Parser;
+typedef struct cfx2_Query cfx2_Query;
+typedef struct cfx2_QueryCache cfx2_QueryCache;
+typedef struct cfx2_QueryBatch cfx2_QueryBatch;
+typedef struct cfx2_QueryIter cfx2_QueryIter;
+typedef struct cfx2_View cfx2_View;
+typedef struct cfx2_Frozen cfx2_Frozen;
+typedef struct cfx2_ReadHandler cfx2_ReadHandler;
+
 struct cfx2_RdOpt
 {
-    char* document;
+    const char* document;
     size_t document_len;
 
     void* client_priv;
     int ( *on_error)( cfx2_RdOpt* rd_opt, int rc, int line, const char* desc );
     
     int flags;
+
+    /* only with cfx2_use_allocator */
+    const cfx2_Allocator* allocator;
+
+    /* only with cfx2_parallel_input */
+    unsigned num_threads;
 };
 
+/*
+ *  Writer options. The library's own writers fill them in; code that builds them by hand for
+ *  cfx2_write must clear the whole structure (memset to 0) before setting the stream and callbacks.
+ *  flags used to be ignored by the writer, but cfx2_output_buffer_size and cfx2_parallel_output
+ *  now make it read buffer_size and num_threads.
+ */
 struct cfx2_WrOpt
 {
     void* stream_priv;
@@ -146,6 +280,27 @@ struct cfx2_WrOpt
     int ( *on_error)( cfx2_WrOpt* rd_opt, int rc, int line, const char* desc );
     
     int flags;
+
+    /* only with cfx2_output_buffer_size */
+    size_t buffer_size;
+
+    /* only with cfx2_parallel_output */
+    unsigned num_threads;
+};
+
+/*
+ *  Reader events; any callback may be NULL.
+ *  Names and values are slices of the document (not NUL-terminated) valid only during the call.
+ *  Returning cfx2_stop ends the reading with cfx2_interrupted.
+ */
+struct cfx2_ReadHandler
+{
+    void* user;
+
+    int ( *begin_node )( void* user, const char* name, size_t name_length );
+    int ( *node_text )( void* user, const char* text, size_t length );
+    int ( *attrib )( void* user, const char* name, size_t name_length, const char* value, size_t value_length );
+    int ( *end_node )( void* user );
 };
 
 /* Callback Prototypes */
@@ -155,6 +310,15 @@ typedef int ( *cfx2_FindTest )( size_t index, cfx2_Node* child, cfx2_Node* paren
 /* cfx2 core */
 libcfx2 const char* cfx2_get_error_desc( int error_code );
 
+/* NULL restores malloc/realloc/free; set it before creating any documents */
+libcfx2 int         cfx2_set_allocator( const cfx2_Allocator* allocator );
+libcfx2 void        cfx2_get_allocator( cfx2_Allocator* allocator );
+
+/* memory statistics (slower allocations while enabled); disabling forgets everything counted */
+libcfx2 int         cfx2_enable_memory_stats( int enable );
+libcfx2 int         cfx2_get_memory_stats( int category, cfx2_MemoryStats* stats );
+libcfx2 void        cfx2_reset_memory_stats( void );
+
 /* node manipulation */
 libcfx2 int         cfx2_create_node( cfx2_Node** node );
 libcfx2 cfx2_Node*  cfx2_new_node( const char* name );
@@ -167,6 +331,14 @@ libcfx2 int         cfx2_set_node_text( cfx2_Node* node, const char* text );
 libcfx2 cfx2_Node*  cfx2_clone_node( cfx2_Node* node, int flags );
 /*libcfx2 int         cfx2_merge_nodes( cfx2_Node* left, cfx2_Node* right, cfx2_Node** output_ptr, int flags );*/
 
+/*
+ *  cfx2_compact moves the strings of a heap document into one exactly-sized buffer per node
+ *  and trims its lists, freeing the space that editing left behind.
+ *  Arena nodes are left as they are (a clone of the document can be compacted instead).
+ */
+libcfx2 int         cfx2_document_stats( cfx2_Node* doc, cfx2_DocumentStats* stats );
+libcfx2 int         cfx2_compact( cfx2_Node* doc );
+
 /* node attributes */
 libcfx2 cfx2_Attrib* cfx2_find_attrib( cfx2_Node* node, const char* name );
 libcfx2 int         cfx2_remove_attrib( cfx2_Node* node, const char* name );
@@ -182,9 +354,21 @@ libcfx2 int         cfx2_set_node_attrib_float( cfx2_Node*, const char* name, do
 libcfx2 int         cfx2_add_child( cfx2_Node* parent, cfx2_Node* child );
 libcfx2 int         cfx2_insert_child( cfx2_Node* parent, size_t index, cfx2_Node* child );
 libcfx2 cfx2_Node*  cfx2_create_child( cfx2_Node* parent, const char* name, const char* text, cfx2_Uniqueness uniqueness );
+
+/*
+ *  Lookups (cfx2_find_child, cfx2_find_attrib and queries that don't modify) only read the tree:
+ *  wide nodes are indexed as children and attributes are added. Any number of threads may search
+ *  a document as long as none of them modifies it.
+ */
 libcfx2 cfx2_Node*  cfx2_find_child( cfx2_Node* parent, const char* name );
 libcfx2 cfx2_Node*  cfx2_find_child_by_test( cfx2_Node* parent, cfx2_FindTest test, void* user );
 libcfx2 int         cfx2_iterate_child_nodes( cfx2_Node* parent, cfx2_IterateCallback callback, void* user );
+
+/*
+ *  A child removed from an arena document stays in its arena and lives as long as the document:
+ *  cfx2_release_node does nothing for it, and adding it anywhere but back into the same document
+ *  fails with cfx2_param_invalid. Use cfx2_clone_node to keep a copy of the subtree.
+ */
 libcfx2 int         cfx2_remove_child( cfx2_Node* parent, cfx2_Node* child );
 
 /* cfx2 reader */
@@ -193,17 +377,140 @@ libcfx2 int         cfx2_read_file( cfx2_Node** doc_ptr, const char* filename, c
 libcfx2 int         cfx2_read_from_string( cfx2_Node** doc_ptr, const char* document, const cfx2_RdOpt* rd_opt_in );
 libcfx2 cfx2_Node*  cfx2_load_document( const char* filename );
 
+/* event reader; no document tree is built */
+libcfx2 int         cfx2_read_events( const cfx2_ReadHandler* handler, cfx2_RdOpt* rd_opt );
+libcfx2 int         cfx2_read_events_from_file( const cfx2_ReadHandler* handler, const char* filename, const cfx2_RdOpt* rd_opt_in );
+libcfx2 int         cfx2_read_events_from_string( const cfx2_ReadHandler* handler, const char* document, const cfx2_RdOpt* rd_opt_in );
+
+/* incremental (push) reader; chunks may split the document anywhere */
+libcfx2 int         cfx2_create_parser( cfx2_Parser** parser_ptr, const cfx2_RdOpt* rd_opt_in );
+libcfx2 int         cfx2_create_event_parser( cfx2_Parser** parser_ptr, const cfx2_ReadHandler* handler, const cfx2_RdOpt* rd_opt_in );
+libcfx2 int         cfx2_parser_feed( cfx2_Parser* parser, const char* chunk, size_t length );
+libcfx2 int         cfx2_parser_finish( cfx2_Parser* parser, cfx2_Node** doc_ptr );
+libcfx2 void        cfx2_release_parser( cfx2_Parser** parser_ptr );
+
 /* cfx2 writer */
 libcfx2 int         cfx2_write( cfx2_Node* doc, cfx2_WrOpt* wr_opt );
+
+/*
+ *  write_to_buffer appends to a buffer of the global allocator, growing it geometrically.
+ *  measure gives the exact number of bytes the document serializes to (no terminating NUL).
+ *  write_to_fixed_buffer never writes past capacity; if the document doesn't fit,
+ *  it returns cfx2_buffer_overflow and *used is the capacity needed.
+ */
 libcfx2 int         cfx2_write_to_buffer( cfx2_Node* doc, char** text, size_t* capacity, size_t* used );
+libcfx2 int         cfx2_measure_document( cfx2_Node* doc, size_t* size );
+libcfx2 int         cfx2_write_to_fixed_buffer( cfx2_Node* doc, char* buffer, size_t capacity, size_t* used );
 libcfx2 int         cfx2_save_document( cfx2_Node* doc, const char* file_name );
 
+/*
+ *  Parallel writing (cfx2_parallel_output) gives the same output, written faster for documents
+ *  with many top-level nodes.
+ */
+libcfx2 int         cfx2_save_document_parallel( cfx2_Node* doc, const char* file_name, unsigned num_threads );
+
+/*
+ *  Binary documents: a flat layout of fixed-width little-endian records and a string table,
+ *  loaded from a mapped file without any parsing. rd_opt_in (may be NULL) selects the
+ *  allocator, an arena document and on_error as for cfx2_read_file.
+ */
+libcfx2 int         cfx2_save_binary( cfx2_Node* doc, const char* file_name );
+libcfx2 int         cfx2_load_binary( cfx2_Node** doc_ptr, const char* file_name, const cfx2_RdOpt* rd_opt_in );
+
+/*
+ *  Views: read-only lookups in a binary document where it is, without building any nodes.
+ *  Opening maps the file and only checks its header; damaged records read as missing.
+ *  Nodes are numbered from cfx2_view_root (the document), cfx2_no_view_node means none.
+ *  Strings point into the file and stay valid until the view is released.
+ *  cfx2_open_view_from_memory doesn't copy data, which must outlive the view.
+ */
+libcfx2 int         cfx2_open_view( cfx2_View** view_ptr, const char* file_name );
+libcfx2 int         cfx2_open_view_from_memory( cfx2_View** view_ptr, const char* data, size_t size );
+libcfx2 void        cfx2_release_view( cfx2_View** view_ptr );
+
+libcfx2 const char* cfx2_view_name( const cfx2_View* view, cfx2_ViewNode node );
+libcfx2 const char* cfx2_view_text( const cfx2_View* view, cfx2_ViewNode node );
+libcfx2 size_t      cfx2_view_num_children( const cfx2_View* view, cfx2_ViewNode node );
+libcfx2 cfx2_ViewNode cfx2_view_child( const cfx2_View* view, cfx2_ViewNode node, size_t index );
+libcfx2 cfx2_ViewNode cfx2_view_find_child( const cfx2_View* view, cfx2_ViewNode parent, const char* name );
+libcfx2 size_t      cfx2_view_num_attribs( const cfx2_View* view, cfx2_ViewNode node );
+libcfx2 int         cfx2_view_attrib( const cfx2_View* view, cfx2_ViewNode node, size_t index, const char** name, const char** value );
+libcfx2 int         cfx2_view_find_attrib( const cfx2_View* view, cfx2_ViewNode node, const char* name, const char** value );
+
+/* the same language and results as cfx2_query_value / cfx2_execute_query_value */
+libcfx2 const char* cfx2_view_query_value( const cfx2_View* view, cfx2_ViewNode base, const char* command );
+libcfx2 const char* cfx2_view_execute_query_value( const cfx2_View* view, const cfx2_Query* query, cfx2_ViewNode base,
+        const char* const* params );
+
+/*
+ *  Frozen documents: a read-only copy of a tree in one block, the nodes in document order
+ *  (pre-order) with every field in an array of its own, for walks over the whole document.
+ *  Nodes are numbered from cfx2_frozen_root (the document); the children of a node are its
+ *  first child and that child's next siblings, cfx2_no_frozen_node ending either.
+ *  Strings stay valid until the frozen document is released.
+ *  cfx2_thaw builds a tree again; rd_opt_in (may be NULL) selects the allocator and an arena
+ *  document as for cfx2_read_file.
+ */
+libcfx2 int         cfx2_freeze( cfx2_Frozen** frozen_ptr, cfx2_Node* doc );
+libcfx2 int         cfx2_thaw( cfx2_Node** doc_ptr, const cfx2_Frozen* frozen, const cfx2_RdOpt* rd_opt_in );
+libcfx2 void        cfx2_release_frozen( cfx2_Frozen** frozen_ptr );
+
+libcfx2 size_t      cfx2_frozen_num_nodes( const cfx2_Frozen* frozen );
+libcfx2 const char* cfx2_frozen_name( const cfx2_Frozen* frozen, cfx2_FrozenNode node );
+libcfx2 const char* cfx2_frozen_text( const cfx2_Frozen* frozen, cfx2_FrozenNode node );
+libcfx2 cfx2_FrozenNode cfx2_frozen_first_child( const cfx2_Frozen* frozen, cfx2_FrozenNode node );
+libcfx2 cfx2_FrozenNode cfx2_frozen_next_sibling( const cfx2_Frozen* frozen, cfx2_FrozenNode node );
+libcfx2 cfx2_FrozenNode cfx2_frozen_find_child( const cfx2_Frozen* frozen, cfx2_FrozenNode parent, const char* name );
+libcfx2 size_t      cfx2_frozen_num_attribs( const cfx2_Frozen* frozen, cfx2_FrozenNode node );
+libcfx2 int         cfx2_frozen_attrib( const cfx2_Frozen* frozen, cfx2_FrozenNode node, size_t index, const char** name, const char** value );
+libcfx2 int         cfx2_frozen_find_attrib( const cfx2_Frozen* frozen, cfx2_FrozenNode node, const char* name, const char** value );
+
 /* cfx2 basic query language */
 libcfx2 cfx2_ResultType cfx2_query( cfx2_Node* base, const char* command, int allow_modifications, void** output );
 libcfx2 cfx2_Node*  cfx2_query_node( cfx2_Node* base, const char* command, int allow_modifications );
 libcfx2 cfx2_Attrib* cfx2_query_attrib( cfx2_Node* base, const char* command, int allow_modifications );
 libcfx2 const char* cfx2_query_value( cfx2_Node* base, const char* command );
 
+/*
+ *  Compiled queries: the command is parsed once and can be run any number of times.
+ *  "%s" in place of a node name, attribute name or value is a parameter, filled in
+ *  from params (in order of appearance) when the query is run.
+ */
+libcfx2 int         cfx2_compile_query( cfx2_Query** query_ptr, const char* command );
+libcfx2 void        cfx2_release_query( cfx2_Query** query_ptr );
+libcfx2 cfx2_ResultType cfx2_execute_query( const cfx2_Query* query, cfx2_Node* base, const char* const* params,
+        int allow_modifications, void** output );
+libcfx2 const char* cfx2_execute_query_value( const cfx2_Query* query, cfx2_Node* base, const char* const* params );
+
+/* LRU cache of compiled queries; a returned query is valid until the next cfx2_cached_query */
+libcfx2 int         cfx2_create_query_cache( cfx2_QueryCache** cache_ptr, size_t capacity );
+libcfx2 const cfx2_Query* cfx2_cached_query( cfx2_QueryCache* cache, const char* command );
+libcfx2 void        cfx2_release_query_cache( cfx2_QueryCache** cache_ptr );
+
+/*
+ *  Query iterators: all matches of a query, in document order, one at a time.
+ *  Besides names, node steps may be "*" (any child) or "**" (the node and all its descendants),
+ *  each optionally followed by attribute predicates: "Button[iconIndex=4]", "*[visible]".
+ *  The other query functions return the first match of such queries.
+ *  next returns cfx2_node or cfx2_attrib, then cfx2_void when done (cfx2_fail if out of memory).
+ *  The tree must not be modified while an iterator is in use.
+ */
+libcfx2 int         cfx2_create_query_iter( cfx2_QueryIter** iter_ptr, const cfx2_Query* query, cfx2_Node* base,
+        const char* const* params );
+libcfx2 int         cfx2_query_all( cfx2_QueryIter** iter_ptr, cfx2_Node* base, const char* command );
+libcfx2 cfx2_ResultType cfx2_query_iter_next( cfx2_QueryIter* iter, void** output );
+libcfx2 void        cfx2_release_query_iter( cfx2_QueryIter** iter_ptr );
+
+/*
+ *  Batch queries: values[i] is the value (text or attribute value) commands[i] leads to, or NULL.
+ *  Common path prefixes are merged, so every node on the way is looked up once.
+ *  Queries with patterns or values to set have no result here.
+ */
+libcfx2 int         cfx2_query_values( cfx2_Node* base, const char* const* commands, size_t count, const char** values );
+libcfx2 int         cfx2_compile_query_batch( cfx2_QueryBatch** batch_ptr, const char* const* commands, size_t count );
+libcfx2 void        cfx2_execute_query_batch( const cfx2_QueryBatch* batch, cfx2_Node* base, const char** values );
+libcfx2 void        cfx2_release_query_batch( cfx2_QueryBatch** batch_ptr );
+
 /* utility macros */
 #define cfx2_list_length( list_ ) ( (list_).length )
 #define cfx2_has_children( node_ ) ( (node_) ? cfx2_list_length( (node_)->children ) : 0 )
@@ -0,0 +1,407 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+
+#include "alloc.h"
+#include "thread.h"
+
+#include <confix2.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void* default_alloc( void* user, size_t size )
+{
+    ( void )user;
+    return malloc( size );
+}
+
+static void* default_realloc( void* user, void* ptr, size_t size )
+{
+    ( void )user;
+    return realloc( ptr, size );
+}
+
+static void default_free( void* user, void* ptr )
+{
+    ( void )user;
+    free( ptr );
+}
+
+cfx2_Allocator libcfx2_allocator = { NULL, default_alloc, default_realloc, default_free };
+
+libcfx2 int cfx2_set_allocator( const cfx2_Allocator* allocator )
+{
+    if ( allocator == NULL )
+    {
+        libcfx2_allocator.user = NULL;
+        libcfx2_allocator.alloc = default_alloc;
+        libcfx2_allocator.realloc = default_realloc;
+        libcfx2_allocator.free = default_free;
+        return cfx2_ok;
+    }
+
+    if ( allocator->alloc == NULL || allocator->realloc == NULL || allocator->free == NULL )
+        return cfx2_param_invalid;
+
+    libcfx2_allocator = *allocator;
+    return cfx2_ok;
+}
+
+libcfx2 void cfx2_get_allocator( cfx2_Allocator* allocator )
+{
+    *allocator = libcfx2_allocator;
+}
+
+const cfx2_Allocator* cfx2_rd_opt_allocator( const cfx2_RdOpt* rd_opt )
+{
+    if ( rd_opt != NULL && ( rd_opt->flags & cfx2_use_allocator ) && rd_opt->allocator != NULL )
+        return rd_opt->allocator;
+
+    return &libcfx2_allocator;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Memory Statistics                                                         */
+/* -------------------------------------------------------------------------- */
+
+/*
+ *  Blocks are found by address in an open-addressing table (linear probing,
+ *  deletion by shifting back), allocated with malloc so it doesn't count itself.
+ *  Blocks the table doesn't know (allocated before counting started or handed
+ *  over) are left alone when freed and count as new when reallocated.
+ */
+typedef struct
+{
+    const void* ptr;            /* NULL for an empty slot */
+    size_t size;
+    int category;
+}
+Block_t;
+
+volatile int cfx2_memory_stats_enabled = 0;
+
+static Block_t* blocks = NULL;
+static size_t blocks_capacity = 0, blocks_used = 0;     /* capacity is a power of 2 */
+
+/* one per category, then the totals */
+static cfx2_MemoryStats stats[cfx2_mem_categories + 1];
+
+static size_t block_slot( const void* ptr )
+{
+    size_t hash = ( size_t )ptr;
+
+    /* the low bits are alignment */
+    hash ^= hash >> 4;
+    hash *= 0x9E3779B1u;
+    return ( hash ^ ( hash >> 15 ) ) & ( blocks_capacity - 1 );
+}
+
+static Block_t* find_block( const void* ptr )
+{
+    size_t i;
+
+    if ( blocks_capacity == 0 )
+        return NULL;
+
+    for ( i = block_slot( ptr ); blocks[i].ptr != NULL; i = ( i + 1 ) & ( blocks_capacity - 1 ) )
+        if ( blocks[i].ptr == ptr )
+            return &blocks[i];
+
+    return NULL;
+}
+
+static int grow_blocks( void )
+{
+    Block_t* old_blocks;
+    size_t old_capacity, i, j;
+
+    old_blocks = blocks;
+    old_capacity = blocks_capacity;
+
+    blocks_capacity = old_capacity ? old_capacity * 2 : 1024;
+    blocks = ( Block_t* )calloc( blocks_capacity, sizeof( Block_t ) );
+
+    if ( blocks == NULL )
+    {
+        blocks = old_blocks;
+        blocks_capacity = old_capacity;
+        return 0;
+    }
+
+    for ( i = 0; i < old_capacity; i++ )
+    {
+        if ( old_blocks[i].ptr == NULL )
+            continue;
+
+        for ( j = block_slot( old_blocks[i].ptr ); blocks[j].ptr != NULL; j = ( j + 1 ) & ( blocks_capacity - 1 ) )
+            ;
+
+        blocks[j] = old_blocks[i];
+    }
+
+    free( old_blocks );
+    return 1;
+}
+
+static void remove_block( Block_t* block )
+{
+    size_t i, j, home;
+
+    i = block - blocks;
+    blocks[i].ptr = NULL;
+    blocks_used--;
+
+    /* shift back the entries that probed past the hole */
+    for ( j = ( i + 1 ) & ( blocks_capacity - 1 ); blocks[j].ptr != NULL; j = ( j + 1 ) & ( blocks_capacity - 1 ) )
+    {
+        home = block_slot( blocks[j].ptr );
+
+        if ( ( ( j - home ) & ( blocks_capacity - 1 ) ) >= ( ( j - i ) & ( blocks_capacity - 1 ) ) )
+        {
+            blocks[i] = blocks[j];
+            blocks[j].ptr = NULL;
+            i = j;
+        }
+    }
+}
+
+static void count_live( int category, size_t added, size_t removed )
+{
+    cfx2_MemoryStats* counts[2];
+    int i;
+
+    counts[0] = &stats[category];
+    counts[1] = &stats[cfx2_mem_categories];
+
+    for ( i = 0; i < 2; i++ )
+    {
+        counts[i]->live_bytes += added;
+        counts[i]->live_bytes -= removed;
+
+        if ( counts[i]->live_bytes > counts[i]->peak_bytes )
+            counts[i]->peak_bytes = counts[i]->live_bytes;
+    }
+}
+
+/* a new block; without room in the table it just isn't counted */
+static void add_block( const void* ptr, size_t size, int category )
+{
+    Block_t* block;
+    size_t i;
+
+    if ( ( block = find_block( ptr ) ) != NULL )
+    {
+        /* freed behind the library's back; the address was reused */
+        count_live( block->category, 0, block->size );
+        stats[block->category].live_blocks--;
+        stats[cfx2_mem_categories].live_blocks--;
+        remove_block( block );
+    }
+
+    if ( ( blocks_used + 1 ) * 2 > blocks_capacity && !grow_blocks() )
+        return;
+
+    for ( i = block_slot( ptr ); blocks[i].ptr != NULL; i = ( i + 1 ) & ( blocks_capacity - 1 ) )
+        ;
+
+    blocks[i].ptr = ptr;
+    blocks[i].size = size;
+    blocks[i].category = category;
+    blocks_used++;
+
+    stats[category].live_blocks++;
+    stats[cfx2_mem_categories].live_blocks++;
+    count_live( category, size, 0 );
+}
+
+/* forgets a block; its category (and size, if wanted), or -1 if it wasn't counted */
+static int drop_block( const void* ptr, size_t* size )
+{
+    Block_t* block;
+    int category;
+
+    if ( ( block = find_block( ptr ) ) == NULL )
+        return -1;
+
+    category = block->category;
+
+    if ( size != NULL )
+        *size = block->size;
+
+    count_live( category, 0, block->size );
+    stats[category].live_blocks--;
+    stats[cfx2_mem_categories].live_blocks--;
+    remove_block( block );
+    return category;
+}
+
+/* the only check of the categories callers pass; everything below indexes stats with them */
+static int valid_category( int category )
+{
+    if ( category < 0 || category >= cfx2_mem_categories )
+        return cfx2_mem_other;
+
+    return category;
+}
+
+void* cfx2_counted_alloc( const cfx2_Allocator* allocator, size_t size, int category )
+{
+    void* ptr;
+
+    category = valid_category( category );
+    ptr = allocator->alloc( allocator->user, size );
+
+    cfx2_global_lock();
+
+    if ( cfx2_memory_stats_enabled && ptr != NULL )
+    {
+        add_block( ptr, size, category );
+        stats[category].allocs++;
+        stats[cfx2_mem_categories].allocs++;
+    }
+
+    cfx2_global_unlock();
+    return ptr;
+}
+
+/*
+ *  The old block is forgotten before the allocator is called, not under the lock across the call:
+ *  once the allocator frees it, another thread may be given the same address.
+ */
+void* cfx2_counted_realloc( const cfx2_Allocator* allocator, void* ptr, size_t size, int category )
+{
+    void* new_ptr;
+    size_t old_size;
+    int old_category;
+
+    category = valid_category( category );
+    old_category = -1;
+    old_size = 0;
+
+    if ( cfx2_memory_stats_enabled && ptr != NULL )
+    {
+        cfx2_global_lock();
+
+        if ( cfx2_memory_stats_enabled )
+            old_category = drop_block( ptr, &old_size );
+
+        cfx2_global_unlock();
+    }
+
+    new_ptr = allocator->realloc( allocator->user, ptr, size );
+
+    cfx2_global_lock();
+
+    if ( cfx2_memory_stats_enabled )
+    {
+        if ( new_ptr != NULL )
+        {
+            if ( old_category >= 0 )
+                category = old_category;
+
+            add_block( new_ptr, size, category );
+            stats[category].reallocs++;
+            stats[cfx2_mem_categories].reallocs++;
+        }
+        else if ( old_category >= 0 )
+            add_block( ptr, old_size, old_category );     /* still live */
+    }
+
+    cfx2_global_unlock();
+    return new_ptr;
+}
+
+void cfx2_counted_free( const cfx2_Allocator* allocator, void* ptr )
+{
+    int category;
+
+    cfx2_global_lock();
+
+    if ( cfx2_memory_stats_enabled && ( category = drop_block( ptr, NULL ) ) >= 0 )
+    {
+        stats[category].frees++;
+        stats[cfx2_mem_categories].frees++;
+    }
+
+    cfx2_global_unlock();
+
+    allocator->free( allocator->user, ptr );
+}
+
+void cfx2_hand_over( void* ptr )
+{
+    if ( !cfx2_memory_stats_enabled || ptr == NULL )
+        return;
+
+    cfx2_global_lock();
+    drop_block( ptr, NULL );
+    cfx2_global_unlock();
+}
+
+libcfx2 int cfx2_enable_memory_stats( int enable )
+{
+    cfx2_global_lock();
+
+    if ( !enable )
+    {
+        free( blocks );
+        blocks = NULL;
+        blocks_capacity = 0;
+        blocks_used = 0;
+    }
+
+    if ( enable != cfx2_memory_stats_enabled )
+        memset( stats, 0, sizeof( stats ) );
+
+    cfx2_memory_stats_enabled = ( enable != 0 );
+
+    cfx2_global_unlock();
+    return cfx2_ok;
+}
+
+libcfx2 int cfx2_get_memory_stats( int category, cfx2_MemoryStats* stats_out )
+{
+    if ( category < 0 || category > cfx2_mem_categories || stats_out == NULL )
+        return cfx2_param_invalid;
+
+    cfx2_global_lock();
+    *stats_out = stats[category];
+    cfx2_global_unlock();
+
+    return cfx2_ok;
+}
+
+libcfx2 void cfx2_reset_memory_stats( void )
+{
+    int i;
+
+    cfx2_global_lock();
+
+    for ( i = 0; i <= cfx2_mem_categories; i++ )
+    {
+        stats[i].allocs = stats[i].reallocs = stats[i].frees = 0;
+        stats[i].peak_bytes = stats[i].live_bytes;
+    }
+
+    cfx2_global_unlock();
+}
@@ -0,0 +1,66 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+
+#ifndef libcfx2_alloc_h
+#define libcfx2_alloc_h
+
+#include <confix2.h>
+
+/* the global allocator, set by cfx2_set_allocator */
+extern cfx2_Allocator libcfx2_allocator;
+
+/*  Dynamic Allocation Functions; category_ is a cfx2_mem_* for memory statistics  */
+#define libcfx2_malloc( size_, category_ )              cfx2_alloc_with( &libcfx2_allocator, size_, category_ )
+#define libcfx2_realloc( ptr_, size_, category_ )       cfx2_realloc_with( &libcfx2_allocator, ptr_, size_, category_ )
+#define libcfx2_free( ptr_ )                            cfx2_free_with( &libcfx2_allocator, ptr_ )
+
+/* allocation through a particular allocator (see cfx2_rd_opt_allocator) */
+#define cfx2_alloc_with( allocator_, size_, category_ )\
+        ( cfx2_memory_stats_enabled ? cfx2_counted_alloc( allocator_, size_, category_ )\
+        : ( allocator_ )->alloc( ( allocator_ )->user, ( size_ ) ) )
+#define cfx2_realloc_with( allocator_, ptr_, size_, category_ )\
+        ( cfx2_memory_stats_enabled ? cfx2_counted_realloc( allocator_, ptr_, size_, category_ )\
+        : ( allocator_ )->realloc( ( allocator_ )->user, ( ptr_ ), ( size_ ) ) )
+#define cfx2_free_with( allocator_, ptr_ )\
+        ( ( ptr_ ) == NULL ? ( void ) 0\
+        : cfx2_memory_stats_enabled ? cfx2_counted_free( allocator_, ptr_ )\
+        : ( allocator_ )->free( ( allocator_ )->user, ( ptr_ ) ) )
+
+/*
+ *  Memory statistics (cfx2_enable_memory_stats): the counted versions keep the size
+ *  and category of every block in a table, under the global lock.
+ */
+extern volatile int cfx2_memory_stats_enabled;
+
+void* cfx2_counted_alloc( const cfx2_Allocator* allocator, size_t size, int category );
+void* cfx2_counted_realloc( const cfx2_Allocator* allocator, void* ptr, size_t size, int category );
+void cfx2_counted_free( const cfx2_Allocator* allocator, void* ptr );
+
+/* a block now belongs to the caller, who may free it without the library */
+void cfx2_hand_over( void* ptr );
+
+/* the allocator for reader scratch memory and arena documents */
+const cfx2_Allocator* cfx2_rd_opt_allocator( const cfx2_RdOpt* rd_opt );
+
+#endif
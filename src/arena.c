@@ -0,0 +1,138 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+
+#include "alloc.h"
+#include "arena.h"
+#include "config.h"
+#include "list.h"
+
+#include <confix2.h>
+#include <stdlib.h>
+#include <string.h>
+
+static ArenaChunk_t* new_chunk( cfx2_Arena* arena, size_t min_size )
+{
+    ArenaChunk_t* chunk;
+    size_t capacity;
+
+    /* chunks grow with the document, so big documents need few of them */
+    capacity = ( arena->chunks != NULL ) ? arena->chunks->capacity * 2 : ARENA_MIN_CHUNK;
+
+    if ( capacity > ARENA_MAX_CHUNK )
+        capacity = ARENA_MAX_CHUNK;
+
+    if ( capacity < min_size )
+        capacity = min_size;
+
+    chunk = ( ArenaChunk_t* )cfx2_alloc_with( &arena->allocator, arena_align_up( sizeof( ArenaChunk_t ) ) + capacity, cfx2_mem_arena );
+
+    if ( chunk == NULL )
+        return NULL;
+
+    chunk->next = arena->chunks;
+    chunk->capacity = capacity;
+    chunk->used = 0;
+
+    arena->chunks = chunk;
+    return chunk;
+}
+
+int cfx2_arena_create( cfx2_Arena** arena_ptr, const cfx2_Allocator* allocator )
+{
+    cfx2_Arena* arena;
+
+    arena = ( cfx2_Arena* )cfx2_alloc_with( allocator, sizeof( cfx2_Arena ), cfx2_mem_arena );
+
+    if ( arena == NULL )
+        return cfx2_alloc_error;
+
+    arena->allocator = *allocator;
+    arena->chunks = NULL;
+    arena->root = NULL;
+    cfx2_list_init( &arena->adopted );
+    cfx2_names_init( &arena->names, arena, &arena->allocator );
+
+    *arena_ptr = arena;
+    return cfx2_ok;
+}
+
+void cfx2_arena_release( cfx2_Arena* arena )
+{
+    cfx2_Allocator allocator;
+    ArenaChunk_t* chunk, * next;
+    size_t i;
+
+    for ( i = 0; i < cfx2_list_length( arena->adopted ); i++ )
+        cfx2_release_node( &cfx2_item( arena->adopted, i, cfx2_Node* ) );
+
+    cfx2_list_release( &arena->adopted );
+
+    allocator = arena->allocator;
+
+    for ( chunk = arena->chunks; chunk != NULL; chunk = next )
+    {
+        next = chunk->next;
+        cfx2_free_with( &allocator, chunk );
+    }
+
+    cfx2_free_with( &allocator, arena );
+}
+
+void* cfx2_arena_alloc( cfx2_Arena* arena, size_t size )
+{
+    ArenaChunk_t* chunk;
+    void* ptr;
+
+    size = arena_align_up( size );
+    chunk = arena->chunks;
+
+    if ( chunk == NULL || chunk->used + size > chunk->capacity )
+    {
+        if ( ( chunk = new_chunk( arena, size ) ) == NULL )
+            return NULL;
+    }
+
+    ptr = ( char* )chunk + arena_align_up( sizeof( ArenaChunk_t ) ) + chunk->used;
+    chunk->used += size;
+
+    return ptr;
+}
+
+int cfx2_arena_adopt( cfx2_Arena* arena, cfx2_Node* node )
+{
+    cfx2_Node** p_node;
+
+    p_node = ( cfx2_Node** )cfx2_list_add_item( &arena->adopted, sizeof( cfx2_Node* ), NULL );
+
+    if ( p_node == NULL )
+        return cfx2_alloc_error;
+
+    *p_node = node;
+    return cfx2_ok;
+}
+
+void cfx2_arena_disown( cfx2_Arena* arena, cfx2_Node* node )
+{
+    cfx2_list_remove_item( &arena->adopted, sizeof( cfx2_Node* ), &node );
+}
@@ -0,0 +1,70 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+
+#ifndef libcfx2_arena_h
+#define libcfx2_arena_h
+
+#include "config.h"
+#include "intern.h"
+
+#include <confix2.h>
+
+/*
+ *  Arena documents: nodes, attribute/child lists and strings of a whole document
+ *  are carved out of a chain of large chunks owned by the root node.
+ *  Nothing is freed individually; releasing the root frees the chunks at once.
+ */
+
+typedef struct ArenaChunk_t ArenaChunk_t;
+
+struct ArenaChunk_t
+{
+    ArenaChunk_t* next;
+    size_t capacity, used;
+};
+
+struct cfx2_Arena
+{
+    cfx2_Allocator allocator;
+
+    ArenaChunk_t* chunks;
+    cfx2_Node* root;
+
+    /* heap nodes added to the document, released together with it */
+    cfx2_List adopted;
+
+    NameTable_t names;
+};
+
+/* space a block of size_ bytes takes in a chunk */
+#define arena_align_up( size_ ) ( ( ( size_ ) + ( ARENA_ALIGN - 1 ) ) & ~( size_t )( ARENA_ALIGN - 1 ) )
+
+int cfx2_arena_create( cfx2_Arena** arena_ptr, const cfx2_Allocator* allocator );
+void cfx2_arena_release( cfx2_Arena* arena );
+void* cfx2_arena_alloc( cfx2_Arena* arena, size_t size );
+
+int cfx2_arena_adopt( cfx2_Arena* arena, cfx2_Node* node );
+void cfx2_arena_disown( cfx2_Arena* arena, cfx2_Node* node );
+
+#endif
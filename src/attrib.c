@@ -21,8 +21,11 @@
     distribution.
 */
 
+#include "arena.h"
 #include "attrib.h"
 #include "config.h"
+#include "index.h"
+#include "intern.h"
 #include "list.h"
 #include "node.h"
 
@@ -35,7 +38,7 @@ int cfx2_attrib_new( cfx2_Attrib** ptr, cfx2_Node* node )
 {
     cfx2_Attrib* attrib;
     
-    attrib = ( cfx2_Attrib* )cfx2_list_add_item( &node->attributes, sizeof( cfx2_Attrib ) );
+    attrib = ( cfx2_Attrib* )cfx2_list_add_item( &node->attributes, sizeof( cfx2_Attrib ), node->arena );
     
     if ( attrib == NULL )
         return cfx2_alloc_error;
@@ -53,7 +56,7 @@ void cfx2_attrib_release( cfx2_Attrib* attrib )
     cfx2_sfree( attrib->value );
 }
 
-int cfx2_attrib_set_value( cfx2_Attrib* attrib, const char* value )
+int cfx2_attrib_set_value( cfx2_Node* node, cfx2_Attrib* attrib, const char* value )
 {
     if ( !attrib )
         return cfx2_param_invalid;
@@ -61,45 +64,64 @@ int cfx2_attrib_set_value( cfx2_Attrib* attrib, const char* value )
     if ( attrib->value )
         cfx2_sfree( attrib->value );
 
-    if ( value )
-    {
-        attrib->value = ( char* )libcfx2_malloc( strlen( value ) + 1 );
-
-        if ( !attrib->value )
-            return cfx2_alloc_error;
+    attrib->value = 0;
 
-        strcpy( attrib->value, value );
-    }
-    else
-        attrib->value = 0;
+    /* a separate, reference-counted string (or an arena string for arena nodes) */
+    if ( value )
+        return cfx2_salloc( &attrib->value, NULL, node, strlen( value ) + 1, value, 0 );
 
     return cfx2_ok;
 }
 
-libcfx2 cfx2_Attrib* cfx2_find_attrib( cfx2_Node* node, const char* name )
+static cfx2_Attrib* scan_attribs( cfx2_Node* node, const char* name )
 {
+    const char* attrib_name;
     size_t i;
 
     for ( i = 0; i < cfx2_list_length( node->attributes ); i++ )
-        if ( strcmp( cfx2_item( node->attributes, i, cfx2_Attrib ).name, name ) == 0 )
+    {
+        attrib_name = cfx2_item( node->attributes, i, cfx2_Attrib ).name;
+
+        /* interned names match by pointer */
+        if ( attrib_name == name || strcmp( attrib_name, name ) == 0 )
             return &cfx2_item( node->attributes, i, cfx2_Attrib );
+    }
 
     return 0;
 }
 
+cfx2_Attrib* cfx2_find_attrib_hashed( cfx2_Node* node, const char* name, size_t hash )
+{
+    if ( node->attrib_index != NULL )
+        return cfx2_attrib_index_find( node, name, hash );
+
+    return scan_attribs( node, name );
+}
+
+libcfx2 cfx2_Attrib* cfx2_find_attrib( cfx2_Node* node, const char* name )
+{
+    if ( node->attrib_index != NULL )
+        return cfx2_attrib_index_find( node, name, cfx2_hash_name( name ) );
+
+    return scan_attribs( node, name );
+}
+
 libcfx2 int cfx2_remove_attrib( cfx2_Node* node, const char* name )
 {
+    cfx2_Attrib* attrib;
     size_t i;
 
-    for ( i = 0; i < cfx2_list_length( node->attributes ); i++ )
-        if ( strcmp( cfx2_item( node->attributes, i, cfx2_Attrib ).name, name ) == 0 )
-        {
-            cfx2_attrib_release( &cfx2_item( node->attributes, i, cfx2_Attrib ) );
-            cfx2_list_remove_at_index( &node->attributes, sizeof( cfx2_Attrib ), i );
-            return cfx2_ok;
-        }
-
-    return cfx2_attrib_not_found;
+    attrib = cfx2_find_attrib( node, name );
+
+    if ( attrib == NULL )
+        return cfx2_attrib_not_found;
+
+    i = attrib - &cfx2_item( node->attributes, 0, cfx2_Attrib );
+
+    cfx2_attrib_index_remove( node, i );
+    cfx2_attrib_release( attrib );
+    cfx2_list_remove_at_index( &node->attributes, sizeof( cfx2_Attrib ), i );
+    return cfx2_ok;
 }
 
 libcfx2 int cfx2_get_node_attrib( cfx2_Node* node, const char* name, const char** value )
@@ -155,7 +177,7 @@ libcfx2 int cfx2_set_node_attrib( cfx2_Node* node, const char* name, const char*
     attrib = cfx2_find_attrib( node, name );
 
     if ( attrib != NULL )
-        return cfx2_attrib_set_value( attrib, value );
+        return cfx2_attrib_set_value( node, attrib, value );
 
     rc = cfx2_attrib_new( &attrib, node );
 
@@ -163,12 +185,30 @@ libcfx2 int cfx2_set_node_attrib( cfx2_Node* node, const char* name, const char*
         return rc;
 
     /* FIXME: Further returns leave unitialized attribute */
-    
-    rc = cfx2_salloc( &attrib->name, NULL, node, strlen( name ) + 1, name, cfx2_use_shared_buffer );
-    
-    if ( rc != 0 )
-        return rc;
-    
+
+    /* arena documents share their attribute names */
+    if ( node->arena != NULL )
+    {
+        rc = cfx2_intern_name( &node->arena->names, &attrib->name, name, strlen( name ) );
+
+        if ( rc != 0 )
+            return rc;
+    }
+
+    if ( attrib->name == NULL )
+    {
+        rc = cfx2_salloc( &attrib->name, NULL, node, strlen( name ) + 1, name, cfx2_use_shared_buffer );
+
+        if ( rc != 0 )
+            return rc;
+    }
+
+    cfx2_attrib_index_add( node, cfx2_list_length( node->attributes ) - 1 );
+
+    /* an attribute without a value, as cfx2_attrib_set_value allows */
+    if ( value == NULL )
+        return cfx2_ok;
+
     rc = cfx2_salloc( &attrib->value, NULL, node, strlen( value ) + 1, value, cfx2_use_shared_buffer );
 
     if ( rc != 0 )
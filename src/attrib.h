@@ -29,6 +29,9 @@
 int cfx2_attrib_new( cfx2_Attrib** ptr, cfx2_Node* node );
 void cfx2_attrib_release( cfx2_Attrib* attrib );
 
-int cfx2_attrib_set_value( cfx2_Attrib* attrib, const char* value );
+/* hash is cfx2_hash_name( name ) */
+cfx2_Attrib* cfx2_find_attrib_hashed( cfx2_Node* node, const char* name, size_t hash );
+
+int cfx2_attrib_set_value( cfx2_Node* node, cfx2_Attrib* attrib, const char* value );
 
 #endif
@@ -0,0 +1,288 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+#include "bench.h"
+#include "../tests/timer.h"
+
+#include <stdarg.h>
+#include <string.h>
+
+/*
+ *  Runs every case on every document shape: warmup runs first, then the timed
+ *  repetitions, of which the best and the median are reported. Throughput is
+ *  the size of the document (as text and in nodes) over the best time, or for
+ *  cases that repeat an operation (queries), operations over the best time.
+ *  -csv prints one line per shape and case, for tracking results over time.
+ *
+ *  usage: bench [-r<repetitions>] [-w<warmups>] [-s<scale>] [-csv] [-l] [shape | case]...
+ */
+
+typedef struct
+{
+    unsigned repetitions, warmups, scale;
+    int csv;
+
+    /* shapes and cases to run */
+    char** names;
+    int num_names, num_shapes, num_cases;
+}
+Options;
+
+typedef struct
+{
+    double best, median;
+    size_t ops;
+}
+Result;
+
+void bench_error(const char* format, ...)
+{
+    va_list args;
+
+    fprintf(stderr, "#### BENCHMARK FAILED:\t");
+
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+
+    fprintf(stderr, "\n");
+}
+
+static int is_shape(const char* name)
+{
+    int i;
+
+    for (i = 0; bench_shapes[i].name != NULL; i++)
+        if (strcmp(bench_shapes[i].name, name) == 0)
+            return 1;
+
+    return 0;
+}
+
+static int is_case(const char* name)
+{
+    int i;
+
+    for (i = 0; bench_cases[i].name != NULL; i++)
+        if (strcmp(bench_cases[i].name, name) == 0)
+            return 1;
+
+    return 0;
+}
+
+/* naming no shape (or case) at all selects every one */
+static int selected(const Options* options, const char* name, int num_named)
+{
+    int i;
+
+    if (num_named == 0)
+        return 1;
+
+    for (i = 0; i < options->num_names; i++)
+        if (strcmp(options->names[i], name) == 0)
+            return 1;
+
+    return 0;
+}
+
+static void make_document(bench_Document* document, const bench_Shape* shape, unsigned scale)
+{
+    size_t capacity;
+
+    memset(document, 0, sizeof(*document));
+    document->shape = shape->name;
+    document->doc = cfx2_new_node(NULL);
+    bench_check(document->doc != NULL)
+
+    shape->build(document, scale);
+
+    capacity = 0;
+    bench_check(cfx2_write_to_buffer(document->doc, &document->text, &capacity, &document->text_length) == cfx2_ok)
+}
+
+static int compare_times(const void* left, const void* right)
+{
+    double a = *(const double*) left, b = *(const double*) right;
+
+    return (a > b) - (a < b);
+}
+
+static void run_case(bench_Document* document, const bench_Case* benchmark, const Options* options, Result* result)
+{
+    double* times, start;
+    void* state;
+    unsigned i;
+    size_t ops;
+
+    times = (double*) malloc(options->repetitions * sizeof(double));
+    bench_check(times != NULL)
+
+    ops = 0;
+
+    for (i = 0; i < options->warmups + options->repetitions; i++)
+    {
+        state = NULL;
+
+        if (benchmark->setup != NULL)
+            benchmark->setup(document, &state);
+
+        start = tests_seconds();
+        ops = benchmark->run(document, state);
+
+        if (i >= options->warmups)
+            times[i - options->warmups] = tests_seconds() - start;
+
+        if (benchmark->teardown != NULL)
+            benchmark->teardown(document, state);
+
+        if (ops == 0)
+            bench_fail(("%s failed on %s", benchmark->name, document->shape))
+    }
+
+    qsort(times, options->repetitions, sizeof(double), compare_times);
+
+    result->best = times[0];
+    result->median = times[options->repetitions / 2];
+    result->ops = ops;
+
+    free(times);
+}
+
+static void report(const bench_Document* document, const bench_Case* benchmark, const Options* options, const Result* result)
+{
+    double best;
+
+    /* a clock tick, for runs too short to measure */
+    best = (result->best > 1e-9) ? result->best : 1e-9;
+
+    if (options->csv)
+        printf("%s,%s,%lu,%lu,%lu,%u,%.4f,%.4f,%.2f,%.0f,%.0f\n", document->shape, benchmark->name,
+                (unsigned long) document->text_length, (unsigned long) document->num_nodes, (unsigned long) result->ops,
+                options->repetitions, result->best * 1000, result->median * 1000,
+                document->text_length / best / 1e6, document->num_nodes / best, result->ops / best);
+    else if (result->ops > 1)
+        printf("  %-16s best %10.3f ms   median %10.3f ms   %9.0f ops/s\n", benchmark->name,
+                result->best * 1000, result->median * 1000, result->ops / best);
+    else
+        printf("  %-16s best %10.3f ms   median %10.3f ms   %9.1f MB/s   %8.2f M nodes/s\n", benchmark->name,
+                result->best * 1000, result->median * 1000, document->text_length / best / 1e6, document->num_nodes / best / 1e6);
+
+    fflush(stdout);
+}
+
+static void list(void)
+{
+    int i;
+
+    printf("shapes:\n");
+
+    for (i = 0; bench_shapes[i].name != NULL; i++)
+        printf("  %-16s %s\n", bench_shapes[i].name, bench_shapes[i].desc);
+
+    printf("cases:\n");
+
+    for (i = 0; bench_cases[i].name != NULL; i++)
+        printf("  %-16s %s\n", bench_cases[i].name, bench_cases[i].desc);
+}
+
+int main(int argc, char** argv)
+{
+    bench_Document document;
+    Options options;
+    Result result;
+    int i, j;
+
+    options.repetitions = 5;
+    options.warmups = 1;
+    options.scale = 1;
+    options.csv = 0;
+    options.names = argv + 1;
+    options.num_names = 0;
+    options.num_shapes = 0;
+    options.num_cases = 0;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "-r", 2) == 0)
+            options.repetitions = (unsigned) atoi(argv[i] + 2);
+        else if (strncmp(argv[i], "-w", 2) == 0)
+            options.warmups = (unsigned) atoi(argv[i] + 2);
+        else if (strncmp(argv[i], "-s", 2) == 0)
+            options.scale = (unsigned) atoi(argv[i] + 2);
+        else if (strcmp(argv[i], "-csv") == 0)
+            options.csv = 1;
+        else if (strcmp(argv[i], "-l") == 0)
+        {
+            list();
+            return 0;
+        }
+        else if (is_shape(argv[i]) || is_case(argv[i]))
+        {
+            options.num_shapes += is_shape(argv[i]);
+            options.num_cases += is_case(argv[i]);
+            options.names[options.num_names++] = argv[i];
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: undefined shape or case '%s'\n", argv[i]);
+            return -1;
+        }
+    }
+
+    if (options.repetitions == 0 || options.scale == 0)
+    {
+        fprintf(stderr, "usage: %s [-r<repetitions>] [-w<warmups>] [-s<scale>] [-csv] [-l] [shape | case]...\n", argv[0]);
+        return -1;
+    }
+
+    fprintf(stderr, "#### Benchmarking: %s\n", libcfx2_version_full);
+    fprintf(stderr, "#### %u warmup(s), %u repetition(s), scale %u\n\n", options.warmups, options.repetitions, options.scale);
+
+    if (options.csv)
+        printf("shape,case,bytes,nodes,ops,repetitions,best_ms,median_ms,mb_per_s,nodes_per_s,ops_per_s\n");
+
+    for (i = 0; bench_shapes[i].name != NULL; i++)
+    {
+        if (!selected(&options, bench_shapes[i].name, options.num_shapes))
+            continue;
+
+        make_document(&document, &bench_shapes[i], options.scale);
+
+        fprintf(stderr, "####==== Shape '%s': %lu nodes, %.1f MB of text\n", document.shape,
+                (unsigned long) document.num_nodes, document.text_length / 1e6);
+
+        for (j = 0; bench_cases[j].name != NULL; j++)
+        {
+            if (!selected(&options, bench_cases[j].name, options.num_cases))
+                continue;
+
+            run_case(&document, &bench_cases[j], &options, &result);
+            report(&document, &bench_cases[j], &options, &result);
+        }
+
+        free(document.text);
+        cfx2_release_node(&document.doc);
+    }
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+#ifndef libcfx2_bench_h_included
+#define libcfx2_bench_h_included
+
+#include <confix2.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* a generated document, as a tree and as text */
+typedef struct
+{
+    const char*     shape;
+    cfx2_Node*      doc;
+    char*           text;
+    size_t          text_length;
+    size_t          num_nodes;
+
+    /* a query for a value at the end of the document */
+    char            query[1024];
+}
+bench_Document;
+
+typedef struct
+{
+    const char*     name;
+    const char*     desc;
+    void            (*build)(bench_Document* document, unsigned scale);
+}
+bench_Shape;
+
+/*
+ *  Only run is timed. setup and teardown (either may be NULL) prepare and clean up
+ *  around each run through *state. run returns how many operations it did, 0 if it failed.
+ */
+typedef struct
+{
+    const char*     name;
+    const char*     desc;
+    void            (*setup)(bench_Document* document, void** state);
+    size_t          (*run)(bench_Document* document, void* state);
+    void            (*teardown)(bench_Document* document, void* state);
+}
+bench_Case;
+
+#define bench_check(assertion_) { if (!(assertion_)) bench_fail(("failed check '%s'", #assertion_)); }
+#define bench_fail(error_) { bench_error error_; exit(-1); }
+
+void            bench_error(const char* format, ...);
+
+extern const bench_Shape bench_shapes[];
+extern const bench_Case bench_cases[];
+
+#endif
@@ -0,0 +1,194 @@
+
+#include "bench.h"
+
+#include "lexer.h"
+
+#include <string.h>
+
+#define query_repeats       1000
+
+static void borrowed_input(cfx2_RdOpt* rd_opt, bench_Document* document, int flags)
+{
+    memset(rd_opt, 0, sizeof(*rd_opt));
+
+    rd_opt->document = document->text;
+    rd_opt->document_len = document->text_length;
+    rd_opt->flags = cfx2_borrowed_input | flags;
+}
+
+/* tokens only */
+static size_t run_lex(bench_Document* document, void* state)
+{
+    cfx2_RdOpt rd_opt;
+    Lexer lexer;
+    Token* token;
+    int rc;
+
+    borrowed_input(&rd_opt, document, 0);
+    bench_check(create_lexer(&lexer, &rd_opt) == cfx2_ok)
+
+    while ((rc = lexer_read(&lexer, &token)) == cfx2_ok)
+        ;
+
+    return rc == cfx2_EOF;
+}
+
+/* the whole grammar, no tree */
+static size_t run_parse_events(bench_Document* document, void* state)
+{
+    cfx2_ReadHandler handler;
+    cfx2_RdOpt rd_opt;
+
+    memset(&handler, 0, sizeof(handler));
+    borrowed_input(&rd_opt, document, 0);
+
+    return cfx2_read_events(&handler, &rd_opt) == cfx2_ok;
+}
+
+static size_t parse_with(bench_Document* document, cfx2_Node** doc_ptr, int flags)
+{
+    cfx2_RdOpt rd_opt;
+
+    borrowed_input(&rd_opt, document, flags);
+
+    return cfx2_read(doc_ptr, &rd_opt) == cfx2_ok;
+}
+
+static size_t run_parse(bench_Document* document, void* state)
+{
+    return parse_with(document, (cfx2_Node**) state, 0);
+}
+
+static size_t run_parse_arena(bench_Document* document, void* state)
+{
+    return parse_with(document, (cfx2_Node**) state, cfx2_arena_document);
+}
+
+static size_t run_parse_parallel(bench_Document* document, void* state)
+{
+    return parse_with(document, (cfx2_Node**) state, cfx2_parallel_input);
+}
+
+/* parsing leaves its document in the slot setup_parse gives it */
+static void setup_parse(bench_Document* document, void** state)
+{
+    *state = malloc(sizeof(cfx2_Node*));
+    bench_check(*state != NULL)
+    *(cfx2_Node**) *state = NULL;
+}
+
+static void teardown_parse(bench_Document* document, void* state)
+{
+    cfx2_release_node((cfx2_Node**) state);
+    free(state);
+}
+
+/* into a buffer that is just big enough */
+static void setup_write(bench_Document* document, void** state)
+{
+    *state = malloc(document->text_length);
+    bench_check(*state != NULL)
+}
+
+static void teardown_write(bench_Document* document, void* state)
+{
+    free(state);
+}
+
+static size_t run_write(bench_Document* document, void* state)
+{
+    size_t used;
+
+    return cfx2_write_to_fixed_buffer(document->doc, (char*) state, document->text_length, &used) == cfx2_ok
+            && used == document->text_length;
+}
+
+/* into a buffer of its own, grown as it goes */
+static size_t run_write_buffer(bench_Document* document, void* state)
+{
+    char* text;
+    size_t capacity, used;
+    int rc;
+
+    text = NULL;
+    capacity = 0;
+    used = 0;
+
+    rc = cfx2_write_to_buffer(document->doc, &text, &capacity, &used);
+    free(text);
+
+    return rc == cfx2_ok && used == document->text_length;
+}
+
+static size_t run_measure(bench_Document* document, void* state)
+{
+    size_t size;
+
+    return cfx2_measure_document(document->doc, &size) == cfx2_ok && size == document->text_length;
+}
+
+static size_t run_query(bench_Document* document, void* state)
+{
+    size_t i;
+
+    for (i = 0; i < query_repeats; i++)
+        if (cfx2_query_value(document->doc, document->query) == NULL)
+            return 0;
+
+    return query_repeats;
+}
+
+/* every node through a pattern */
+static size_t run_query_all(bench_Document* document, void* state)
+{
+    cfx2_QueryIter* iter;
+    size_t count;
+
+    if (cfx2_query_all(&iter, document->doc, "**") != cfx2_ok)
+        return 0;
+
+    for (count = 0; cfx2_query_iter_next(iter, NULL) == cfx2_node; count++)
+        ;
+
+    cfx2_release_query_iter(&iter);
+    return count == document->num_nodes + 1;
+}
+
+static size_t run_clone(bench_Document* document, void* state)
+{
+    *(cfx2_Node**) state = cfx2_clone_node(document->doc, cfx2_clone_recursive);
+
+    return *(cfx2_Node**) state != NULL;
+}
+
+static void setup_release(bench_Document* document, void** state)
+{
+    setup_parse(document, state);
+
+    *(cfx2_Node**) *state = cfx2_clone_node(document->doc, cfx2_clone_recursive);
+    bench_check(*(cfx2_Node**) *state != NULL)
+}
+
+static size_t run_release(bench_Document* document, void* state)
+{
+    cfx2_release_node((cfx2_Node**) state);
+
+    return *(cfx2_Node**) state == NULL;
+}
+
+const bench_Case bench_cases[] =
+{
+    { "lex",            "tokenize the text",                        NULL,           run_lex,            NULL },
+    { "parse_events",   "parse the text without building a tree",   NULL,           run_parse_events,   NULL },
+    { "parse",          "read the text into a tree",                setup_parse,    run_parse,          teardown_parse },
+    { "parse_arena",    "read the text into an arena document",     setup_parse,    run_parse_arena,    teardown_parse },
+    { "parse_parallel", "read the text on all processors",          setup_parse,    run_parse_parallel, teardown_parse },
+    { "measure",        "compute the size of the text",             NULL,           run_measure,        NULL },
+    { "write",          "write the tree into a fixed buffer",       setup_write,    run_write,          teardown_write },
+    { "write_buffer",   "write the tree into a growing buffer",     NULL,           run_write_buffer,   NULL },
+    { "query",          "look up a value 1000 times",               NULL,           run_query,          NULL },
+    { "query_all",      "visit every node with a '**' query",       NULL,           run_query_all,      NULL },
+    { "clone",          "clone the tree",                           setup_parse,    run_clone,          teardown_parse },
+    { "release",        "release a clone of the tree",              setup_release,  run_release,        teardown_parse },
+    { NULL }
+};
@@ -0,0 +1,131 @@
+
+#include "bench.h"
+
+#include <string.h>
+
+#define wide_count          100000
+#define deep_chains         1000
+#define deep_depth          50
+#define attribs_count       5000
+#define attribs_per_node    40
+#define long_count          500
+#define long_length         16384
+
+static cfx2_Node* add_child(bench_Document* document, cfx2_Node* parent, const char* name, const char* text)
+{
+    cfx2_Node* node;
+
+    node = cfx2_create_child(parent, name, text, cfx2_multiple);
+    bench_check(node != NULL)
+
+    document->num_nodes++;
+    return node;
+}
+
+/* many top-level nodes with a short text and a few attributes */
+static void build_wide(bench_Document* document, unsigned scale)
+{
+    cfx2_Node* node;
+    char name[32], text[32];
+    size_t i, count;
+
+    count = wide_count * scale;
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "item%i", (int) i);
+        sprintf(text, "value %i", (int) i);
+
+        node = add_child(document, document->doc, name, text);
+        bench_check(cfx2_set_node_attrib_int(node, "id", (long) i) == cfx2_ok)
+        bench_check(cfx2_set_node_attrib(node, "kind", (i % 2 == 0) ? "even" : "odd") == cfx2_ok)
+    }
+
+    sprintf(document->query, "item%i.id", (int) (count - 1));
+}
+
+/* chains of nested nodes */
+static void build_deep(bench_Document* document, unsigned scale)
+{
+    cfx2_Node* node;
+    char name[32], text[32];
+    size_t i, j, count;
+
+    count = deep_chains * scale;
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "chain%i", (int) i);
+        node = add_child(document, document->doc, name, NULL);
+
+        for (j = 0; j < deep_depth; j++)
+        {
+            sprintf(text, "depth %i", (int) j);
+            node = add_child(document, node, "level", text);
+        }
+    }
+
+    sprintf(document->query, "chain%i", (int) (count - 1));
+
+    for (j = 0; j < deep_depth; j++)
+        strcat(document->query, "/level");
+}
+
+/* nodes with long attribute lists */
+static void build_attribs(bench_Document* document, unsigned scale)
+{
+    cfx2_Node* node;
+    char name[32], value[32];
+    size_t i, j, count;
+
+    count = attribs_count * scale;
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "node%i", (int) i);
+        node = add_child(document, document->doc, name, NULL);
+
+        for (j = 0; j < attribs_per_node; j++)
+        {
+            sprintf(name, "a%i", (int) j);
+            sprintf(value, "%i of %i", (int) j, (int) i);
+            bench_check(cfx2_set_node_attrib(node, name, value) == cfx2_ok)
+        }
+    }
+
+    sprintf(document->query, "node%i.a%i", (int) (count - 1), attribs_per_node - 1);
+}
+
+/* few nodes with long texts, some characters escaped */
+static void build_long_strings(bench_Document* document, unsigned scale)
+{
+    char name[32], * text;
+    size_t i, j, count;
+
+    text = (char*) malloc(long_length + 1);
+    bench_check(text != NULL)
+
+    for (j = 0; j < long_length; j++)
+        text[j] = (j % 97 == 96) ? '\'' : (j % 13 == 12) ? ' ' : 'a' + j % 26;
+
+    text[long_length] = 0;
+    count = long_count * scale;
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "text%i", (int) i);
+        add_child(document, document->doc, name, text);
+    }
+
+    free(text);
+    sprintf(document->query, "text%i", (int) (count - 1));
+}
+
+const bench_Shape bench_shapes[] =
+{
+    { "wide",           "100k top-level nodes with a text and 2 attributes",    build_wide },
+    { "deep",           "1k chains of 50 nested nodes",                         build_deep },
+    { "attribs",        "5k nodes with 40 attributes each",                     build_attribs },
+    { "long_strings",   "500 nodes with 16 KiB texts",                          build_long_strings },
+    { NULL }
+};
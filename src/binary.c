@@ -0,0 +1,876 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+#include "alloc.h"
+#include "binary.h"
+#include "index.h"
+#include "io.h"
+#include "reader.h"
+
+#include <confix2.h>
+#include <stdio.h>
+#include <string.h>
+
+/* -------------------------------------------------------------------------- */
+/*  Binary Writer                                                             */
+/* -------------------------------------------------------------------------- */
+
+static void put_u32( char* p, cfx2_uint32_t value )
+{
+    cfx2_uint8_t* bytes = ( cfx2_uint8_t* )p;
+
+    bytes[0] = ( cfx2_uint8_t )( value & 0xFF );
+    bytes[1] = ( cfx2_uint8_t )( ( value >> 8 ) & 0xFF );
+    bytes[2] = ( cfx2_uint8_t )( ( value >> 16 ) & 0xFF );
+    bytes[3] = ( cfx2_uint8_t )( ( value >> 24 ) & 0xFF );
+}
+
+static StringEntry_t* strings_find( StringEntry_t* entries, size_t capacity, const char* string, size_t length, size_t hash )
+{
+    size_t i;
+
+    for ( i = hash & ( capacity - 1 ); entries[i].string != NULL; i = ( i + 1 ) & ( capacity - 1 ) )
+    {
+        if ( entries[i].hash == hash && entries[i].length == length
+                && memcmp( entries[i].string, string, length ) == 0 )
+            break;
+    }
+
+    return &entries[i];
+}
+
+static int strings_grow( StringTable_t* table )
+{
+    StringEntry_t* entries;
+    size_t capacity, i;
+
+    capacity = table->capacity ? table->capacity * 2 : 256;
+    entries = ( StringEntry_t* )libcfx2_malloc( capacity * sizeof( StringEntry_t ), table->category );
+
+    if ( entries == NULL )
+        return cfx2_alloc_error;
+
+    memset( entries, 0, capacity * sizeof( StringEntry_t ) );
+
+    for ( i = 0; i < table->capacity; i++ )
+        if ( table->entries[i].string != NULL )
+            *strings_find( entries, capacity, table->entries[i].string, table->entries[i].length,
+                    table->entries[i].hash ) = table->entries[i];
+
+    libcfx2_free( table->entries );
+    table->entries = entries;
+    table->capacity = capacity;
+    return cfx2_ok;
+}
+
+void cfx2_strings_init( StringTable_t* table, int category )
+{
+    table->entries = NULL;
+    table->capacity = 0;
+    table->used = 0;
+    table->size = 0;
+    table->category = category;
+}
+
+void cfx2_strings_release( StringTable_t* table )
+{
+    libcfx2_free( table->entries );
+    cfx2_strings_init( table, table->category );
+}
+
+int cfx2_strings_add( StringTable_t* table, const char* string, cfx2_uint32_t* ref )
+{
+    StringEntry_t* entry;
+    size_t length, hash;
+    int rc;
+
+    if ( string == NULL )
+    {
+        *ref = BINARY_NONE;
+        return cfx2_ok;
+    }
+
+    if ( ( table->used + 1 ) * 2 > table->capacity && ( rc = strings_grow( table ) ) != cfx2_ok )
+        return rc;
+
+    length = strlen( string );
+    hash = cfx2_hash_bytes( string, length );
+    entry = strings_find( table->entries, table->capacity, string, length, hash );
+
+    if ( entry->string == NULL )
+    {
+        /* length, characters, NUL and padding */
+        if ( length > BINARY_NONE - 16 || table->size > BINARY_NONE - 16 - length )
+            return cfx2_param_invalid;
+
+        entry->string = string;
+        entry->length = length;
+        entry->hash = hash;
+        entry->ref = ( cfx2_uint32_t )( table->size + 4 );
+
+        table->size += ( 4 + length + 1 + 3 ) & ~( size_t )3;
+        table->used++;
+    }
+
+    *ref = entry->ref;
+    return cfx2_ok;
+}
+
+void cfx2_strings_write( const StringTable_t* table, char* strings )
+{
+    const StringEntry_t* entry;
+    size_t i;
+
+    /* the padding is zeroed too */
+    memset( strings, 0, table->size );
+
+    for ( i = 0; i < table->capacity; i++ )
+    {
+        entry = &table->entries[i];
+
+        if ( entry->string != NULL )
+        {
+            put_u32( strings + entry->ref - 4, ( cfx2_uint32_t )entry->length );
+            memcpy( strings + entry->ref, entry->string, entry->length );
+        }
+    }
+}
+
+/* all nodes breadth-first, the document first */
+static int order_nodes( cfx2_Node* doc, cfx2_Node*** nodes_out, size_t* num_nodes_out, size_t* num_attribs_out )
+{
+    cfx2_Node** nodes, ** grown;
+    size_t capacity, num_nodes, num_attribs, i, j;
+    cfx2_Node* node;
+
+    capacity = 64;
+    nodes = ( cfx2_Node** )libcfx2_malloc( capacity * sizeof( cfx2_Node* ), cfx2_mem_output );
+
+    if ( nodes == NULL )
+        return cfx2_alloc_error;
+
+    nodes[0] = doc;
+    num_nodes = 1;
+    num_attribs = 0;
+
+    for ( i = 0; i < num_nodes; i++ )
+    {
+        node = nodes[i];
+        num_attribs += cfx2_list_length( node->attributes );
+
+        if ( num_nodes + cfx2_list_length( node->children ) > capacity )
+        {
+            while ( num_nodes + cfx2_list_length( node->children ) > capacity )
+                capacity *= 2;
+
+            grown = ( cfx2_Node** )libcfx2_realloc( nodes, capacity * sizeof( cfx2_Node* ), cfx2_mem_output );
+
+            if ( grown == NULL )
+            {
+                libcfx2_free( nodes );
+                return cfx2_alloc_error;
+            }
+
+            nodes = grown;
+        }
+
+        for ( j = 0; j < cfx2_list_length( node->children ); j++ )
+            nodes[num_nodes++] = cfx2_item( node->children, j, cfx2_Node* );
+    }
+
+    *nodes_out = nodes;
+    *num_nodes_out = num_nodes;
+    *num_attribs_out = num_attribs;
+    return cfx2_ok;
+}
+
+/*
+ *  The whole file is built in memory: the string table has to be complete before
+ *  its size is known, and the records refer to it.
+ */
+static int build_binary( cfx2_Node* doc, char** data_out, size_t* size_out )
+{
+    StringTable_t table;
+    cfx2_Node** nodes;
+    cfx2_Node* node;
+    cfx2_Attrib* attrib;
+    size_t num_nodes, num_attribs, nodes_at, attribs_at, strings_at, size, next_child, next_attrib, i, j;
+    cfx2_uint32_t name, text, value;
+    char* data, * record;
+    int rc;
+
+    if ( ( rc = order_nodes( doc, &nodes, &num_nodes, &num_attribs ) ) != cfx2_ok )
+        return rc;
+
+    cfx2_strings_init( &table, cfx2_mem_output );
+    data = NULL;
+    size = 0;
+
+    /* the same checks as the text writer */
+    for ( i = 1; i < num_nodes; i++ )
+        if ( nodes[i]->name == NULL || nodes[i]->name[0] == 0 )
+        {
+            rc = cfx2_missing_node_name;
+            goto done;
+        }
+
+    /* string references first, to size the table */
+    for ( i = 0; i < num_nodes && rc == cfx2_ok; i++ )
+    {
+        node = nodes[i];
+
+        if ( i > 0 )
+        {
+            if ( ( rc = cfx2_strings_add( &table, node->name, &name ) ) != cfx2_ok
+                    || ( rc = cfx2_strings_add( &table, node->text, &text ) ) != cfx2_ok )
+                break;
+        }
+
+        for ( j = 0; j < cfx2_list_length( node->attributes ) && rc == cfx2_ok; j++ )
+        {
+            attrib = &cfx2_item( node->attributes, j, cfx2_Attrib );
+
+            if ( ( rc = cfx2_strings_add( &table, attrib->name != NULL ? attrib->name : "", &name ) ) == cfx2_ok )
+                rc = cfx2_strings_add( &table, attrib->value, &value );
+        }
+    }
+
+    if ( rc != cfx2_ok )
+        goto done;
+
+    nodes_at = BINARY_HEADER_SIZE;
+    attribs_at = nodes_at + num_nodes * BINARY_NODE_SIZE;
+    strings_at = attribs_at + num_attribs * BINARY_ATTRIB_SIZE;
+    size = strings_at + table.size;
+
+    /* every offset must fit in 32 bits */
+    if ( num_nodes > BINARY_NONE / BINARY_NODE_SIZE || num_attribs > BINARY_NONE / BINARY_ATTRIB_SIZE
+            || size < strings_at || size >= BINARY_NONE )
+    {
+        rc = cfx2_param_invalid;
+        goto done;
+    }
+
+    data = ( char* )libcfx2_malloc( size, cfx2_mem_output );
+
+    if ( data == NULL )
+    {
+        rc = cfx2_alloc_error;
+        goto done;
+    }
+
+    memcpy( data + BH_MAGIC, BINARY_MAGIC, 4 );
+    put_u32( data + BH_VERSION, BINARY_VERSION );
+    put_u32( data + BH_NUM_NODES, ( cfx2_uint32_t )num_nodes );
+    put_u32( data + BH_NUM_ATTRIBS, ( cfx2_uint32_t )num_attribs );
+    put_u32( data + BH_NODES, ( cfx2_uint32_t )nodes_at );
+    put_u32( data + BH_ATTRIBS, ( cfx2_uint32_t )attribs_at );
+    put_u32( data + BH_STRINGS, ( cfx2_uint32_t )strings_at );
+    put_u32( data + BH_STRINGS_SIZE, ( cfx2_uint32_t )table.size );
+
+    /* children and attributes follow in the same order as their parents */
+    next_child = 1;
+    next_attrib = 0;
+
+    for ( i = 0; i < num_nodes; i++ )
+    {
+        node = nodes[i];
+        record = data + nodes_at + i * BINARY_NODE_SIZE;
+
+        name = text = BINARY_NONE;
+
+        if ( i > 0 )
+        {
+            cfx2_strings_add( &table, node->name, &name );
+            cfx2_strings_add( &table, node->text, &text );
+        }
+
+        put_u32( record + BN_NAME, name );
+        put_u32( record + BN_TEXT, text );
+        put_u32( record + BN_FIRST_CHILD, ( cfx2_uint32_t )next_child );
+        put_u32( record + BN_NUM_CHILDREN, ( cfx2_uint32_t )cfx2_list_length( node->children ) );
+        put_u32( record + BN_FIRST_ATTRIB, ( cfx2_uint32_t )next_attrib );
+        put_u32( record + BN_NUM_ATTRIBS, ( cfx2_uint32_t )cfx2_list_length( node->attributes ) );
+
+        for ( j = 0; j < cfx2_list_length( node->attributes ); j++ )
+        {
+            attrib = &cfx2_item( node->attributes, j, cfx2_Attrib );
+            record = data + attribs_at + ( next_attrib + j ) * BINARY_ATTRIB_SIZE;
+
+            cfx2_strings_add( &table, attrib->name != NULL ? attrib->name : "", &name );
+            cfx2_strings_add( &table, attrib->value, &value );
+
+            put_u32( record + BA_NAME, name );
+            put_u32( record + BA_VALUE, value );
+        }
+
+        next_child += cfx2_list_length( node->children );
+        next_attrib += cfx2_list_length( node->attributes );
+    }
+
+    cfx2_strings_write( &table, data + strings_at );
+
+done:
+    cfx2_strings_release( &table );
+    libcfx2_free( nodes );
+
+    *data_out = data;
+    *size_out = size;
+    return rc;
+}
+
+libcfx2 int cfx2_save_binary( cfx2_Node* doc, const char* filename )
+{
+    FILE* file;
+    char* data;
+    size_t size;
+    int rc;
+
+    if ( doc == NULL || filename == NULL )
+        return cfx2_param_invalid;
+
+    if ( ( rc = build_binary( doc, &data, &size ) ) != cfx2_ok )
+        return rc;
+
+    file = fopen( filename, "wb" );
+
+    if ( file == NULL )
+        rc = cfx2_cant_open_file;
+    else
+    {
+        if ( fwrite( data, 1, size, file ) != size )
+            rc = cfx2_write_error;
+
+        if ( fclose( file ) != 0 && rc == cfx2_ok )
+            rc = cfx2_write_error;
+    }
+
+    libcfx2_free( data );
+    return rc;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Binary Reader                                                             */
+/* -------------------------------------------------------------------------- */
+
+static int check_string( const BinaryDoc_t* bin, cfx2_uint32_t ref, int allow_none )
+{
+    cfx2_uint32_t length;
+
+    if ( ref == BINARY_NONE )
+        return allow_none;
+
+    if ( ref < 4 || ref % 4 != 0 || ref > bin->strings_size )
+        return 0;
+
+    length = binary_string_length( bin, ref );
+
+    return length < bin->strings_size - ref && bin->strings[ref + length] == 0;
+}
+
+int cfx2_binary_open( BinaryDoc_t* bin, const char* data, size_t size )
+{
+    cfx2_uint32_t nodes_at, attribs_at, strings_at;
+
+    if ( data == NULL || size < BINARY_HEADER_SIZE
+            || memcmp( data + BH_MAGIC, BINARY_MAGIC, 4 ) != 0
+            || binary_get_u32( data + BH_VERSION ) != BINARY_VERSION )
+        return cfx2_bad_format;
+
+    bin->data = data;
+    bin->size = size;
+    bin->num_nodes = binary_get_u32( data + BH_NUM_NODES );
+    bin->num_attribs = binary_get_u32( data + BH_NUM_ATTRIBS );
+    bin->strings_size = binary_get_u32( data + BH_STRINGS_SIZE );
+
+    nodes_at = binary_get_u32( data + BH_NODES );
+    attribs_at = binary_get_u32( data + BH_ATTRIBS );
+    strings_at = binary_get_u32( data + BH_STRINGS );
+
+    /* sections in order, aligned and within the data */
+    if ( bin->num_nodes == 0 || nodes_at % 4 != 0 || attribs_at % 4 != 0 || strings_at % 4 != 0
+            || nodes_at < BINARY_HEADER_SIZE || nodes_at > size
+            || bin->num_nodes > ( size - nodes_at ) / BINARY_NODE_SIZE
+            || attribs_at < nodes_at + ( size_t )bin->num_nodes * BINARY_NODE_SIZE || attribs_at > size
+            || bin->num_attribs > ( size - attribs_at ) / BINARY_ATTRIB_SIZE
+            || strings_at < attribs_at + ( size_t )bin->num_attribs * BINARY_ATTRIB_SIZE || strings_at > size
+            || bin->strings_size > size - strings_at )
+        return cfx2_bad_format;
+
+    bin->nodes = data + nodes_at;
+    bin->attribs = data + attribs_at;
+    bin->strings = data + strings_at;
+
+    return cfx2_ok;
+}
+
+int cfx2_binary_check( const BinaryDoc_t* bin )
+{
+    cfx2_uint32_t i, j;
+    size_t next_child, next_attrib;
+    const char* record;
+
+    next_child = 1;
+    next_attrib = 0;
+
+    for ( i = 0; i < bin->num_nodes; i++ )
+    {
+        record = binary_node( bin, i );
+
+        if ( !check_string( bin, binary_get_u32( record + BN_NAME ), i == 0 )
+                || !check_string( bin, binary_get_u32( record + BN_TEXT ), 1 )
+                || binary_get_u32( record + BN_FIRST_CHILD ) != next_child
+                || binary_get_u32( record + BN_FIRST_ATTRIB ) != next_attrib )
+            return cfx2_bad_format;
+
+        /* children come after their parent, so every node is reached exactly once */
+        if ( binary_get_u32( record + BN_NUM_CHILDREN ) > 0 && next_child <= i )
+            return cfx2_bad_format;
+
+        next_child += binary_get_u32( record + BN_NUM_CHILDREN );
+        next_attrib += binary_get_u32( record + BN_NUM_ATTRIBS );
+
+        if ( next_child > bin->num_nodes || next_attrib > bin->num_attribs )
+            return cfx2_bad_format;
+    }
+
+    if ( next_child != bin->num_nodes || next_attrib != bin->num_attribs )
+        return cfx2_bad_format;
+
+    for ( j = 0; j < bin->num_attribs; j++ )
+    {
+        record = binary_attrib( bin, j );
+
+        if ( !check_string( bin, binary_get_u32( record + BA_NAME ), 0 )
+                || !check_string( bin, binary_get_u32( record + BA_VALUE ), 1 ) )
+            return cfx2_bad_format;
+    }
+
+    return cfx2_ok;
+}
+
+/* a node being walked and the next of its children to visit */
+typedef struct
+{
+    cfx2_uint32_t index, next_child;
+}
+WalkEntry_t;
+
+#define emit( call_ ) if ( ( call_ ) != cfx2_continue ) { rc = cfx2_interrupted; break; }
+
+static int emit_node( const cfx2_ReadHandler* handler, const BinaryDoc_t* bin, cfx2_uint32_t index )
+{
+    const char* node, * attrib;
+    cfx2_uint32_t ref, value, i;
+
+    node = binary_node( bin, index );
+
+    if ( index > 0 )
+    {
+        ref = binary_get_u32( node + BN_NAME );
+
+        if ( handler->begin_node != NULL
+                && handler->begin_node( handler->user, binary_string( bin, ref ), binary_string_length( bin, ref ) ) != cfx2_continue )
+            return cfx2_stop;
+
+        ref = binary_get_u32( node + BN_TEXT );
+
+        if ( ref != BINARY_NONE && handler->node_text != NULL
+                && handler->node_text( handler->user, binary_string( bin, ref ), binary_string_length( bin, ref ) ) != cfx2_continue )
+            return cfx2_stop;
+    }
+
+    if ( handler->attrib == NULL )
+        return cfx2_continue;
+
+    for ( i = 0; i < binary_get_u32( node + BN_NUM_ATTRIBS ); i++ )
+    {
+        attrib = binary_attrib( bin, binary_get_u32( node + BN_FIRST_ATTRIB ) + i );
+        ref = binary_get_u32( attrib + BA_NAME );
+        value = binary_get_u32( attrib + BA_VALUE );
+
+        if ( handler->attrib( handler->user, binary_string( bin, ref ), binary_string_length( bin, ref ),
+                binary_string( bin, value ), value != BINARY_NONE ? binary_string_length( bin, value ) : 0 ) != cfx2_continue )
+            return cfx2_stop;
+    }
+
+    return cfx2_continue;
+}
+
+/* reports the nodes depth-first, in the order they were in the text document */
+static int produce_binary( const cfx2_ReadHandler* handler, void* source )
+{
+    const BinaryDoc_t* bin = ( const BinaryDoc_t* )source;
+    WalkEntry_t* stack, * grown, * top;
+    size_t depth, max_depth;
+    const char* node;
+    cfx2_uint32_t child;
+    int rc;
+
+    max_depth = 64;
+    stack = ( WalkEntry_t* )libcfx2_malloc( max_depth * sizeof( WalkEntry_t ), cfx2_mem_parser );
+
+    if ( stack == NULL )
+        return cfx2_alloc_error;
+
+    if ( emit_node( handler, bin, 0 ) != cfx2_continue )
+    {
+        libcfx2_free( stack );
+        return cfx2_interrupted;
+    }
+
+    stack[0].index = 0;
+    stack[0].next_child = 0;
+    depth = 1;
+    rc = cfx2_ok;
+
+    while ( depth > 0 )
+    {
+        top = &stack[depth - 1];
+        node = binary_node( bin, top->index );
+
+        if ( top->next_child == binary_get_u32( node + BN_NUM_CHILDREN ) )
+        {
+            depth--;
+
+            if ( depth > 0 && handler->end_node != NULL )
+                emit( handler->end_node( handler->user ) )
+
+            continue;
+        }
+
+        child = binary_get_u32( node + BN_FIRST_CHILD ) + top->next_child++;
+
+        if ( depth == max_depth )
+        {
+            grown = ( WalkEntry_t* )libcfx2_realloc( stack, max_depth * 2 * sizeof( WalkEntry_t ), cfx2_mem_parser );
+
+            if ( grown == NULL )
+            {
+                rc = cfx2_alloc_error;
+                break;
+            }
+
+            stack = grown;
+            max_depth *= 2;
+        }
+
+        emit( emit_node( handler, bin, child ) )
+
+        stack[depth].index = child;
+        stack[depth].next_child = 0;
+        depth++;
+    }
+
+    libcfx2_free( stack );
+    return rc;
+}
+
+#undef emit
+
+libcfx2 int cfx2_load_binary( cfx2_Node** doc_ptr, const char* filename, const cfx2_RdOpt* rd_opt_in )
+{
+    cfx2_RdOpt rd_opt, options;
+    BinaryDoc_t bin;
+    int rc;
+
+    if ( doc_ptr == NULL || filename == NULL )
+        return cfx2_param_invalid;
+
+    /* the records are used in place, so the file is always mapped if possible */
+    if ( rd_opt_in != NULL )
+        memcpy( &options, rd_opt_in, sizeof( options ) );
+    else
+        memset( &options, 0, sizeof( options ) );
+
+    options.flags |= cfx2_mapped_input;
+
+    if ( ( rc = cfx2_file_input( &rd_opt, filename, &options ) ) != cfx2_ok )
+        return rc;
+
+    rc = cfx2_binary_open( &bin, rd_opt.document, rd_opt.document_len );
+
+    if ( rc == cfx2_ok )
+        rc = cfx2_binary_check( &bin );
+
+    if ( rc == cfx2_ok )
+        rc = cfx2_build_document( doc_ptr, &rd_opt, produce_binary, &bin );
+    else if ( rd_opt.on_error != NULL )
+        rd_opt.on_error( &rd_opt, rc, 0, cfx2_get_error_desc( rc ) );
+
+    cfx2_release_input( &rd_opt );
+    return rc;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Views                                                                     */
+/* -------------------------------------------------------------------------- */
+
+/*
+ *  Views only check the header when opened, so they start in constant time.
+ *  Every record is checked as it is used instead: references out of range read
+ *  as missing, and children must come after their parent, so no walk can loop.
+ */
+struct cfx2_View
+{
+    cfx2_RdOpt input;           /* document not owned if input.flags has cfx2_borrowed_input */
+    BinaryDoc_t bin;
+};
+
+static int open_view( cfx2_View** view_ptr, cfx2_View* view )
+{
+    int rc;
+
+    if ( ( rc = cfx2_binary_open( &view->bin, view->input.document, view->input.document_len ) ) != cfx2_ok )
+    {
+        cfx2_release_input( &view->input );
+        libcfx2_free( view );
+        return rc;
+    }
+
+    *view_ptr = view;
+    return cfx2_ok;
+}
+
+libcfx2 int cfx2_open_view( cfx2_View** view_ptr, const char* filename )
+{
+    cfx2_View* view;
+    int rc;
+
+    if ( view_ptr == NULL || filename == NULL )
+        return cfx2_param_invalid;
+
+    view = ( cfx2_View* )libcfx2_malloc( sizeof( cfx2_View ), cfx2_mem_input );
+
+    if ( view == NULL )
+        return cfx2_alloc_error;
+
+    memset( &view->input, 0, sizeof( view->input ) );
+
+    if ( ( rc = cfx2_mapped_input_from_file( &view->input, filename ) ) != cfx2_ok )
+    {
+        libcfx2_free( view );
+        return rc;
+    }
+
+    return open_view( view_ptr, view );
+}
+
+libcfx2 int cfx2_open_view_from_memory( cfx2_View** view_ptr, const char* data, size_t size )
+{
+    cfx2_View* view;
+
+    if ( view_ptr == NULL || data == NULL )
+        return cfx2_param_invalid;
+
+    view = ( cfx2_View* )libcfx2_malloc( sizeof( cfx2_View ), cfx2_mem_input );
+
+    if ( view == NULL )
+        return cfx2_alloc_error;
+
+    memset( &view->input, 0, sizeof( view->input ) );
+    view->input.document = data;
+    view->input.document_len = size;
+    view->input.flags = cfx2_borrowed_input;
+
+    return open_view( view_ptr, view );
+}
+
+libcfx2 void cfx2_release_view( cfx2_View** view_ptr )
+{
+    cfx2_View* view;
+
+    if ( view_ptr == NULL || ( view = *view_ptr ) == NULL )
+        return;
+
+    cfx2_release_input( &view->input );
+    libcfx2_free( view );
+    *view_ptr = NULL;
+}
+
+static const char* view_node( const cfx2_View* view, cfx2_ViewNode node )
+{
+    if ( view == NULL || node >= view->bin.num_nodes )
+        return NULL;
+
+    return binary_node( &view->bin, node );
+}
+
+static const char* view_string( const cfx2_View* view, cfx2_uint32_t ref )
+{
+    return check_string( &view->bin, ref, 0 ) ? view->bin.strings + ref : NULL;
+}
+
+/* the children of record, or none if their range is broken */
+static cfx2_uint32_t view_children( const cfx2_View* view, cfx2_ViewNode node, const char* record, cfx2_uint32_t* first )
+{
+    cfx2_uint32_t count;
+
+    *first = binary_get_u32( record + BN_FIRST_CHILD );
+    count = binary_get_u32( record + BN_NUM_CHILDREN );
+
+    if ( *first <= node || *first > view->bin.num_nodes || count > view->bin.num_nodes - *first )
+        return 0;
+
+    return count;
+}
+
+static cfx2_uint32_t view_attribs( const cfx2_View* view, const char* record, cfx2_uint32_t* first )
+{
+    cfx2_uint32_t count;
+
+    *first = binary_get_u32( record + BN_FIRST_ATTRIB );
+    count = binary_get_u32( record + BN_NUM_ATTRIBS );
+
+    if ( *first > view->bin.num_attribs || count > view->bin.num_attribs - *first )
+        return 0;
+
+    return count;
+}
+
+libcfx2 const char* cfx2_view_name( const cfx2_View* view, cfx2_ViewNode node )
+{
+    const char* record;
+
+    if ( ( record = view_node( view, node ) ) == NULL )
+        return NULL;
+
+    return view_string( view, binary_get_u32( record + BN_NAME ) );
+}
+
+libcfx2 const char* cfx2_view_text( const cfx2_View* view, cfx2_ViewNode node )
+{
+    const char* record;
+
+    if ( ( record = view_node( view, node ) ) == NULL )
+        return NULL;
+
+    return view_string( view, binary_get_u32( record + BN_TEXT ) );
+}
+
+libcfx2 size_t cfx2_view_num_children( const cfx2_View* view, cfx2_ViewNode node )
+{
+    const char* record;
+    cfx2_uint32_t first;
+
+    if ( ( record = view_node( view, node ) ) == NULL )
+        return 0;
+
+    return view_children( view, node, record, &first );
+}
+
+libcfx2 cfx2_ViewNode cfx2_view_child( const cfx2_View* view, cfx2_ViewNode node, size_t index )
+{
+    const char* record;
+    cfx2_uint32_t first;
+
+    if ( ( record = view_node( view, node ) ) == NULL || index >= view_children( view, node, record, &first ) )
+        return cfx2_no_view_node;
+
+    return first + ( cfx2_uint32_t )index;
+}
+
+/* the first child of that name, comparing stored lengths before characters */
+libcfx2 cfx2_ViewNode cfx2_view_find_child( const cfx2_View* view, cfx2_ViewNode parent, const char* name )
+{
+    const char* record, * child_name;
+    cfx2_uint32_t first, count, ref, i;
+    size_t length;
+
+    if ( name == NULL || ( record = view_node( view, parent ) ) == NULL )
+        return cfx2_no_view_node;
+
+    count = view_children( view, parent, record, &first );
+    length = strlen( name );
+
+    for ( i = 0; i < count; i++ )
+    {
+        ref = binary_get_u32( binary_node( &view->bin, first + i ) + BN_NAME );
+
+        if ( ( child_name = view_string( view, ref ) ) != NULL && binary_string_length( &view->bin, ref ) == length
+                && memcmp( child_name, name, length ) == 0 )
+            return first + i;
+    }
+
+    return cfx2_no_view_node;
+}
+
+libcfx2 size_t cfx2_view_num_attribs( const cfx2_View* view, cfx2_ViewNode node )
+{
+    const char* record;
+    cfx2_uint32_t first;
+
+    if ( ( record = view_node( view, node ) ) == NULL )
+        return 0;
+
+    return view_attribs( view, record, &first );
+}
+
+libcfx2 int cfx2_view_attrib( const cfx2_View* view, cfx2_ViewNode node, size_t index, const char** name, const char** value )
+{
+    const char* record, * attrib;
+    cfx2_uint32_t first;
+
+    if ( ( record = view_node( view, node ) ) == NULL || index >= view_attribs( view, record, &first ) )
+        return cfx2_attrib_not_found;
+
+    attrib = binary_attrib( &view->bin, first + ( cfx2_uint32_t )index );
+
+    if ( name != NULL && ( *name = view_string( view, binary_get_u32( attrib + BA_NAME ) ) ) == NULL )
+        return cfx2_attrib_not_found;
+
+    if ( value != NULL )
+        *value = view_string( view, binary_get_u32( attrib + BA_VALUE ) );
+
+    return cfx2_ok;
+}
+
+libcfx2 int cfx2_view_find_attrib( const cfx2_View* view, cfx2_ViewNode node, const char* name, const char** value )
+{
+    const char* record, * attrib, * attrib_name;
+    cfx2_uint32_t first, count, ref, i;
+    size_t length;
+
+    if ( name == NULL || ( record = view_node( view, node ) ) == NULL )
+        return cfx2_attrib_not_found;
+
+    count = view_attribs( view, record, &first );
+    length = strlen( name );
+
+    for ( i = 0; i < count; i++ )
+    {
+        attrib = binary_attrib( &view->bin, first + i );
+        ref = binary_get_u32( attrib + BA_NAME );
+
+        if ( ( attrib_name = view_string( view, ref ) ) != NULL && binary_string_length( &view->bin, ref ) == length
+                && memcmp( attrib_name, name, length ) == 0 )
+        {
+            if ( value != NULL )
+                *value = view_string( view, binary_get_u32( attrib + BA_VALUE ) );
+
+            return cfx2_ok;
+        }
+    }
+
+    return cfx2_attrib_not_found;
+}
@@ -0,0 +1,134 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+#ifndef libcfx2_binary_h
+#define libcfx2_binary_h
+
+#include <confix2.h>
+
+/*
+ *  Binary documents: every field is a little-endian 32-bit integer, every record
+ *  4-byte aligned, so a mapped file can be used as it is.
+ *
+ *      header      BINARY_HEADER_SIZE bytes, see BH_*
+ *      nodes       num_nodes records of BINARY_NODE_SIZE bytes, see BN_*
+ *      attributes  num_attribs records of BINARY_ATTRIB_SIZE bytes, see BA_*
+ *      strings     each a 32-bit length, the characters, a NUL and padding to 4 bytes
+ *
+ *  Node 0 is the document. Nodes are stored breadth-first, so the children of a node
+ *  are consecutive records, the same goes for its attributes. Strings are referenced
+ *  by the offset of their first character in the string table (BINARY_NONE for NULL)
+ *  and stored only once.
+ */
+
+#define BINARY_MAGIC        "cfxB"
+#define BINARY_VERSION      1
+#define BINARY_NONE         0xFFFFFFFFu
+
+#define BH_MAGIC            0
+#define BH_VERSION          4
+#define BH_NUM_NODES        8
+#define BH_NUM_ATTRIBS      12
+#define BH_NODES            16
+#define BH_ATTRIBS          20
+#define BH_STRINGS          24
+#define BH_STRINGS_SIZE     28
+#define BINARY_HEADER_SIZE  32
+
+#define BN_NAME             0
+#define BN_TEXT             4
+#define BN_FIRST_CHILD      8
+#define BN_NUM_CHILDREN     12
+#define BN_FIRST_ATTRIB     16
+#define BN_NUM_ATTRIBS      20
+#define BINARY_NODE_SIZE    24
+
+#define BA_NAME             0
+#define BA_VALUE            4
+#define BINARY_ATTRIB_SIZE  8
+
+#define binary_get_u32( p_ )\
+        ( ( cfx2_uint32_t )( ( const cfx2_uint8_t* )( p_ ) )[0]\
+        | ( cfx2_uint32_t )( ( const cfx2_uint8_t* )( p_ ) )[1] << 8\
+        | ( cfx2_uint32_t )( ( const cfx2_uint8_t* )( p_ ) )[2] << 16\
+        | ( cfx2_uint32_t )( ( const cfx2_uint8_t* )( p_ ) )[3] << 24 )
+
+/*
+ *  String table writer: distinct strings of a document and where they go in the table.
+ *  Also used for frozen documents, whose strings are laid out the same way.
+ */
+typedef struct
+{
+    const char* string;         /* NULL for an empty slot */
+    size_t length, hash;
+    cfx2_uint32_t ref;
+}
+StringEntry_t;
+
+typedef struct
+{
+    StringEntry_t* entries;
+    size_t capacity, used;      /* capacity is a power of 2 */
+    size_t size;                /* of the string table so far */
+    int category;               /* of the entries, see cfx2_MemoryStats */
+}
+StringTable_t;
+
+void cfx2_strings_init( StringTable_t* table, int category );
+void cfx2_strings_release( StringTable_t* table );
+
+/* the reference to string (BINARY_NONE for NULL), adding it to the table the first time */
+int cfx2_strings_add( StringTable_t* table, const char* string, cfx2_uint32_t* ref );
+
+/* the table.size bytes of the table, with their references as given by add */
+void cfx2_strings_write( const StringTable_t* table, char* strings );
+
+/* a validated binary document */
+typedef struct
+{
+    const char* data;
+    size_t size;
+
+    cfx2_uint32_t num_nodes, num_attribs;
+    const char* nodes;
+    const char* attribs;
+    const char* strings;
+    cfx2_uint32_t strings_size;
+}
+BinaryDoc_t;
+
+/*
+ *  open checks the header and that the sections are within the data, in constant time;
+ *  check goes through every record and string reference, for documents used as a whole.
+ */
+int cfx2_binary_open( BinaryDoc_t* bin, const char* data, size_t size );
+int cfx2_binary_check( const BinaryDoc_t* bin );
+
+#define binary_node( bin_, index_ )     ( ( bin_ )->nodes + ( size_t )( index_ ) * BINARY_NODE_SIZE )
+#define binary_attrib( bin_, index_ )   ( ( bin_ )->attribs + ( size_t )( index_ ) * BINARY_ATTRIB_SIZE )
+
+/* NULL for BINARY_NONE */
+#define binary_string( bin_, ref_ )     ( ( ref_ ) != BINARY_NONE ? ( bin_ )->strings + ( ref_ ) : NULL )
+#define binary_string_length( bin_, ref_ )  binary_get_u32( ( bin_ )->strings + ( ref_ ) - 4 )
+
+#endif
@@ -0,0 +1,407 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+#include "alloc.h"
+#include "arena.h"
+#include "index.h"
+#include "intern.h"
+#include "list.h"
+#include "node.h"
+
+#include <confix2.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ *  A string with a reference count of 0 lives in a shared buffer (its node's or its parent's)
+ *  or in the arena. Any other string is a heap block of its own, shared by that many users.
+ */
+#define string_refs( string_ )  ( *( const s_nref_t* )( ( string_ ) - sizeof( s_nref_t ) ) )
+
+/* -------------------------------------------------------------------------- */
+/*  Document Statistics                                                       */
+/* -------------------------------------------------------------------------- */
+
+typedef struct
+{
+    cfx2_DocumentStats* stats;
+    size_t allocated;
+
+    const cfx2_Node* top;
+    const cfx2_Arena* arena;    /* counted chunk by chunk (the walk started at its root) */
+}
+StatsWalk_t;
+
+/* how much a block of a node's takes, and whether it's held apart from any counted arena */
+static size_t block_size( const StatsWalk_t* walk, const cfx2_Node* node, size_t size, int* separate )
+{
+    *separate = ( node->arena == NULL || node->arena != walk->arena );
+
+    return ( node->arena != NULL ) ? arena_align_up( size ) : size;
+}
+
+static void count_block( StatsWalk_t* walk, const cfx2_Node* node, size_t size )
+{
+    int separate;
+
+    /* arena padding can't be avoided, so it counts as used */
+    size = block_size( walk, node, size, &separate );
+    walk->stats->used_bytes += size;
+
+    if ( separate )
+        walk->allocated += size;
+}
+
+static void count_list( StatsWalk_t* walk, const cfx2_Node* node, const cfx2_List* list, itemsize_t itemsize )
+{
+    size_t size;
+    int separate;
+
+    /* the local storage is a part of the node */
+    if ( list->items == list->local.bytes )
+        return;
+
+    size = block_size( walk, node, list->capacity, &separate );
+
+    walk->stats->used_bytes += list->length * itemsize;
+    walk->stats->list_slack += size - list->length * itemsize;
+
+    if ( separate )
+        walk->allocated += size;
+}
+
+static void count_string( StatsWalk_t* walk, const cfx2_Node* node, const char* string )
+{
+    size_t size, refs;
+
+    if ( string == NULL )
+        return;
+
+    size = strlen( string ) + 1;
+    refs = string_refs( string );
+
+    if ( refs > 0 )
+    {
+        walk->stats->used_bytes += ( sizeof( s_nref_t ) + size ) / refs;
+        walk->allocated += ( sizeof( s_nref_t ) + size ) / refs;
+    }
+    else if ( node->arena != NULL )
+        count_block( walk, node, sizeof( s_nref_t ) + size );
+    else
+    {
+        walk->stats->used_bytes += shared_size( size );
+
+        /* in the buffer of a parent outside the walk */
+        if ( node == walk->top && !cfx2_shared_contains( node, string ) )
+            walk->allocated += shared_size( size );
+    }
+}
+
+static void count_index( StatsWalk_t* walk, const cfx2_Node* node, size_t header, size_t entries )
+{
+    int separate;
+    size_t size;
+
+    size = block_size( walk, node, header, &separate ) + block_size( walk, node, entries, &separate );
+    walk->stats->index_bytes += size;
+
+    if ( separate )
+        walk->allocated += size;
+}
+
+/* everything the arena holds, apart from the nodes using it */
+static void count_arena( StatsWalk_t* walk, const cfx2_Arena* arena )
+{
+    const ArenaChunk_t* chunk;
+    size_t i;
+
+    walk->arena = arena;
+
+    walk->stats->used_bytes += sizeof( cfx2_Arena );
+    walk->allocated += sizeof( cfx2_Arena );
+
+    for ( chunk = arena->chunks; chunk != NULL; chunk = chunk->next )
+    {
+        walk->stats->used_bytes += arena_align_up( sizeof( ArenaChunk_t ) );
+        walk->stats->buffer_slack += chunk->capacity - chunk->used;
+        walk->allocated += arena_align_up( sizeof( ArenaChunk_t ) ) + chunk->capacity;
+    }
+
+    /* the list of adopted nodes is on the heap, once it outgrows the arena structure */
+    if ( arena->adopted.items != arena->adopted.local.bytes )
+    {
+        walk->stats->used_bytes += arena->adopted.length * sizeof( cfx2_Node* );
+        walk->stats->list_slack += arena->adopted.capacity - arena->adopted.length * sizeof( cfx2_Node* );
+        walk->allocated += arena->adopted.capacity;
+    }
+
+    /* interned names are counted once here, not with every attribute */
+    walk->stats->index_bytes += arena_align_up( arena->names.capacity * sizeof( InternEntry_t ) );
+
+    for ( i = 0; i < arena->names.capacity; i++ )
+        if ( arena->names.entries[i].name != NULL )
+            walk->stats->used_bytes += arena_align_up( sizeof( s_nref_t ) + strlen( arena->names.entries[i].name ) + 1 );
+}
+
+static void count_node( StatsWalk_t* walk, const cfx2_Node* node )
+{
+    const SharedHeader_t* sh;
+    const cfx2_Attrib* attrib;
+    size_t i;
+
+    if ( node->arena != NULL && node->arena->root == node && walk->arena == NULL )
+        count_arena( walk, node->arena );
+
+    walk->stats->nodes++;
+    walk->stats->attribs += cfx2_list_length( node->attributes );
+
+    count_block( walk, node, sizeof( cfx2_Node ) );
+    count_string( walk, node, node->name );
+    count_string( walk, node, node->text );
+
+    for ( i = 0; i < cfx2_list_length( node->attributes ); i++ )
+    {
+        attrib = &cfx2_item( node->attributes, i, cfx2_Attrib );
+
+        if ( node->arena == NULL || node->arena != walk->arena || !cfx2_names_contain( &node->arena->names, attrib->name ) )
+            count_string( walk, node, attrib->name );
+
+        count_string( walk, node, attrib->value );
+    }
+
+    count_list( walk, node, &node->attributes, sizeof( cfx2_Attrib ) );
+    count_list( walk, node, &node->children, sizeof( cfx2_Node* ) );
+
+    for ( sh = ( const SharedHeader_t* )node->shared; sh != NULL; sh = sh->next )
+    {
+        walk->stats->used_bytes += sizeof( SharedHeader_t );
+        walk->stats->buffer_slack += sh->capacity - sh->used;
+        walk->allocated += sizeof( SharedHeader_t ) + sh->capacity;
+    }
+
+    if ( node->child_index != NULL )
+        count_index( walk, node, sizeof( cfx2_ChildIndex ), node->child_index->capacity * sizeof( ChildIndexEntry_t ) );
+
+    if ( node->attrib_index != NULL )
+        count_index( walk, node, sizeof( cfx2_AttribIndex ), node->attrib_index->capacity * sizeof( AttribIndexEntry_t ) );
+
+    for ( i = 0; i < cfx2_list_length( node->children ); i++ )
+        count_node( walk, cfx2_item( node->children, i, cfx2_Node* ) );
+}
+
+libcfx2 int cfx2_document_stats( cfx2_Node* doc, cfx2_DocumentStats* stats )
+{
+    StatsWalk_t walk;
+    size_t accounted;
+
+    if ( doc == NULL || stats == NULL )
+        return cfx2_param_invalid;
+
+    memset( stats, 0, sizeof( cfx2_DocumentStats ) );
+
+    walk.stats = stats;
+    walk.allocated = 0;
+    walk.top = doc;
+    walk.arena = NULL;
+
+    count_node( &walk, doc );
+
+    /* whatever the tree doesn't account for is dead */
+    accounted = stats->used_bytes + stats->index_bytes + stats->list_slack + stats->buffer_slack;
+
+    if ( walk.allocated > accounted )
+        stats->dead_bytes = walk.allocated - accounted;
+
+    stats->wasted_bytes = stats->list_slack + stats->buffer_slack + stats->dead_bytes;
+    return cfx2_ok;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Compaction                                                                */
+/* -------------------------------------------------------------------------- */
+
+typedef struct
+{
+    SharedHeader_t* old_chunks;     /* freed once every string has moved out */
+    int rc;
+}
+Compaction_t;
+
+/* space a string takes once repacked; heap strings with several users stay where they are */
+static size_t string_space( const char* string )
+{
+    if ( string == NULL || string_refs( string ) > 1 )
+        return 0;
+
+    return shared_size( strlen( string ) + 1 );
+}
+
+static size_t node_space( const cfx2_Node* node )
+{
+    const cfx2_Attrib* attrib;
+    size_t size, i;
+
+    size = string_space( node->name ) + string_space( node->text );
+
+    for ( i = 0; i < cfx2_list_length( node->attributes ); i++ )
+    {
+        attrib = &cfx2_item( node->attributes, i, cfx2_Attrib );
+        size += string_space( attrib->name ) + string_space( attrib->value );
+    }
+
+    return size;
+}
+
+static void repack_string( SharedHeader_t* sh, char** string )
+{
+    char* chunk;
+    size_t size;
+
+    if ( *string == NULL || string_refs( *string ) > 1 )
+        return;
+
+    size = strlen( *string ) + 1;
+    chunk = shared_data( sh ) + sh->used;
+    sh->used += shared_size( size );
+
+    *( s_nref_t* )chunk = 0;
+    chunk += sizeof( s_nref_t );
+    memcpy( chunk, *string, size );
+
+    /* a string of its own is freed right away, one in an old buffer goes with the buffer */
+    cfx2_sfree( *string );
+    *string = chunk;
+}
+
+static void repack_node( SharedHeader_t* sh, cfx2_Node* node )
+{
+    cfx2_Attrib* attrib;
+    size_t i;
+
+    repack_string( sh, &node->name );
+    repack_string( sh, &node->text );
+
+    for ( i = 0; i < cfx2_list_length( node->attributes ); i++ )
+    {
+        attrib = &cfx2_item( node->attributes, i, cfx2_Attrib );
+        repack_string( sh, &attrib->name );
+        repack_string( sh, &attrib->value );
+    }
+}
+
+/*
+ *  Like the reader, a node's buffer gets the strings of its children, and its own strings
+ *  go to its parent's buffer (in_parent) unless the parent can't take them.
+ */
+static void compact_node( Compaction_t* comp, cfx2_Node* node, int in_parent )
+{
+    SharedHeader_t* sh, * tail;
+    cfx2_Node* child;
+    size_t size, i;
+    int repacked;
+
+    repacked = 0;
+
+    if ( node->arena == NULL )
+    {
+        size = in_parent ? 0 : node_space( node );
+
+        for ( i = 0; i < cfx2_list_length( node->children ); i++ )
+        {
+            child = cfx2_item( node->children, i, cfx2_Node* );
+
+            if ( child->arena == NULL )
+                size += node_space( child );
+        }
+
+        sh = NULL;
+
+        if ( size > 0 && ( sh = ( SharedHeader_t* )libcfx2_malloc( sizeof( SharedHeader_t ) + size, cfx2_mem_string ) ) == NULL )
+            comp->rc = cfx2_alloc_error;
+        else
+        {
+            if ( sh != NULL )
+            {
+                sh->next = NULL;
+                sh->capacity = size;
+                sh->used = 0;
+
+                if ( !in_parent )
+                    repack_node( sh, node );
+
+                for ( i = 0; i < cfx2_list_length( node->children ); i++ )
+                {
+                    child = cfx2_item( node->children, i, cfx2_Node* );
+
+                    if ( child->arena == NULL )
+                        repack_node( sh, child );
+                }
+            }
+
+            /* the old chunks may still hold strings of the children's children */
+            if ( node->shared != NULL )
+            {
+                for ( tail = ( SharedHeader_t* )node->shared; tail->next != NULL; tail = tail->next )
+                    ;
+
+                tail->next = comp->old_chunks;
+                comp->old_chunks = ( SharedHeader_t* )node->shared;
+            }
+
+            node->shared = ( char* )sh;
+            repacked = 1;
+        }
+
+        cfx2_list_shrink( &node->attributes, sizeof( cfx2_Attrib ) );
+        cfx2_list_shrink( &node->children, sizeof( cfx2_Node* ) );
+    }
+
+    for ( i = 0; i < cfx2_list_length( node->children ); i++ )
+    {
+        child = cfx2_item( node->children, i, cfx2_Node* );
+        compact_node( comp, child, repacked && child->arena == NULL );
+    }
+}
+
+libcfx2 int cfx2_compact( cfx2_Node* doc )
+{
+    Compaction_t comp;
+    SharedHeader_t* next;
+
+    if ( doc == NULL )
+        return cfx2_param_invalid;
+
+    comp.old_chunks = NULL;
+    comp.rc = cfx2_ok;
+
+    compact_node( &comp, doc, 0 );
+
+    while ( comp.old_chunks != NULL )
+    {
+        next = comp.old_chunks->next;
+        libcfx2_free( comp.old_chunks );
+        comp.old_chunks = next;
+    }
+
+    return comp.rc;
+}
@@ -24,14 +24,41 @@
 #ifndef libcfx2_config_h_included
 #define libcfx2_config_h_included
 
-/*  Dynamic Allocation Functions  */
-#define libcfx2_malloc      malloc
-#define libcfx2_realloc     realloc
-#define libcfx2_free        free
-
-/*  Parser Utility Buffers  */
-/*  default sizes (in bytes incl. overhead) are: 32 64 128 256 512 1024 */
-#define PARSER_MIN_BUF      32
-#define PARSER_NUM_BUFS     6
+/*  Parser String Chunks  */
+/*  each node's chain of string chunks doubles from PARSER_MIN_CHUNK up to PARSER_MAX_CHUNK bytes */
+#define PARSER_MIN_CHUNK    64
+#define PARSER_MAX_CHUNK    65536
+
+/*  Parallel Reader  */
+/*  input is split into up to PARSER_TASKS_PER_THREAD pieces per thread, */
+/*  each at least PARSER_PARALLEL_MIN_SIZE bytes */
+#define PARSER_TASKS_PER_THREAD 4
+#define PARSER_PARALLEL_MIN_SIZE    262144
+
+/*  Arena Documents  */
+/*  chunk sizes double from ARENA_MIN_CHUNK up to ARENA_MAX_CHUNK bytes */
+#define ARENA_MIN_CHUNK     4096
+#define ARENA_MAX_CHUNK     1048576
+#define ARENA_ALIGN         8
+
+/*  Child Index  */
+/*  nodes with at least this many children keep a hash index of them for cfx2_find_child */
+#define CHILD_INDEX_THRESHOLD   32
+
+/*  Attribute Names  */
+/*  nodes with at least ATTRIB_INDEX_THRESHOLD attributes keep a hash index of them for cfx2_find_attrib */
+/*  a document interns at most INTERN_MAX_NAMES distinct attribute names */
+#define ATTRIB_INDEX_THRESHOLD  16
+#define INTERN_MAX_NAMES        4096
+
+/*  Writer  */
+/*  output is passed to stream_write in blocks of up to WRITER_BUFFER_SIZE bytes (see cfx2_output_buffer_size) */
+#define WRITER_BUFFER_SIZE      65536
+
+/*  Parallel Writer  */
+/*  top-level nodes are split into WRITER_TASKS_PER_THREAD runs per thread; */
+/*  WRITER_BATCH_PER_THREAD runs per thread are held in memory at a time */
+#define WRITER_TASKS_PER_THREAD 16
+#define WRITER_BATCH_PER_THREAD 2
 
 #endif
@@ -0,0 +1,384 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+#include "alloc.h"
+#include "frozen.h"
+#include "reader.h"
+
+#include <confix2.h>
+#include <string.h>
+
+/* -------------------------------------------------------------------------- */
+/*  Freezing                                                                  */
+/* -------------------------------------------------------------------------- */
+
+typedef struct
+{
+    StringTable_t table;
+    size_t num_nodes, num_attribs;
+    cfx2_Frozen* frozen;
+}
+Freezer_t;
+
+/* counts the nodes and attributes below node (itself included) and adds their strings */
+static int count_node( Freezer_t* freezer, const cfx2_Node* node, int is_root )
+{
+    cfx2_Attrib* attrib;
+    cfx2_uint32_t ref;
+    size_t i;
+    int rc;
+
+    /* the same checks as the writers */
+    if ( !is_root && ( node->name == NULL || node->name[0] == 0 ) )
+        return cfx2_missing_node_name;
+
+    freezer->num_nodes++;
+    freezer->num_attribs += cfx2_list_length( node->attributes );
+
+    if ( ( rc = cfx2_strings_add( &freezer->table, node->name, &ref ) ) != cfx2_ok
+            || ( rc = cfx2_strings_add( &freezer->table, node->text, &ref ) ) != cfx2_ok )
+        return rc;
+
+    for ( i = 0; i < cfx2_list_length( node->attributes ); i++ )
+    {
+        attrib = &cfx2_item( node->attributes, i, cfx2_Attrib );
+
+        if ( ( rc = cfx2_strings_add( &freezer->table, attrib->name != NULL ? attrib->name : "", &ref ) ) != cfx2_ok
+                || ( rc = cfx2_strings_add( &freezer->table, attrib->value, &ref ) ) != cfx2_ok )
+            return rc;
+    }
+
+    for ( i = 0; i < cfx2_list_length( node->children ); i++ )
+        if ( ( rc = count_node( freezer, cfx2_item( node->children, i, cfx2_Node* ), 0 ) ) != cfx2_ok )
+            return rc;
+
+    return cfx2_ok;
+}
+
+/* fills in node and everything below it; every string is in the table by now */
+static int freeze_node( Freezer_t* freezer, const cfx2_Node* node, cfx2_uint32_t* index_out )
+{
+    cfx2_Frozen* frozen = freezer->frozen;
+    cfx2_Attrib* attrib;
+    cfx2_uint32_t index, attrib_index, child, previous;
+    size_t i;
+    int rc;
+
+    index = ( cfx2_uint32_t )freezer->num_nodes++;
+
+    if ( ( rc = cfx2_strings_add( &freezer->table, node->name, &frozen->names[index] ) ) != cfx2_ok
+            || ( rc = cfx2_strings_add( &freezer->table, node->text, &frozen->texts[index] ) ) != cfx2_ok )
+        return rc;
+
+    frozen->first_attrib[index] = ( cfx2_uint32_t )freezer->num_attribs;
+
+    for ( i = 0; i < cfx2_list_length( node->attributes ); i++ )
+    {
+        attrib = &cfx2_item( node->attributes, i, cfx2_Attrib );
+        attrib_index = ( cfx2_uint32_t )freezer->num_attribs++;
+
+        if ( ( rc = cfx2_strings_add( &freezer->table, attrib->name != NULL ? attrib->name : "",
+                        &frozen->attrib_names[attrib_index] ) ) != cfx2_ok
+                || ( rc = cfx2_strings_add( &freezer->table, attrib->value, &frozen->attrib_values[attrib_index] ) ) != cfx2_ok )
+            return rc;
+    }
+
+    frozen->first_child[index] = BINARY_NONE;
+    frozen->next_sibling[index] = BINARY_NONE;
+    previous = BINARY_NONE;
+
+    for ( i = 0; i < cfx2_list_length( node->children ); i++ )
+    {
+        if ( ( rc = freeze_node( freezer, cfx2_item( node->children, i, cfx2_Node* ), &child ) ) != cfx2_ok )
+            return rc;
+
+        if ( previous == BINARY_NONE )
+            frozen->first_child[index] = child;
+        else
+            frozen->next_sibling[previous] = child;
+
+        previous = child;
+    }
+
+    *index_out = index;
+    return cfx2_ok;
+}
+
+libcfx2 int cfx2_freeze( cfx2_Frozen** frozen_ptr, cfx2_Node* doc )
+{
+    Freezer_t freezer;
+    cfx2_Frozen* frozen;
+    size_t num_words, size;
+    cfx2_uint32_t* words;
+    cfx2_uint32_t root;
+    int rc;
+
+    if ( frozen_ptr == NULL || doc == NULL )
+        return cfx2_param_invalid;
+
+    *frozen_ptr = NULL;
+
+    cfx2_strings_init( &freezer.table, cfx2_mem_index );
+    freezer.num_nodes = 0;
+    freezer.num_attribs = 0;
+
+    if ( ( rc = count_node( &freezer, doc, 1 ) ) != cfx2_ok )
+    {
+        cfx2_strings_release( &freezer.table );
+        return rc;
+    }
+
+    /* one block: the structure, the arrays and the string table */
+    num_words = freezer.num_nodes * 5 + 1 + freezer.num_attribs * 2;
+    size = sizeof( cfx2_Frozen ) + num_words * sizeof( cfx2_uint32_t ) + freezer.table.size;
+
+    /* node and attribute indices must fit in 32 bits, BINARY_NONE excluded */
+    if ( freezer.num_nodes >= BINARY_NONE / 8 || freezer.num_attribs >= BINARY_NONE / 8
+            || num_words > ( ( size_t )-1 - sizeof( cfx2_Frozen ) - freezer.table.size ) / sizeof( cfx2_uint32_t ) )
+    {
+        cfx2_strings_release( &freezer.table );
+        return cfx2_param_invalid;
+    }
+
+    frozen = ( cfx2_Frozen* )libcfx2_malloc( size, cfx2_mem_node );
+
+    if ( frozen == NULL )
+    {
+        cfx2_strings_release( &freezer.table );
+        return cfx2_alloc_error;
+    }
+
+    words = ( cfx2_uint32_t* )( frozen + 1 );
+
+    frozen->num_nodes = ( cfx2_uint32_t )freezer.num_nodes;
+    frozen->num_attribs = ( cfx2_uint32_t )freezer.num_attribs;
+    frozen->names = words;
+    frozen->texts = frozen->names + freezer.num_nodes;
+    frozen->first_child = frozen->texts + freezer.num_nodes;
+    frozen->next_sibling = frozen->first_child + freezer.num_nodes;
+    frozen->first_attrib = frozen->next_sibling + freezer.num_nodes;
+    frozen->attrib_names = frozen->first_attrib + freezer.num_nodes + 1;
+    frozen->attrib_values = frozen->attrib_names + freezer.num_attribs;
+    frozen->strings = ( const char* )( words + num_words );
+
+    freezer.frozen = frozen;
+    freezer.num_nodes = 0;
+    freezer.num_attribs = 0;
+
+    rc = freeze_node( &freezer, doc, &root );
+
+    if ( rc == cfx2_ok )
+    {
+        frozen->first_attrib[frozen->num_nodes] = frozen->num_attribs;
+        cfx2_strings_write( &freezer.table, ( char* )( words + num_words ) );
+        *frozen_ptr = frozen;
+    }
+    else
+        libcfx2_free( frozen );
+
+    cfx2_strings_release( &freezer.table );
+    return rc;
+}
+
+libcfx2 void cfx2_release_frozen( cfx2_Frozen** frozen_ptr )
+{
+    if ( frozen_ptr == NULL || *frozen_ptr == NULL )
+        return;
+
+    libcfx2_free( *frozen_ptr );
+    *frozen_ptr = NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Thawing                                                                   */
+/* -------------------------------------------------------------------------- */
+
+/* reports node and everything below it, the document's attributes and text without a node */
+static int emit_node( const cfx2_ReadHandler* handler, const cfx2_Frozen* frozen, cfx2_uint32_t index )
+{
+    cfx2_uint32_t ref, value, i;
+
+    if ( index > 0 )
+    {
+        ref = frozen->names[index];
+
+        if ( handler->begin_node != NULL
+                && handler->begin_node( handler->user, frozen_string( frozen, ref ), frozen_string_length( frozen, ref ) ) != cfx2_continue )
+            return cfx2_stop;
+    }
+
+    ref = frozen->texts[index];
+
+    if ( ref != BINARY_NONE && handler->node_text != NULL
+            && handler->node_text( handler->user, frozen_string( frozen, ref ), frozen_string_length( frozen, ref ) ) != cfx2_continue )
+        return cfx2_stop;
+
+    for ( i = frozen->first_attrib[index]; i < frozen->first_attrib[index + 1] && handler->attrib != NULL; i++ )
+    {
+        ref = frozen->attrib_names[i];
+        value = frozen->attrib_values[i];
+
+        if ( handler->attrib( handler->user, frozen_string( frozen, ref ), frozen_string_length( frozen, ref ),
+                frozen_string( frozen, value ), value != BINARY_NONE ? frozen_string_length( frozen, value ) : 0 ) != cfx2_continue )
+            return cfx2_stop;
+    }
+
+    for ( i = frozen->first_child[index]; i != BINARY_NONE; i = frozen->next_sibling[i] )
+        if ( emit_node( handler, frozen, i ) != cfx2_continue )
+            return cfx2_stop;
+
+    if ( index > 0 && handler->end_node != NULL && handler->end_node( handler->user ) != cfx2_continue )
+        return cfx2_stop;
+
+    return cfx2_continue;
+}
+
+static int produce_frozen( const cfx2_ReadHandler* handler, void* source )
+{
+    return emit_node( handler, ( const cfx2_Frozen* )source, 0 ) == cfx2_continue ? cfx2_ok : cfx2_interrupted;
+}
+
+libcfx2 int cfx2_thaw( cfx2_Node** doc_ptr, const cfx2_Frozen* frozen, const cfx2_RdOpt* rd_opt_in )
+{
+    cfx2_RdOpt rd_opt;
+    int rc;
+
+    if ( doc_ptr == NULL || frozen == NULL )
+        return cfx2_param_invalid;
+
+    if ( rd_opt_in != NULL )
+        memcpy( &rd_opt, rd_opt_in, sizeof( rd_opt ) );
+    else
+        memset( &rd_opt, 0, sizeof( rd_opt ) );
+
+    rc = cfx2_build_document( doc_ptr, &rd_opt, produce_frozen, ( void* )frozen );
+
+    /* the document's name isn't an event */
+    if ( rc == cfx2_ok && frozen->names[0] != BINARY_NONE
+            && ( rc = cfx2_rename_node( *doc_ptr, frozen_string( frozen, frozen->names[0] ) ) ) != cfx2_ok )
+        cfx2_release_node( doc_ptr );
+
+    return rc;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Lookups                                                                   */
+/* -------------------------------------------------------------------------- */
+
+#define frozen_valid( frozen_, node_ ) ( ( frozen_ ) != NULL && ( node_ ) < ( frozen_ )->num_nodes )
+
+libcfx2 size_t cfx2_frozen_num_nodes( const cfx2_Frozen* frozen )
+{
+    return frozen != NULL ? frozen->num_nodes : 0;
+}
+
+libcfx2 const char* cfx2_frozen_name( const cfx2_Frozen* frozen, cfx2_FrozenNode node )
+{
+    return frozen_valid( frozen, node ) ? frozen_string( frozen, frozen->names[node] ) : NULL;
+}
+
+libcfx2 const char* cfx2_frozen_text( const cfx2_Frozen* frozen, cfx2_FrozenNode node )
+{
+    return frozen_valid( frozen, node ) ? frozen_string( frozen, frozen->texts[node] ) : NULL;
+}
+
+libcfx2 cfx2_FrozenNode cfx2_frozen_first_child( const cfx2_Frozen* frozen, cfx2_FrozenNode node )
+{
+    return frozen_valid( frozen, node ) ? frozen->first_child[node] : cfx2_no_frozen_node;
+}
+
+libcfx2 cfx2_FrozenNode cfx2_frozen_next_sibling( const cfx2_Frozen* frozen, cfx2_FrozenNode node )
+{
+    return frozen_valid( frozen, node ) ? frozen->next_sibling[node] : cfx2_no_frozen_node;
+}
+
+/* the first child of that name, comparing stored lengths before characters */
+libcfx2 cfx2_FrozenNode cfx2_frozen_find_child( const cfx2_Frozen* frozen, cfx2_FrozenNode parent, const char* name )
+{
+    cfx2_uint32_t child, ref;
+    size_t length;
+
+    if ( name == NULL || !frozen_valid( frozen, parent ) )
+        return cfx2_no_frozen_node;
+
+    length = strlen( name );
+
+    for ( child = frozen->first_child[parent]; child != BINARY_NONE; child = frozen->next_sibling[child] )
+    {
+        ref = frozen->names[child];
+
+        if ( frozen_string_length( frozen, ref ) == length && memcmp( frozen->strings + ref, name, length ) == 0 )
+            return child;
+    }
+
+    return cfx2_no_frozen_node;
+}
+
+libcfx2 size_t cfx2_frozen_num_attribs( const cfx2_Frozen* frozen, cfx2_FrozenNode node )
+{
+    return frozen_valid( frozen, node ) ? frozen->first_attrib[node + 1] - frozen->first_attrib[node] : 0;
+}
+
+libcfx2 int cfx2_frozen_attrib( const cfx2_Frozen* frozen, cfx2_FrozenNode node, size_t index, const char** name, const char** value )
+{
+    cfx2_uint32_t attrib;
+
+    if ( !frozen_valid( frozen, node ) || index >= frozen->first_attrib[node + 1] - frozen->first_attrib[node] )
+        return cfx2_attrib_not_found;
+
+    attrib = frozen->first_attrib[node] + ( cfx2_uint32_t )index;
+
+    if ( name != NULL )
+        *name = frozen_string( frozen, frozen->attrib_names[attrib] );
+
+    if ( value != NULL )
+        *value = frozen_string( frozen, frozen->attrib_values[attrib] );
+
+    return cfx2_ok;
+}
+
+libcfx2 int cfx2_frozen_find_attrib( const cfx2_Frozen* frozen, cfx2_FrozenNode node, const char* name, const char** value )
+{
+    cfx2_uint32_t attrib, ref;
+    size_t length;
+
+    if ( name == NULL || !frozen_valid( frozen, node ) )
+        return cfx2_attrib_not_found;
+
+    length = strlen( name );
+
+    for ( attrib = frozen->first_attrib[node]; attrib < frozen->first_attrib[node + 1]; attrib++ )
+    {
+        ref = frozen->attrib_names[attrib];
+
+        if ( frozen_string_length( frozen, ref ) == length && memcmp( frozen->strings + ref, name, length ) == 0 )
+        {
+            if ( value != NULL )
+                *value = frozen_string( frozen, frozen->attrib_values[attrib] );
+
+            return cfx2_ok;
+        }
+    }
+
+    return cfx2_attrib_not_found;
+}
@@ -0,0 +1,62 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+#ifndef libcfx2_frozen_h
+#define libcfx2_frozen_h
+
+#include "binary.h"
+
+#include <confix2.h>
+
+/*
+ *  Frozen documents: the nodes of a tree in pre-order, each field in an array of its own,
+ *  so that a walk over the document reads every array front to back. The first child of
+ *  a node is the node after it, the rest are chained by next_sibling (BINARY_NONE ends
+ *  both); the attributes of node i are [first_attrib[i], first_attrib[i + 1]).
+ *
+ *  Strings are referenced and laid out as in a binary document. The arrays and the
+ *  string table follow the structure in the same block.
+ */
+struct cfx2_Frozen
+{
+    cfx2_uint32_t num_nodes, num_attribs;
+
+    /* num_nodes each, first_attrib one more */
+    cfx2_uint32_t* names;
+    cfx2_uint32_t* texts;
+    cfx2_uint32_t* first_child;
+    cfx2_uint32_t* next_sibling;
+    cfx2_uint32_t* first_attrib;
+
+    /* num_attribs each */
+    cfx2_uint32_t* attrib_names;
+    cfx2_uint32_t* attrib_values;
+
+    const char* strings;
+};
+
+/* NULL for BINARY_NONE */
+#define frozen_string( frozen_, ref_ )  ( ( ref_ ) != BINARY_NONE ? ( frozen_ )->strings + ( ref_ ) : NULL )
+#define frozen_string_length( frozen_, ref_ )   binary_get_u32( ( frozen_ )->strings + ( ref_ ) - 4 )
+
+#endif
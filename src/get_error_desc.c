@@ -35,6 +35,9 @@ static const char* error_descs[] =
     "unable to find the specified node attribute",
     /* 0x08 cfx2_missing_node_name */   "node name empty or not specified",
     /* 0x09 cfx2_node_not_found */      "node not found",
+    /* 0x0A cfx2_buffer_overflow */     "output buffer too small",
+    /* 0x0B cfx2_write_error */         "unable to write the output",
+    /* 0x0C cfx2_bad_format */          "not a valid binary document",
 };
 
 libcfx2 const char* cfx2_get_error_desc( int error_code )
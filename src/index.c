@@ -0,0 +1,569 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+
+#include "alloc.h"
+#include "arena.h"
+#include "config.h"
+#include "index.h"
+
+#include <confix2.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define name_of( node_ ) ( ( node_ )->name != NULL ? ( node_ )->name : "" )
+
+/* keep the table at most 3/4 full */
+#define needs_growth( index_, used_ ) ( ( used_ ) * 4 > ( index_ )->capacity * 3 )
+
+/*
+ *  FNV-1a
+ */
+size_t cfx2_hash_name( const char* name )
+{
+    size_t hash;
+
+    hash = 2166136261u;
+
+    while ( *name )
+    {
+        hash ^= ( unsigned char ) *name++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+size_t cfx2_hash_bytes( const char* data, size_t length )
+{
+    size_t hash;
+
+    hash = 2166136261u;
+
+    while ( length-- > 0 )
+    {
+        hash ^= ( unsigned char ) *data++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/* arena nodes keep their index in the arena; outgrown tables are left to it */
+static void* index_alloc( cfx2_Node* parent, size_t size )
+{
+    if ( parent->arena != NULL )
+        return cfx2_arena_alloc( parent->arena, size );
+    else
+        return libcfx2_malloc( size, cfx2_mem_index );
+}
+
+static void index_free( cfx2_Node* parent, void* ptr )
+{
+    if ( parent->arena == NULL )
+        libcfx2_free( ptr );
+}
+
+static ChildIndexEntry_t* alloc_entries( cfx2_Node* parent, size_t capacity )
+{
+    ChildIndexEntry_t* entries;
+
+    entries = ( ChildIndexEntry_t* )index_alloc( parent, capacity * sizeof( ChildIndexEntry_t ) );
+
+    if ( entries != NULL )
+        memset( entries, 0, capacity * sizeof( ChildIndexEntry_t ) );
+
+    return entries;
+}
+
+/* The entry for this name, or the empty slot where it belongs */
+static ChildIndexEntry_t* lookup( const cfx2_ChildIndex* index, const char* name, size_t hash )
+{
+    size_t i, mask;
+
+    mask = index->capacity - 1;
+
+    for ( i = hash & mask; index->entries[i].first != NULL; i = ( i + 1 ) & mask )
+        if ( index->entries[i].hash == hash && strcmp( name_of( index->entries[i].first ), name ) == 0 )
+            break;
+
+    return &index->entries[i];
+}
+
+static int grow( cfx2_Node* parent )
+{
+    cfx2_ChildIndex* index;
+    ChildIndexEntry_t* entries;
+    size_t i, j, capacity, mask;
+
+    index = parent->child_index;
+    capacity = index->capacity * 2;
+    mask = capacity - 1;
+
+    if ( ( entries = alloc_entries( parent, capacity ) ) == NULL )
+        return cfx2_alloc_error;
+
+    /* names are distinct, so entries only need a free slot */
+    for ( i = 0; i < index->capacity; i++ )
+        if ( index->entries[i].first != NULL )
+        {
+            for ( j = index->entries[i].hash & mask; entries[j].first != NULL; j = ( j + 1 ) & mask )
+                ;
+
+            entries[j] = index->entries[i];
+        }
+
+    index_free( parent, index->entries );
+    index->entries = entries;
+    index->capacity = capacity;
+    return cfx2_ok;
+}
+
+/* Backward-shift deletion keeps probe sequences unbroken without tombstones */
+static void delete_entry( cfx2_ChildIndex* index, ChildIndexEntry_t* entry )
+{
+    size_t i, j, k, mask;
+
+    mask = index->capacity - 1;
+    i = entry - index->entries;
+
+    for ( j = ( i + 1 ) & mask; index->entries[j].first != NULL; j = ( j + 1 ) & mask )
+    {
+        k = index->entries[j].hash & mask;
+
+        /* can the entry at j move to the hole at i? (its home slot k isn't cyclically in (i, j]) */
+        if ( ( i <= j ) ? ( k <= i || k > j ) : ( k <= i && k > j ) )
+        {
+            index->entries[i] = index->entries[j];
+            i = j;
+        }
+    }
+
+    index->entries[i].first = NULL;
+    index->used--;
+}
+
+int cfx2_index_children( cfx2_Node* parent )
+{
+    cfx2_ChildIndex* index;
+    cfx2_Node* child;
+    ChildIndexEntry_t* entry;
+    size_t i, hash;
+
+    index = ( cfx2_ChildIndex* )index_alloc( parent, sizeof( cfx2_ChildIndex ) );
+
+    if ( index == NULL )
+        return cfx2_alloc_error;
+
+    index->capacity = 16;
+    index->used = 0;
+
+    while ( needs_growth( index, cfx2_list_length( parent->children ) ) )
+        index->capacity *= 2;
+
+    if ( ( index->entries = alloc_entries( parent, index->capacity ) ) == NULL )
+    {
+        index_free( parent, index );
+        return cfx2_alloc_error;
+    }
+
+    /* in list order, so the first child of each name is the one kept */
+    for ( i = 0; i < cfx2_list_length( parent->children ); i++ )
+    {
+        child = cfx2_item( parent->children, i, cfx2_Node* );
+        hash = cfx2_hash_name( name_of( child ) );
+        entry = lookup( index, name_of( child ), hash );
+
+        if ( entry->first != NULL )
+            entry->count++;
+        else
+        {
+            entry->hash = hash;
+            entry->first = child;
+            entry->count = 1;
+            index->used++;
+        }
+
+        child->index_parent = parent;
+    }
+
+    parent->child_index = index;
+    return cfx2_ok;
+}
+
+void cfx2_drop_child_index( cfx2_Node* parent )
+{
+    cfx2_Node* child;
+    size_t i;
+
+    if ( parent->child_index == NULL )
+        return;
+
+    for ( i = 0; i < cfx2_list_length( parent->children ); i++ )
+    {
+        child = cfx2_item( parent->children, i, cfx2_Node* );
+
+        if ( child->index_parent == parent )
+            child->index_parent = NULL;
+    }
+
+    index_free( parent, parent->child_index->entries );
+    index_free( parent, parent->child_index );
+    parent->child_index = NULL;
+}
+
+cfx2_Node* cfx2_index_find( const cfx2_ChildIndex* index, const char* name, size_t hash )
+{
+    return lookup( index, name, hash )->first;
+}
+
+/* Called once the child is in the list */
+void cfx2_index_add( cfx2_Node* parent, cfx2_Node* child )
+{
+    cfx2_ChildIndex* index;
+    ChildIndexEntry_t* entry;
+    size_t i, hash;
+
+    /* wide nodes get indexed as they grow, never by lookups, which may run on several threads */
+    if ( ( index = parent->child_index ) == NULL )
+    {
+        if ( cfx2_list_length( parent->children ) >= CHILD_INDEX_THRESHOLD )
+            cfx2_index_children( parent );
+
+        return;
+    }
+
+    if ( needs_growth( index, index->used + 1 ) && grow( parent ) != cfx2_ok )
+    {
+        cfx2_drop_child_index( parent );
+        return;
+    }
+
+    hash = cfx2_hash_name( name_of( child ) );
+    entry = lookup( index, name_of( child ), hash );
+
+    if ( entry->first == NULL )
+    {
+        entry->hash = hash;
+        entry->first = child;
+        entry->count = 1;
+        index->used++;
+    }
+    else
+    {
+        entry->count++;
+
+        /* an appended child is never the first of its name; otherwise see which comes first */
+        if ( cfx2_item( parent->children, cfx2_list_length( parent->children ) - 1, cfx2_Node* ) != child )
+        {
+            for ( i = 0; i < cfx2_list_length( parent->children ); i++ )
+            {
+                if ( cfx2_item( parent->children, i, cfx2_Node* ) == entry->first )
+                    break;
+
+                if ( cfx2_item( parent->children, i, cfx2_Node* ) == child )
+                {
+                    entry->first = child;
+                    break;
+                }
+            }
+        }
+    }
+
+    child->index_parent = parent;
+}
+
+/* Indexes a node filled in without maintenance (by the reader) if it is wide */
+void cfx2_index_node( cfx2_Node* node )
+{
+    if ( node->child_index == NULL && cfx2_list_length( node->children ) >= CHILD_INDEX_THRESHOLD )
+        cfx2_index_children( node );
+
+    if ( node->attrib_index == NULL && cfx2_list_length( node->attributes ) >= ATTRIB_INDEX_THRESHOLD )
+        cfx2_index_attribs( node );
+}
+
+/* Called with the child's name still as indexed; the child may already be out of the list */
+void cfx2_index_remove( cfx2_Node* parent, cfx2_Node* child )
+{
+    cfx2_ChildIndex* index;
+    ChildIndexEntry_t* entry;
+    cfx2_Node* next;
+    size_t i;
+
+    if ( ( index = parent->child_index ) == NULL )
+        return;
+
+    child->index_parent = NULL;
+    entry = lookup( index, name_of( child ), cfx2_hash_name( name_of( child ) ) );
+
+    if ( entry->first == NULL )
+        return;
+
+    if ( --entry->count == 0 )
+    {
+        delete_entry( index, entry );
+        return;
+    }
+
+    if ( entry->first != child )
+        return;
+
+    /* the next child of the same name takes over */
+    for ( i = 0; i < cfx2_list_length( parent->children ); i++ )
+    {
+        next = cfx2_item( parent->children, i, cfx2_Node* );
+
+        if ( next != child && strcmp( name_of( next ), name_of( child ) ) == 0 )
+        {
+            entry->first = next;
+            return;
+        }
+    }
+
+    /* out of sync (the list was changed behind our back) */
+    cfx2_drop_child_index( parent );
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Attribute Index                                                           */
+/* -------------------------------------------------------------------------- */
+
+#define attrib_at( node_, position_ ) ( &cfx2_item( ( node_ )->attributes, position_, cfx2_Attrib ) )
+#define attrib_name_at( node_, position_ ) name_of( attrib_at( node_, position_ ) )
+
+static AttribIndexEntry_t* alloc_attrib_entries( cfx2_Node* node, size_t capacity )
+{
+    AttribIndexEntry_t* entries;
+
+    entries = ( AttribIndexEntry_t* )index_alloc( node, capacity * sizeof( AttribIndexEntry_t ) );
+
+    if ( entries != NULL )
+        memset( entries, 0, capacity * sizeof( AttribIndexEntry_t ) );
+
+    return entries;
+}
+
+/* interned names are the same pointer, so that's checked before comparing */
+static AttribIndexEntry_t* lookup_attrib( cfx2_Node* node, const char* name, size_t hash )
+{
+    cfx2_AttribIndex* index;
+    const char* entry_name;
+    size_t i, mask;
+
+    index = node->attrib_index;
+    mask = index->capacity - 1;
+
+    for ( i = hash & mask; index->entries[i].count != 0; i = ( i + 1 ) & mask )
+        if ( index->entries[i].hash == hash )
+        {
+            entry_name = attrib_name_at( node, index->entries[i].position );
+
+            if ( entry_name == name || strcmp( entry_name, name ) == 0 )
+                break;
+        }
+
+    return &index->entries[i];
+}
+
+static int grow_attrib_index( cfx2_Node* node )
+{
+    cfx2_AttribIndex* index;
+    AttribIndexEntry_t* entries;
+    size_t i, j, capacity, mask;
+
+    index = node->attrib_index;
+    capacity = index->capacity * 2;
+    mask = capacity - 1;
+
+    if ( ( entries = alloc_attrib_entries( node, capacity ) ) == NULL )
+        return cfx2_alloc_error;
+
+    for ( i = 0; i < index->capacity; i++ )
+        if ( index->entries[i].count != 0 )
+        {
+            for ( j = index->entries[i].hash & mask; entries[j].count != 0; j = ( j + 1 ) & mask )
+                ;
+
+            entries[j] = index->entries[i];
+        }
+
+    index_free( node, index->entries );
+    index->entries = entries;
+    index->capacity = capacity;
+    return cfx2_ok;
+}
+
+static void delete_attrib_entry( cfx2_AttribIndex* index, AttribIndexEntry_t* entry )
+{
+    size_t i, j, k, mask;
+
+    mask = index->capacity - 1;
+    i = entry - index->entries;
+
+    for ( j = ( i + 1 ) & mask; index->entries[j].count != 0; j = ( j + 1 ) & mask )
+    {
+        k = index->entries[j].hash & mask;
+
+        if ( ( i <= j ) ? ( k <= i || k > j ) : ( k <= i && k > j ) )
+        {
+            index->entries[i] = index->entries[j];
+            i = j;
+        }
+    }
+
+    index->entries[i].count = 0;
+    index->used--;
+}
+
+/* Adds the attribute at position, unless one of the same name comes first */
+static void insert_attrib( cfx2_Node* node, size_t position )
+{
+    AttribIndexEntry_t* entry;
+    const char* name;
+    size_t hash;
+
+    name = attrib_name_at( node, position );
+    hash = cfx2_hash_name( name );
+    entry = lookup_attrib( node, name, hash );
+
+    if ( entry->count++ == 0 )
+    {
+        entry->hash = hash;
+        entry->position = position;
+        node->attrib_index->used++;
+    }
+}
+
+int cfx2_index_attribs( cfx2_Node* node )
+{
+    cfx2_AttribIndex* index;
+    size_t i;
+
+    index = ( cfx2_AttribIndex* )index_alloc( node, sizeof( cfx2_AttribIndex ) );
+
+    if ( index == NULL )
+        return cfx2_alloc_error;
+
+    index->capacity = 16;
+    index->used = 0;
+
+    while ( needs_growth( index, cfx2_list_length( node->attributes ) ) )
+        index->capacity *= 2;
+
+    if ( ( index->entries = alloc_attrib_entries( node, index->capacity ) ) == NULL )
+    {
+        index_free( node, index );
+        return cfx2_alloc_error;
+    }
+
+    node->attrib_index = index;
+
+    for ( i = 0; i < cfx2_list_length( node->attributes ); i++ )
+        insert_attrib( node, i );
+
+    return cfx2_ok;
+}
+
+void cfx2_drop_attrib_index( cfx2_Node* node )
+{
+    if ( node->attrib_index == NULL )
+        return;
+
+    index_free( node, node->attrib_index->entries );
+    index_free( node, node->attrib_index );
+    node->attrib_index = NULL;
+}
+
+cfx2_Attrib* cfx2_attrib_index_find( cfx2_Node* node, const char* name, size_t hash )
+{
+    AttribIndexEntry_t* entry;
+
+    entry = lookup_attrib( node, name, hash );
+
+    if ( entry->count == 0 )
+        return NULL;
+
+    return attrib_at( node, entry->position );
+}
+
+/* Called once the attribute, appended at position, has its name */
+void cfx2_attrib_index_add( cfx2_Node* node, size_t position )
+{
+    if ( node->attrib_index == NULL )
+    {
+        if ( cfx2_list_length( node->attributes ) >= ATTRIB_INDEX_THRESHOLD )
+            cfx2_index_attribs( node );
+
+        return;
+    }
+
+    if ( needs_growth( node->attrib_index, node->attrib_index->used + 1 ) && grow_attrib_index( node ) != cfx2_ok )
+    {
+        cfx2_drop_attrib_index( node );
+        return;
+    }
+
+    insert_attrib( node, position );
+}
+
+/* Called before the attribute at position is taken out of the list */
+void cfx2_attrib_index_remove( cfx2_Node* node, size_t position )
+{
+    cfx2_AttribIndex* index;
+    AttribIndexEntry_t* entry;
+    const char* name;
+    size_t i;
+
+    if ( ( index = node->attrib_index ) == NULL )
+        return;
+
+    name = attrib_name_at( node, position );
+    entry = lookup_attrib( node, name, cfx2_hash_name( name ) );
+
+    if ( entry->count == 0 )
+        return;
+
+    if ( --entry->count == 0 )
+        delete_attrib_entry( index, entry );
+    else if ( entry->position == position )
+    {
+        /* the next attribute of the same name takes over */
+        for ( i = position + 1; i < cfx2_list_length( node->attributes ); i++ )
+            if ( strcmp( attrib_name_at( node, i ), name ) == 0 )
+                break;
+
+        if ( i == cfx2_list_length( node->attributes ) )
+        {
+            cfx2_drop_attrib_index( node );
+            return;
+        }
+
+        entry->position = i;
+    }
+
+    /* later attributes move down by one */
+    for ( i = 0; i < index->capacity; i++ )
+        if ( index->entries[i].count != 0 && index->entries[i].position > position )
+            index->entries[i].position--;
+}
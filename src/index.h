@@ -0,0 +1,94 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+
+#ifndef libcfx2_index_h
+#define libcfx2_index_h
+
+#include <confix2.h>
+
+/*
+ *  Child index: a hash table of a node's children by name, built as children are added
+ *  once the node has CHILD_INDEX_THRESHOLD of them; lookups only read it. Each distinct
+ *  name maps to the first child of that name (the one cfx2_find_child returns) and to
+ *  the number of children sharing it. Indexed children point back at their parent (index_parent),
+ *  so renaming them keeps the index in sync.
+ *
+ *  Maintenance never fails: if the table can't grow, it is dropped and lookups fall
+ *  back to scanning the children until the next child is added.
+ */
+
+typedef struct ChildIndexEntry_t ChildIndexEntry_t;
+
+struct ChildIndexEntry_t
+{
+    size_t hash;
+    cfx2_Node* first;           /* NULL for an empty slot */
+    size_t count;
+};
+
+struct cfx2_ChildIndex
+{
+    size_t capacity, used;      /* capacity is a power of 2 */
+    ChildIndexEntry_t* entries;
+};
+
+/*
+ *  Attribute index: the same for attributes, for nodes with ATTRIB_INDEX_THRESHOLD
+ *  of them. Entries hold the position of the first attribute of each name.
+ */
+
+typedef struct AttribIndexEntry_t AttribIndexEntry_t;
+
+struct AttribIndexEntry_t
+{
+    size_t hash;
+    size_t position;
+    size_t count;               /* 0 for an empty slot */
+};
+
+struct cfx2_AttribIndex
+{
+    size_t capacity, used;
+    AttribIndexEntry_t* entries;
+};
+
+size_t cfx2_hash_name( const char* name );
+size_t cfx2_hash_bytes( const char* data, size_t length );
+
+int cfx2_index_children( cfx2_Node* parent );
+void cfx2_drop_child_index( cfx2_Node* parent );
+cfx2_Node* cfx2_index_find( const cfx2_ChildIndex* index, const char* name, size_t hash );
+
+void cfx2_index_add( cfx2_Node* parent, cfx2_Node* child );
+void cfx2_index_node( cfx2_Node* node );
+void cfx2_index_remove( cfx2_Node* parent, cfx2_Node* child );
+
+int cfx2_index_attribs( cfx2_Node* node );
+void cfx2_drop_attrib_index( cfx2_Node* node );
+cfx2_Attrib* cfx2_attrib_index_find( cfx2_Node* node, const char* name, size_t hash );
+
+void cfx2_attrib_index_add( cfx2_Node* node, size_t position );
+void cfx2_attrib_index_remove( cfx2_Node* node, size_t position );
+
+#endif
@@ -0,0 +1,180 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+
+#include "alloc.h"
+#include "arena.h"
+#include "config.h"
+#include "index.h"
+#include "intern.h"
+#include "node.h"
+
+#include <confix2.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void* table_alloc( NameTable_t* table, size_t size )
+{
+    if ( table->arena != NULL )
+        return cfx2_arena_alloc( table->arena, size );
+    else
+        return cfx2_alloc_with( table->allocator, size, cfx2_mem_index );
+}
+
+static void table_free( NameTable_t* table, void* ptr )
+{
+    if ( table->arena == NULL )
+        cfx2_free_with( table->allocator, ptr );
+}
+
+static int grow( NameTable_t* table )
+{
+    InternEntry_t* entries;
+    size_t i, j, capacity, mask;
+
+    capacity = ( table->capacity != 0 ) ? table->capacity * 2 : 64;
+    mask = capacity - 1;
+
+    entries = ( InternEntry_t* )table_alloc( table, capacity * sizeof( InternEntry_t ) );
+
+    if ( entries == NULL )
+        return cfx2_alloc_error;
+
+    memset( entries, 0, capacity * sizeof( InternEntry_t ) );
+
+    for ( i = 0; i < table->capacity; i++ )
+        if ( table->entries[i].name != NULL )
+        {
+            for ( j = table->entries[i].hash & mask; entries[j].name != NULL; j = ( j + 1 ) & mask )
+                ;
+
+            entries[j] = table->entries[i];
+        }
+
+    table_free( table, table->entries );
+    table->entries = entries;
+    table->capacity = capacity;
+    return cfx2_ok;
+}
+
+void cfx2_names_init( NameTable_t* table, cfx2_Arena* arena, const cfx2_Allocator* allocator )
+{
+    table->arena = arena;
+    table->allocator = allocator;
+
+    table->capacity = 0;
+    table->used = 0;
+    table->entries = NULL;
+}
+
+void cfx2_names_release( NameTable_t* table )
+{
+    table_free( table, table->entries );
+
+    table->capacity = 0;
+    table->used = 0;
+    table->entries = NULL;
+}
+
+int cfx2_intern_name( NameTable_t* table, char** ptr_out, const char* name, size_t length )
+{
+    InternEntry_t* entry;
+    size_t hash, i, mask;
+    char* chunk;
+    int rc;
+
+    hash = cfx2_hash_bytes( name, length );
+
+    if ( table->capacity != 0 )
+    {
+        mask = table->capacity - 1;
+
+        for ( i = hash & mask; table->entries[i].name != NULL; i = ( i + 1 ) & mask )
+        {
+            entry = &table->entries[i];
+
+            if ( entry->hash == hash && strncmp( entry->name, name, length ) == 0 && entry->name[length] == 0 )
+            {
+                /* one more user of a heap name */
+                if ( table->arena == NULL )
+                    ( *( s_nref_t* )( entry->name - sizeof( s_nref_t ) ) )++;
+
+                *ptr_out = entry->name;
+                return cfx2_ok;
+            }
+        }
+    }
+
+    if ( table->used >= INTERN_MAX_NAMES )
+    {
+        *ptr_out = NULL;
+        return cfx2_ok;
+    }
+
+    /* keep the table at most half full */
+    if ( ( table->used + 1 ) * 2 > table->capacity && ( rc = grow( table ) ) != cfx2_ok )
+        return rc;
+
+    if ( table->arena != NULL )
+        chunk = ( char* )cfx2_arena_alloc( table->arena, sizeof( s_nref_t ) + length + 1 );
+    else
+        chunk = ( char* )libcfx2_malloc( sizeof( s_nref_t ) + length + 1, cfx2_mem_string );
+
+    if ( chunk == NULL )
+        return cfx2_alloc_error;
+
+    /* arena names are never freed; a heap name is freed with its last attribute */
+    *( s_nref_t* )chunk = ( table->arena != NULL ) ? 0 : 1;
+    chunk += sizeof( s_nref_t );
+
+    memcpy( chunk, name, length );
+    chunk[length] = 0;
+
+    mask = table->capacity - 1;
+
+    for ( i = hash & mask; table->entries[i].name != NULL; i = ( i + 1 ) & mask )
+        ;
+
+    table->entries[i].hash = hash;
+    table->entries[i].name = chunk;
+    table->used++;
+
+    *ptr_out = chunk;
+    return cfx2_ok;
+}
+
+int cfx2_names_contain( const NameTable_t* table, const char* name )
+{
+    size_t i, mask;
+
+    if ( table->capacity == 0 )
+        return 0;
+
+    mask = table->capacity - 1;
+
+    for ( i = cfx2_hash_name( name ) & mask; table->entries[i].name != NULL; i = ( i + 1 ) & mask )
+        if ( table->entries[i].name == name )
+            return 1;
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+
+#ifndef libcfx2_intern_h
+#define libcfx2_intern_h
+
+#include <confix2.h>
+
+/*
+ *  Attribute name interning: documents repeat a handful of attribute names over and
+ *  over, so each distinct name is stored once and shared by all attributes using it.
+ *  Heap documents share reference-counted strings; the table itself only lives while
+ *  the document is being read. Arena documents keep their table (and names) in the
+ *  arena, so attributes added later are interned too.
+ *
+ *  Once a table holds INTERN_MAX_NAMES names it stops taking new ones, so documents
+ *  without repetition don't pay for a huge table.
+ */
+
+typedef struct InternEntry_t InternEntry_t;
+typedef struct NameTable_t NameTable_t;
+
+struct InternEntry_t
+{
+    size_t hash;
+    char* name;                 /* NULL for an empty slot */
+};
+
+struct NameTable_t
+{
+    cfx2_Arena* arena;          /* names and table come from the arena, if any */
+    const cfx2_Allocator* allocator;
+
+    size_t capacity, used;
+    InternEntry_t* entries;
+};
+
+void cfx2_names_init( NameTable_t* table, cfx2_Arena* arena, const cfx2_Allocator* allocator );
+void cfx2_names_release( NameTable_t* table );
+
+/* *ptr_out is NULL if the name isn't in the table and the table is full */
+int cfx2_intern_name( NameTable_t* table, char** ptr_out, const char* name, size_t length );
+
+/* whether name is one of the table's own strings (not just an equal one) */
+int cfx2_names_contain( const NameTable_t* table, const char* name );
+
+#endif
@@ -21,6 +21,7 @@
     distribution.
 */
 
+#include "alloc.h"
 #include "config.h"
 #include "io.h"
 
@@ -29,11 +30,21 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 /* -------------------------------------------------------------------------- */
 /*  Buffer Input                                                              */
 /* -------------------------------------------------------------------------- */
 
-static int BufferInput_on_error( cfx2_RdOpt* rd_opt, int error_code, int line, const char* desc )
+int BufferInput_on_error( cfx2_RdOpt* rd_opt, int error_code, int line, const char* desc )
 {
     printf( "libcfx2 Error %i: '%s'\n", error_code, desc );
     printf( "  This error occured when parsing a cfx2 document.\n" );
@@ -55,6 +66,7 @@ static int BufferInput_on_error( cfx2_RdOpt* rd_opt, int error_code, int line, c
 int cfx2_buffer_input_from_file( cfx2_RdOpt* rd_opt, const char* filename )
 {
     FILE* file;
+    char* document;
 
     file = fopen( filename, "rb" );
 
@@ -65,18 +77,20 @@ int cfx2_buffer_input_from_file( cfx2_RdOpt* rd_opt, const char* filename )
     rd_opt->document_len = ftell( file );
     fseek( file, 0, SEEK_SET );
 
-    rd_opt->document = ( char* )libcfx2_malloc( rd_opt->document_len + 1 );
+    document = ( char* )cfx2_alloc_with( cfx2_rd_opt_allocator( rd_opt ), rd_opt->document_len + 1, cfx2_mem_input );
 
-    if ( !rd_opt->document )
+    if ( !document )
     {
         fclose( file );
         return cfx2_alloc_error;
     }
 
-    rd_opt->document_len = fread( rd_opt->document, 1, rd_opt->document_len, file );
-    rd_opt->document[rd_opt->document_len] = 0;
+    rd_opt->document_len = fread( document, 1, rd_opt->document_len, file );
+    document[rd_opt->document_len] = 0;
     fclose( file );
 
+    rd_opt->document = document;
+
     rd_opt->client_priv = NULL;
     rd_opt->on_error = BufferInput_on_error;
 
@@ -85,19 +99,137 @@ int cfx2_buffer_input_from_file( cfx2_RdOpt* rd_opt, const char* filename )
 
 int cfx2_buffer_input_from_string( cfx2_RdOpt* rd_opt, const char* string )
 {
+    /* the lexer doesn't modify its input, so the caller's string is parsed in place */
+    rd_opt->document = string;
     rd_opt->document_len = strlen( string );
-    rd_opt->document = ( char* )libcfx2_malloc( rd_opt->document_len + 1 );
+    rd_opt->flags |= cfx2_borrowed_input;
+
+    if ( rd_opt->on_error == NULL )
+        rd_opt->on_error = BufferInput_on_error;
+
+    return cfx2_ok;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Mapped Input                                                              */
+/* -------------------------------------------------------------------------- */
+
+/*
+ *  The lexer never writes to the document, so input is mapped read-only and stays
+ *  shared with the page cache. Empty files can't be mapped and are rejected here.
+ */
+
+#ifdef _WIN32
+int cfx2_map_file( const char* filename, const char** data_out, size_t* length_out )
+{
+    HANDLE file, mapping;
+    LARGE_INTEGER size;
+    void* view;
+
+    file = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+
+    if ( file == INVALID_HANDLE_VALUE )
+        return cfx2_cant_open_file;
+
+    if ( !GetFileSizeEx( file, &size ) || size.QuadPart == 0
+            || ( size_t ) size.QuadPart != size.QuadPart )
+    {
+        CloseHandle( file );
+        return cfx2_param_invalid;
+    }
+
+    mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+    CloseHandle( file );
+
+    if ( mapping == NULL )
+        return cfx2_alloc_error;
+
+    /* the view keeps the mapping object alive */
+    view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+    CloseHandle( mapping );
+
+    if ( view == NULL )
+        return cfx2_alloc_error;
+
+    *data_out = ( const char* )view;
+    *length_out = ( size_t ) size.QuadPart;
+    return cfx2_ok;
+}
+
+void cfx2_unmap_file( const char* data, size_t length )
+{
+    UnmapViewOfFile( data );
+}
+#else
+int cfx2_map_file( const char* filename, const char** data_out, size_t* length_out )
+{
+    struct stat st;
+    void* data;
+    int fd;
+
+    fd = open( filename, O_RDONLY );
+
+    if ( fd < 0 )
+        return cfx2_cant_open_file;
+
+    if ( fstat( fd, &st ) != 0 || st.st_size <= 0 || ( off_t )( size_t ) st.st_size != st.st_size )
+    {
+        close( fd );
+        return cfx2_param_invalid;
+    }
+
+    data = mmap( NULL, ( size_t ) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
 
-    if ( !rd_opt->document )
+    if ( data == MAP_FAILED )
         return cfx2_alloc_error;
 
-    memcpy( rd_opt->document, string, rd_opt->document_len + 1 );
+#ifdef MADV_SEQUENTIAL
+    madvise( data, ( size_t ) st.st_size, MADV_SEQUENTIAL );
+#endif
+
+    *data_out = ( const char* )data;
+    *length_out = ( size_t ) st.st_size;
+    return cfx2_ok;
+}
+
+void cfx2_unmap_file( const char* data, size_t length )
+{
+    munmap( ( void* )data, length );
+}
+#endif
+
+int cfx2_mapped_input_from_file( cfx2_RdOpt* rd_opt, const char* filename )
+{
+    int rc;
+
+    rc = cfx2_map_file( filename, &rd_opt->document, &rd_opt->document_len );
 
+    if ( rc == cfx2_cant_open_file )
+        return rc;
+    else if ( rc != cfx2_ok )
+    {
+        rd_opt->flags &= ~cfx2_mapped_input;
+        return cfx2_buffer_input_from_file( rd_opt, filename );
+    }
+
+    rd_opt->flags |= cfx2_mapped_input;
+    rd_opt->client_priv = NULL;
     rd_opt->on_error = BufferInput_on_error;
 
     return cfx2_ok;
 }
 
+void cfx2_release_input( cfx2_RdOpt* rd_opt )
+{
+    if ( rd_opt->flags & cfx2_mapped_input )
+        cfx2_unmap_file( rd_opt->document, rd_opt->document_len );
+    else if ( !( rd_opt->flags & cfx2_borrowed_input ) )
+        cfx2_free_with( cfx2_rd_opt_allocator( rd_opt ), ( void* )rd_opt->document );
+
+    rd_opt->document = NULL;
+}
+
 /* -------------------------------------------------------------------------- */
 /*  File Output                                                               */
 /* -------------------------------------------------------------------------- */
@@ -131,7 +263,7 @@ int cfx2_file_stream( cfx2_WrOpt* wr_opt, const char* filename )
 {
     cfx2_FileStreamPriv* output;
 
-    output = ( cfx2_FileStreamPriv* )libcfx2_malloc( sizeof( cfx2_FileStreamPriv ) );
+    output = ( cfx2_FileStreamPriv* )libcfx2_malloc( sizeof( cfx2_FileStreamPriv ), cfx2_mem_output );
 
     output->file = fopen( filename, "wt" );
 
@@ -167,8 +299,27 @@ static size_t MemoryStream_stream_write( cfx2_WrOpt* wr_opt, const char* input,
 {
     if ( *output->used + length > *output->capacity )
     {
-        *output->capacity += length + 64;
-        *output->text = ( char* )realloc( *output->text, *output->capacity );
+        char* text;
+        size_t capacity;
+
+        /* grow geometrically so the total copying stays linear */
+        capacity = *output->capacity * 2;
+
+        if ( capacity < *output->used + length )
+            capacity = *output->used + length;
+
+        if ( capacity < 64 )
+            capacity = 64;
+
+        text = ( char* )libcfx2_realloc( *output->text, capacity, cfx2_mem_output );
+
+        if ( text == NULL )
+            return 0;
+
+        cfx2_hand_over( text );
+
+        *output->text = text;
+        *output->capacity = capacity;
     }
 
     memcpy( *output->text + *output->used, input, length );
@@ -183,7 +334,7 @@ int cfx2_memory_stream( cfx2_WrOpt* wr_opt, char** text, size_t* capacity, size_
 {
     cfx2_MemoryStreamPriv* output;
 
-    output = ( cfx2_MemoryStreamPriv* )libcfx2_malloc( sizeof( cfx2_MemoryStreamPriv ) );
+    output = ( cfx2_MemoryStreamPriv* )libcfx2_malloc( sizeof( cfx2_MemoryStreamPriv ), cfx2_mem_output );
 
     if ( !output )
         return cfx2_alloc_error;
@@ -202,3 +353,50 @@ int cfx2_memory_stream( cfx2_WrOpt* wr_opt, char** text, size_t* capacity, size_
 }
 
 #undef output
+
+/* -------------------------------------------------------------------------- */
+/*  Fixed Output                                                              */
+/* -------------------------------------------------------------------------- */
+
+#define output ( ( cfx2_FixedStreamPriv* )wr_opt->stream_priv )
+
+static void FixedStream_stream_close( cfx2_WrOpt* wr_opt )
+{
+    libcfx2_free( output );
+}
+
+/* keeps counting past the end of the buffer, so the caller learns the size needed */
+static size_t FixedStream_stream_write( cfx2_WrOpt* wr_opt, const char* input, size_t length )
+{
+    if ( *output->used < output->capacity )
+        memcpy( output->buffer + *output->used, input,
+                ( length < output->capacity - *output->used ) ? length : output->capacity - *output->used );
+
+    *output->used += length;
+
+    return length;
+}
+
+#undef output
+
+int cfx2_fixed_stream( cfx2_WrOpt* wr_opt, char* buffer, size_t capacity, size_t* used )
+{
+    cfx2_FixedStreamPriv* output;
+
+    output = ( cfx2_FixedStreamPriv* )libcfx2_malloc( sizeof( cfx2_FixedStreamPriv ), cfx2_mem_output );
+
+    if ( !output )
+        return cfx2_alloc_error;
+
+    output->buffer = buffer;
+    output->capacity = capacity;
+    output->used = used;
+
+    wr_opt->client_priv = NULL;
+    wr_opt->on_error = FileStream_on_error;
+    wr_opt->stream_priv = output;
+    wr_opt->stream_write = FixedStream_stream_write;
+    wr_opt->stream_close = FixedStream_stream_close;
+
+    return cfx2_ok;
+}
@@ -44,10 +44,27 @@ typedef struct
 }
 cfx2_MemoryStreamPriv;
 
+/* Fixed Output */
+typedef struct
+{
+    char* buffer;
+    size_t capacity;
+    size_t* used;   /* may grow past capacity */
+}
+cfx2_FixedStreamPriv;
+
+int BufferInput_on_error( cfx2_RdOpt* rd_opt, int error_code, int line, const char* desc );
+
 int cfx2_buffer_input_from_file( cfx2_RdOpt* rd_opt, const char* filename );
 int cfx2_buffer_input_from_string( cfx2_RdOpt* rd_opt, const char* string );
+int cfx2_mapped_input_from_file( cfx2_RdOpt* rd_opt, const char* filename );
+void cfx2_release_input( cfx2_RdOpt* rd_opt );
+
+int cfx2_map_file( const char* filename, const char** data_out, size_t* length_out );
+void cfx2_unmap_file( const char* data, size_t length );
 
 int cfx2_file_stream( cfx2_WrOpt* rd_opt, const char* filename );
 int cfx2_memory_stream( cfx2_WrOpt* rd_opt, char** text, size_t* capacity, size_t* used );
+int cfx2_fixed_stream( cfx2_WrOpt* wr_opt, char* buffer, size_t capacity, size_t* used );
 
 #endif
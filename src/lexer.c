@@ -27,75 +27,351 @@
 #include <stdlib.h>
 #include <string.h>
 
-static int read_char( Lexer* lex, char* c_out )
+/*
+ *  Vectorized scanning: with SSE2 (or AVX2) available, identifiers, whitespace runs, strings
+ *  and comments are skipped 16 (32) bytes at a time. The scalar tails use lexer_char_class.
+ */
+
+#if defined( __AVX2__ )
+#include <immintrin.h>
+
+#define LEXER_VECTORIZED
+#define VEC_SIZE            32
+#define VEC_FULL            0xFFFFFFFFu
+
+typedef __m256i vec_t;
+
+#define vec_load( p_ )      _mm256_loadu_si256( ( const __m256i* )( p_ ) )
+#define vec_set( c_ )       _mm256_set1_epi8( ( char )( c_ ) )
+#define vec_eq( a_, b_ )    _mm256_cmpeq_epi8( a_, b_ )
+#define vec_lt( a_, b_ )    _mm256_cmpgt_epi8( b_, a_ )
+#define vec_add( a_, b_ )   _mm256_add_epi8( a_, b_ )
+#define vec_or( a_, b_ )    _mm256_or_si256( a_, b_ )
+#define vec_mask( v_ )      ( ( unsigned int ) _mm256_movemask_epi8( v_ ) )
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+
+#define LEXER_VECTORIZED
+#define VEC_SIZE            16
+#define VEC_FULL            0xFFFFu
+
+typedef __m128i vec_t;
+
+#define vec_load( p_ )      _mm_loadu_si128( ( const __m128i* )( p_ ) )
+#define vec_set( c_ )       _mm_set1_epi8( ( char )( c_ ) )
+#define vec_eq( a_, b_ )    _mm_cmpeq_epi8( a_, b_ )
+#define vec_lt( a_, b_ )    _mm_cmplt_epi8( a_, b_ )
+#define vec_add( a_, b_ )   _mm_add_epi8( a_, b_ )
+#define vec_or( a_, b_ )    _mm_or_si128( a_, b_ )
+#define vec_mask( v_ )      ( ( unsigned int ) _mm_movemask_epi8( v_ ) )
+#endif
+
+#ifdef LEXER_VECTORIZED
+/* bytes in [lo, hi]; shifts lo to -128 so that a single signed compare does the job */
+#define vec_in_range( v_, lo_, hi_ ) vec_lt( vec_add( v_, vec_set( 0x80 - ( lo_ ) ) ), vec_set( 0x80 + ( hi_ ) - ( lo_ ) + 1 ) )
+
+#ifdef _MSC_VER
+#include <intrin.h>
+
+static unsigned int bit_scan_forward( unsigned int v )
+{
+    unsigned long index;
+
+    _BitScanForward( &index, v );
+    return index;
+}
+
+static unsigned int bit_scan_reverse( unsigned int v )
+{
+    unsigned long index;
+
+    _BitScanReverse( &index, v );
+    return index;
+}
+#else
+#define bit_scan_forward( v_ )  ( ( unsigned int ) __builtin_ctz( v_ ) )
+#define bit_scan_reverse( v_ )  ( 31u - ( unsigned int ) __builtin_clz( v_ ) )
+#endif
+
+/*
+ *  http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
+ */
+static unsigned int count_bits( unsigned int v )
+{
+    v = v - ( ( v >> 1 ) & 0x55555555u );
+    v = ( v & 0x33333333u ) + ( ( v >> 2 ) & 0x33333333u );
+    return ( ( ( v + ( v >> 4 ) ) & 0x0F0F0F0Fu ) * 0x01010101u ) >> 24;
+}
+
+static unsigned int ident_mask( vec_t v )
+{
+    vec_t m;
+
+    m = vec_or( vec_in_range( v, '0', '9' ), vec_in_range( v, '@', 'Z' ) );
+    m = vec_or( m, vec_in_range( v, 'a', 'z' ) );
+    m = vec_or( m, vec_in_range( v, '#', '%' ) );
+    m = vec_or( m, vec_or( vec_eq( v, vec_set( '!' ) ), vec_eq( v, vec_set( '-' ) ) ) );
+    m = vec_or( m, vec_or( vec_eq( v, vec_set( '_' ) ), vec_eq( v, vec_set( '~' ) ) ) );
+
+    return vec_mask( m );
+}
+#endif
+
+#define S CC_space
+#define I ( CC_ident | CC_text )
+#define Q CC_text
+
+/* must agree with isspace() and isalnum() in the C locale */
+const cfx2_uint8_t lexer_char_class[256] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 0, S, S, S, S, S, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    S, I, Q, I, I, I, 0, Q, 0, 0, 0, 0, 0, I, 0, 0,
+    I, I, I, I, I, I, I, I, I, I, 0, 0, 0, 0, 0, 0,
+    I, I, I, I, I, I, I, I, I, I, I, I, I, I, I, I,
+    I, I, I, I, I, I, I, I, I, I, I, 0, 0, 0, 0, I,
+    0, I, I, I, I, I, I, I, I, I, I, I, I, I, I, I,
+    I, I, I, I, I, I, I, I, I, I, I, 0, 0, 0, I, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+#undef S
+#undef I
+#undef Q
+
+/* Returns the position of the first non-whitespace character, counting lines and indentation */
+static size_t skip_spaces( Lexer* lex, size_t pos, unsigned short* indent_out )
+{
+    const char* doc;
+    unsigned short indent;
+
+    doc = lex->document;
+    indent = *indent_out;
+
+#ifdef LEXER_VECTORIZED
+    while ( pos + VEC_SIZE <= lex->document_len )
+    {
+        vec_t v, spaces, tabs;
+        unsigned int whitespace, newlines, valid, n;
+
+        v = vec_load( doc + pos );
+        spaces = vec_eq( v, vec_set( ' ' ) );
+        tabs = vec_eq( v, vec_set( '\t' ) );
+
+        whitespace = vec_mask( vec_or( spaces, vec_in_range( v, '\t', '\r' ) ) );
+
+        if ( whitespace == VEC_FULL )
+        {
+            n = VEC_SIZE;
+            valid = VEC_FULL;
+        }
+        else
+        {
+            n = bit_scan_forward( ~whitespace );
+            valid = ( 1u << n ) - 1;
+        }
+
+        /* indentation only counts from the last newline on */
+        newlines = vec_mask( vec_eq( v, vec_set( '\n' ) ) ) & valid;
+
+        if ( newlines != 0 )
+        {
+            lex->line += count_bits( newlines );
+            indent = 0;
+            valid &= ~( ( 2u << bit_scan_reverse( newlines ) ) - 1 );
+        }
+
+        indent += ( unsigned short )( count_bits( vec_mask( spaces ) & valid )
+                + 4 * count_bits( vec_mask( tabs ) & valid ) );
+
+        pos += n;
+
+        if ( n < VEC_SIZE )
+        {
+            *indent_out = indent;
+            return pos;
+        }
+    }
+#endif
+
+    for ( ; pos < lex->document_len && ( lexer_char_class[( unsigned char ) doc[pos]] & CC_space ); pos++ )
+    {
+        if ( doc[pos] == '\n' )
+        {
+            lex->line++;
+            indent = 0;
+        }
+        else if ( doc[pos] == ' ' )
+            indent++;
+        else if ( doc[pos] == '\t' )
+            indent += 4;
+    }
+
+    *indent_out = indent;
+    return pos;
+}
+
+/* Returns the position of the comment terminator or the document length */
+static size_t skip_comment( Lexer* lex, size_t pos )
 {
-    if ( lex->queued_char )
+    const char* doc;
+
+    doc = lex->document;
+
+#ifdef LEXER_VECTORIZED
+    while ( pos + VEC_SIZE <= lex->document_len )
     {
-        *c_out = lex->queued_char;
-        lex->queued_char = 0;
-        return 1;
+        vec_t v;
+        unsigned int closing, newlines;
+
+        v = vec_load( doc + pos );
+        closing = vec_mask( vec_eq( v, vec_set( '}' ) ) );
+        newlines = vec_mask( vec_eq( v, vec_set( '\n' ) ) );
+
+        if ( closing != 0 )
+        {
+            pos += bit_scan_forward( closing );
+            lex->line += count_bits( newlines & ( ( 1u << bit_scan_forward( closing ) ) - 1 ) );
+            return pos;
+        }
+
+        lex->line += count_bits( newlines );
+        pos += VEC_SIZE;
     }
+#endif
 
-    if ( lex->document_pos >= lex->document_len )
-        return 0;
+    for ( ; pos < lex->document_len && doc[pos] != '}'; pos++ )
+        if ( doc[pos] == '\n' )
+            lex->line++;
 
-    *c_out = lex->document[lex->document_pos++];
-    return 1;
+    return pos;
 }
 
-static int read_ident( Lexer* lex, char next_char )
+static int read_ident( Lexer* lex )
 {
-    lex->current_token.text = &lex->document[lex->document_pos];
+    const char* doc;
+    size_t pos;
+
+    doc = lex->document;
+
+    /* when resuming, the part scanned before is known to be good */
+    pos = ( lex->scan_pos > lex->document_pos ) ? lex->scan_pos : lex->document_pos;
 
     /* Continue until an non-ident character is met */
-    while ( read_char( lex, &next_char ) )
+#ifdef LEXER_VECTORIZED
+    while ( pos + VEC_SIZE <= lex->document_len )
     {
-        if ( !is_ident_char( next_char ) )
+        unsigned int ident;
+
+        ident = ident_mask( vec_load( doc + pos ) );
+
+        if ( ident != VEC_FULL )
         {
-            lex->queued_char = next_char;
-            --lex->document_pos;
-            break;
+            pos += bit_scan_forward( ~ident );
+            goto label_done;
         }
+
+        pos += VEC_SIZE;
     }
+#endif
+
+    while ( pos < lex->document_len && is_ident_char( doc[pos] ) )
+        pos++;
 
-    lex->document[lex->document_pos] = 0;
+    /* the identifier might continue in the next chunk */
+    if ( pos >= lex->document_len && !lex->input_final )
+    {
+        lex->scan_pos = pos;
+        return lexer_need_input;
+    }
 
-    ++lex->document_pos;
+#ifdef LEXER_VECTORIZED
+    label_done:
+#endif
+    lex->current_token.text = &doc[lex->document_pos];
+    lex->current_token.length = pos - lex->document_pos;
+    lex->document_pos = pos;
 
     return cfx2_ok;
 }
 
 static int read_string( Lexer* lex, char terminating )
 {
-    char next_char;
+    const char* doc;
+    size_t pos;
 
-    lex->current_token.text = &lex->document[lex->document_pos];
+    doc = lex->document;
+    pos = ( lex->scan_pos > lex->document_pos ) ? lex->scan_pos : lex->document_pos;
 
     for ( ; ; )
     {
-        if ( !read_char( lex, &next_char ) )
-            return cfx2_EOF;
+        /* Skip ahead to the next terminator or escape */
+#ifdef LEXER_VECTORIZED
+        while ( pos + VEC_SIZE <= lex->document_len )
+        {
+            vec_t v;
+            unsigned int special;
+
+            v = vec_load( doc + pos );
+            special = vec_mask( vec_or( vec_eq( v, vec_set( terminating ) ), vec_eq( v, vec_set( '\\' ) ) ) );
 
-        if ( next_char == terminating )
+            if ( special != 0 )
+            {
+                pos += bit_scan_forward( special );
+                break;
+            }
+
+            pos += VEC_SIZE;
+        }
+#endif
+
+        while ( pos < lex->document_len && doc[pos] != terminating && doc[pos] != '\\' )
+            pos++;
+
+        if ( pos >= lex->document_len || ( doc[pos] == '\\' && pos + 1 >= lex->document_len ) )
         {
-            /* don't include the terminator */
-            --lex->document_pos;
-            break;
+            lex->scan_pos = pos;
+            return lex->input_final ? cfx2_EOF : lexer_need_input;
         }
 
-        if ( next_char == '\\' )
-            if ( !read_char( lex, &next_char ) )
-                return cfx2_EOF;
+        if ( doc[pos] == terminating )
+            break;
+
+        /* escape sequence; the escaped character is skipped too */
+        pos += 2;
     }
 
-    lex->document[lex->document_pos] = 0;
+    /* don't include the terminator */
+    lex->current_token.text = &doc[lex->document_pos];
+    lex->current_token.length = pos - lex->document_pos;
 
     /* ok to skip terminator now */
-    ++lex->document_pos;
+    lex->document_pos = pos + 1;
 
     return cfx2_ok;
 }
 
+/* Stops at the end of available input; with more input to come, the scan resumes from here */
+static int suspend_scan( Lexer* lexer, int scan_state, unsigned short indent )
+{
+    if ( lexer->input_final )
+    {
+        lexer->scan_state = SCAN_none;
+        return cfx2_EOF;
+    }
+
+    lexer->scan_state = scan_state;
+    lexer->scan_indent = indent;
+    return lexer_need_input;
+}
+
 int create_lexer( Lexer* lexer, cfx2_RdOpt* rd_opt )
 {
     lexer->rd_opt = rd_opt;
@@ -104,20 +380,43 @@ int create_lexer( Lexer* lexer, cfx2_RdOpt* rd_opt )
     lexer->document_pos = 0;
 
     lexer->line = 1;
-    lexer->queued_char = 0;
+
+    lexer->input_final = 1;
+    lexer->scan_state = SCAN_none;
+    lexer->scan_indent = 0;
+    lexer->scan_pos = 0;
 
     lexer->current_token.type = T_none;
     lexer->current_token.text = NULL;
+    lexer->current_token.length = 0;
     lexer->current_token_is_valid = 0;
 
     return cfx2_ok;
 }
 
+void lexer_set_input( Lexer* lexer, const char* document, size_t document_len, int input_final )
+{
+    lexer->document = document;
+    lexer->document_len = document_len;
+    lexer->input_final = input_final;
+}
+
+/* The first offset bytes of input have been dropped */
+void lexer_rebase( Lexer* lexer, size_t offset )
+{
+    lexer->document_pos -= offset;
+
+    if ( lexer->scan_pos > 0 )
+        lexer->scan_pos -= offset;
+}
+
 int lexer_get_current( Lexer* lexer, Token** token_out )
 {
     Token* token;
     char resolutor;
     unsigned short indent;
+    size_t token_start;
+    int error_read;
 
     if ( lexer->current_token_is_valid )
     {
@@ -127,43 +426,51 @@ int lexer_get_current( Lexer* lexer, Token** token_out )
         return cfx2_ok;
     }
 
-    /* Skip all spaces, newlines, tabs etc. */
+    /* Pick up where the previous chunk of input ended */
+    switch ( lexer->scan_state )
+    {
+        case SCAN_spaces:
+            indent = lexer->scan_indent;
+            goto label_spaces;
+
+        case SCAN_comment:
+            goto label_comment;
+
+        case SCAN_token:
+            indent = lexer->scan_indent;
+            goto label_token;
+    }
+
     label_skip_spaces:
 
     indent = 0;
 
-    do
-    {
-        if ( !read_char( lexer, &resolutor ) )
-            return cfx2_EOF;
+    /* Skip all spaces, newlines, tabs etc. */
+    label_spaces:
 
-        if ( resolutor == '\n' )
-        {
-            lexer->line++;
-            indent = 0;
-        }
-        else if ( resolutor == ' ' )
-            indent++;
-        else if ( resolutor == '\t' )
-            indent += 4;
-    }
-    while ( isspace( resolutor ) );
+    lexer->document_pos = skip_spaces( lexer, lexer->document_pos, &indent );
+
+    if ( lexer->document_pos >= lexer->document_len )
+        return suspend_scan( lexer, SCAN_spaces, indent );
+
+    label_token:
+
+    token_start = lexer->document_pos;
+    resolutor = lexer->document[lexer->document_pos++];
 
     /* A multi-line comment was found */
     if ( resolutor == '{' )
     {
+        label_comment:
+
         /* just look for '}' and don't forget to count lines */
-        do
-        {
-            if ( !read_char( lexer, &resolutor ) )
-                return cfx2_EOF;
+        lexer->document_pos = skip_comment( lexer, lexer->document_pos );
 
-            if ( resolutor == '\n' )
-                lexer->line++;
-        }
-        while ( resolutor != '}' );
+        if ( lexer->document_pos >= lexer->document_len )
+            return suspend_scan( lexer, SCAN_comment, 0 );
 
         /* ...and go back to the start */
+        lexer->document_pos++;
         goto label_skip_spaces;
     }
 
@@ -185,44 +492,23 @@ int lexer_get_current( Lexer* lexer, Token** token_out )
 
         default:
         {
-            int error_read;
-
             /* Identifier */
             if ( is_ident_char( resolutor ) )
             {
                 --lexer->document_pos;
-                error_read = read_ident( lexer, resolutor );
-
-                if ( error_read )
-                {
-                    if ( error_read == cfx2_EOF )
-                        lexer->rd_opt->on_error( lexer->rd_opt, error_read, lexer->line, "Unexpected end of input." );
-                    else
-                        lexer->rd_opt->on_error( lexer->rd_opt, error_read, lexer->line, "An internal error occured in the document lexical analyzer." );
-
-                    return error_read;
-                }
-
+                error_read = read_ident( lexer );
                 token->type = T_text;
             }
             /* Text value */
             else if ( resolutor == '\'' )
             {
                 error_read = read_string( lexer, '\'' );
-
-                if ( error_read )
-                    return error_read;
-
                 token->type = T_text;
             }
             /* String */
             else if ( resolutor == '"' )
             {
                 error_read = read_string( lexer, '"' );
-
-                if ( error_read )
-                    return error_read;
-
                 token->type = T_string;
             }
             else
@@ -230,9 +516,21 @@ int lexer_get_current( Lexer* lexer, Token** token_out )
                 lexer->rd_opt->on_error( lexer->rd_opt, cfx2_syntax_error, lexer->line, "Unexpected character in input." );
                 return cfx2_syntax_error;
             }
+
+            if ( error_read == lexer_need_input )
+            {
+                /* rescan the token once more input arrives */
+                lexer->document_pos = token_start;
+                return suspend_scan( lexer, SCAN_token, indent );
+            }
+            else if ( error_read )
+                return error_read;
         }
     }
 
+    lexer->scan_state = SCAN_none;
+    lexer->scan_pos = 0;
+
     if ( token_out != NULL )
         *token_out = token;
     
@@ -27,7 +27,6 @@
 #include "io.h"
 
 #include <confix2.h>
-#include <ctype.h>
 
 typedef short TokenType;
 #define T_none      ( -1 )
@@ -41,9 +40,15 @@ typedef short TokenType;
 #define T_string    7
 #define T_equals    8
 
-#define is_ident_char( c ) ( isalnum( ( unsigned char ) c ) || (c) == '_'\
-        || (c) == '-' || (c) == '~' || (c) == '!' || (c) == '@' || (c) == '#'\
-        || (c) == '$' || (c) == '%' )
+/* Character Classes */
+#define CC_ident    1   /* alphanumerics and _-~!@#$% */
+#define CC_space    2   /* isspace() in the C locale */
+#define CC_text     4   /* starts a T_text or T_string token: CC_ident and both quotes */
+
+extern const cfx2_uint8_t lexer_char_class[256];
+
+#define is_ident_char( c ) ( lexer_char_class[( unsigned char )( c )] & CC_ident )
+#define starts_text( c ) ( lexer_char_class[( unsigned char )( c )] & CC_text )
 
 /*
 
@@ -55,26 +60,42 @@ typedef short TokenType;
 
 */
 
+/* token text is a slice of the document; it is not NUL-terminated */
 typedef struct
 {
     TokenType type;
     unsigned short indent;
     int line;
 
-    char* text;
+    const char* text;
+    size_t length;
 }
 Token;
 
+/* returned by the lexer when the input ends mid-token and more input may follow */
+#define lexer_need_input    ( -1 )
+
+/* scan states for incremental input */
+#define SCAN_none       0
+#define SCAN_spaces     1   /* skipping whitespace, scan_indent counted so far */
+#define SCAN_comment    2   /* inside a multi-line comment */
+#define SCAN_token      3   /* document_pos is at the start of an incomplete token */
+
 typedef struct
 {
     cfx2_RdOpt* rd_opt;
 
     /* keep this here for better cache utilization */
-    char* document;
+    const char* document;
     size_t document_len, document_pos;
 
     unsigned line;
-    char queued_char;
+
+    /* incremental input; input_final is set once no more data will follow */
+    int input_final;
+    int scan_state;
+    unsigned short scan_indent;
+    size_t scan_pos;
 
     Token current_token;
 
@@ -83,6 +104,8 @@ typedef struct
 Lexer;
 
 int create_lexer( Lexer* lexer, cfx2_RdOpt* rd_opt );
+void lexer_set_input( Lexer* lexer, const char* document, size_t document_len, int input_final );
+void lexer_rebase( Lexer* lexer, size_t offset );
 int lexer_read( Lexer* lexer, Token** token_out );
 int lexer_get_current( Lexer* lexer, Token** token_out );
 int lexer_token_is( Lexer* lexer, int token_type );
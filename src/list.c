@@ -21,6 +21,8 @@
     distribution.
 */
 
+#include "alloc.h"
+#include "arena.h"
 #include "config.h"
 #include "list.h"
 
@@ -54,55 +56,122 @@ static size_t round_up_to_power_of_2( size_t v )
     return v;
 }
 
-static int ensure_can_add( cfx2_List* list, itemsize_t itemsize )
+#define is_local( list_ )  ( ( list_ )->items == ( list_ )->local.bytes )
+
+static int ensure_can_add( cfx2_List* list, itemsize_t itemsize, size_t count, cfx2_Arena* arena )
 {
-    size_t capacity, new_capacity;
+    size_t new_capacity;
+    cfx2_uint8_t* items;
 
-    capacity = round_up_to_power_of_2( list->length * itemsize );
-    new_capacity = round_up_to_power_of_2( ( list->length + 1 ) * itemsize );
-    
-    if ( new_capacity > capacity )
-        list->items = ( cfx2_uint8_t* )realloc( list->items, new_capacity );
+    if ( ( list->length + count ) * itemsize <= list->capacity )
+        return 1;
+
+    new_capacity = round_up_to_power_of_2( ( list->length + count ) * itemsize );
+
+    if ( arena != NULL )
+    {
+        /* arena memory can't be resized; the old block is left to the arena */
+        items = ( cfx2_uint8_t* )cfx2_arena_alloc( arena, new_capacity );
+    }
+    else if ( is_local( list ) )
+        items = ( cfx2_uint8_t* )libcfx2_malloc( new_capacity, cfx2_mem_list );
+    else
+        items = ( cfx2_uint8_t* )libcfx2_realloc( list->items, new_capacity, cfx2_mem_list );
+
+    if ( items == NULL )
+        return 0;
 
-    return list->items != NULL;
+    /* moving out of the local storage (or to a new arena block) */
+    if ( ( arena != NULL || is_local( list ) ) && list->length > 0 )
+        memcpy( items, list->items, list->length * itemsize );
+
+    list->items = items;
+    list->capacity = new_capacity;
+    return 1;
 }
 
 int cfx2_list_init( cfx2_List* list )
 {
-    list->items = NULL;
+    list->items = list->local.bytes;
     list->length = 0;
+    list->capacity = sizeof( list->local.bytes );
 
     return 0;
 }
 
 void cfx2_list_release( cfx2_List* list )
 {
-    libcfx2_free( list->items );
+    if ( !is_local( list ) )
+        libcfx2_free( list->items );
 }
 
-cfx2_uint8_t* cfx2_list_add_item( cfx2_List* list, itemsize_t itemsize )
+void cfx2_list_shrink( cfx2_List* list, itemsize_t itemsize )
+{
+    cfx2_uint8_t* items;
+
+    if ( is_local( list ) || list->length * itemsize == list->capacity )
+        return;
+
+    /* back into the local storage if it fits */
+    if ( list->length * itemsize <= sizeof( list->local.bytes ) )
+    {
+        items = list->items;
+        memcpy( list->local.bytes, items, list->length * itemsize );
+
+        list->items = list->local.bytes;
+        list->capacity = sizeof( list->local.bytes );
+
+        libcfx2_free( items );
+        return;
+    }
+
+    /* if even that fails, the list just stays as it was */
+    items = ( cfx2_uint8_t* )libcfx2_realloc( list->items, list->length * itemsize, cfx2_mem_list );
+
+    if ( items != NULL )
+    {
+        list->items = items;
+        list->capacity = list->length * itemsize;
+    }
+}
+
+cfx2_uint8_t* cfx2_list_add_item( cfx2_List* list, itemsize_t itemsize, cfx2_Arena* arena )
 {
     cfx2_uint8_t* ret;
 
-    ensure_can_add( list, itemsize );
+    if ( !ensure_can_add( list, itemsize, 1, arena ) )
+        return NULL;
 
     ret = list->items + list->length * itemsize;
     list->length++;
     return ret;
 }
 
-cfx2_uint8_t* cfx2_list_insert_item( cfx2_List* list, itemsize_t itemsize, size_t index )
+cfx2_uint8_t* cfx2_list_add_items( cfx2_List* list, itemsize_t itemsize, size_t count, cfx2_Arena* arena )
+{
+    cfx2_uint8_t* ret;
+
+    if ( !ensure_can_add( list, itemsize, count, arena ) )
+        return NULL;
+
+    ret = list->items + list->length * itemsize;
+    list->length += count;
+    return ret;
+}
+
+cfx2_uint8_t* cfx2_list_insert_item( cfx2_List* list, itemsize_t itemsize, size_t index, cfx2_Arena* arena )
 {
     cfx2_uint8_t* ret;
     
     if ( index > list->length )
         index = list->length;
 
-    ensure_can_add( list, itemsize );
+    if ( !ensure_can_add( list, itemsize, 1, arena ) )
+        return NULL;
 
     memmove( list->items + ( index + 1 ) * itemsize, list->items + index * itemsize, ( list->length - index ) * itemsize );
     
-    ret = list->items + list->length * itemsize;
+    ret = list->items + index * itemsize;
     list->length++;
     return ret;
 }
@@ -31,8 +31,13 @@ typedef unsigned int itemsize_t;
 int cfx2_list_init( cfx2_List* list );
 void cfx2_list_release( cfx2_List* list );
 
-cfx2_uint8_t* cfx2_list_add_item( cfx2_List* list, itemsize_t itemsize );
-cfx2_uint8_t* cfx2_list_insert_item( cfx2_List* list, itemsize_t itemsize, size_t index );
+/* frees the unused capacity of a heap list */
+void cfx2_list_shrink( cfx2_List* list, itemsize_t itemsize );
+
+/* with an arena, the items are allocated from it and must not be released */
+cfx2_uint8_t* cfx2_list_add_item( cfx2_List* list, itemsize_t itemsize, cfx2_Arena* arena );
+cfx2_uint8_t* cfx2_list_add_items( cfx2_List* list, itemsize_t itemsize, size_t count, cfx2_Arena* arena );
+cfx2_uint8_t* cfx2_list_insert_item( cfx2_List* list, itemsize_t itemsize, size_t index, cfx2_Arena* arena );
 int cfx2_list_remove_at_index( cfx2_List* list, itemsize_t itemsize, size_t index );
 int cfx2_list_remove_item( cfx2_List* list, itemsize_t itemsize, void* item );
 
@@ -21,8 +21,11 @@
     distribution.
 */
 
+#include "alloc.h"
+#include "arena.h"
 #include "attrib.h"
 #include "config.h"
+#include "index.h"
 #include "list.h"
 #include "node.h"
 
@@ -56,29 +59,6 @@ static size_t round_up_to_power_of_2( size_t v )
     return v;
 }
 
-static void fixup_attrib( cfx2_Attrib* attr, char* min, char* max, ptrdiff_t buf_diff )
-{
-    if ( attr->name >= min && attr->name <= max )
-        attr->name += buf_diff;
-
-    if ( attr->value >= min && attr->value <= max )
-        attr->value += buf_diff;
-}
-
-static void fixup_node( cfx2_Node* node, char* min, char* max, ptrdiff_t buf_diff )
-{
-    size_t i;
-
-    if ( node->name >= min && node->name <= max )
-        node->name += buf_diff;
-
-    if ( node->text >= min && node->text <= max )
-        node->text += buf_diff;
-
-    for ( i = 0; i < cfx2_list_length( node->attributes ); i++ )
-        fixup_attrib( &cfx2_item( node->attributes, i, cfx2_Attrib ), min, max, buf_diff );
-}
-
 static int release_node( cfx2_Node* node )
 {
     unsigned i;
@@ -86,11 +66,23 @@ static int release_node( cfx2_Node* node )
     if ( !node )
         return cfx2_param_invalid;
 
+    /* arena nodes go away all at once, together with the document root */
+    if ( node->arena != NULL )
+    {
+        if ( node->arena->root == node )
+            cfx2_arena_release( node->arena );
+
+        return cfx2_ok;
+    }
+
     for ( i = 0; i < cfx2_list_length( node->attributes ); i++ )
         cfx2_attrib_release( &cfx2_item( node->attributes, i, cfx2_Attrib ) );
 
+    cfx2_drop_attrib_index( node );
     cfx2_list_release( &node->attributes );
 
+    cfx2_drop_child_index( node );
+
     for ( i = 0; i < cfx2_list_length( node->children ); i++ )
         release_node( cfx2_item( node->children, i, cfx2_Node* ) );
 
@@ -100,13 +92,49 @@ static int release_node( cfx2_Node* node )
         cfx2_sfree( node->text );
 
     cfx2_sfree( node->name );
-    
-    libcfx2_free( node->shared );
+
+    while ( node->shared != NULL )
+    {
+        char* next;
+
+        next = ( char* )( ( SharedHeader_t* )node->shared )->next;
+        libcfx2_free( node->shared );
+        node->shared = next;
+    }
+
     libcfx2_free( node );
 
     return cfx2_ok;
 }
 
+int cfx2_add_shared_chunk( cfx2_Node* node, size_t capacity )
+{
+    SharedHeader_t* sh;
+
+    sh = ( SharedHeader_t* )libcfx2_malloc( sizeof( SharedHeader_t ) + capacity, cfx2_mem_string );
+
+    if ( sh == NULL )
+        return cfx2_alloc_error;
+
+    sh->next = ( SharedHeader_t* )node->shared;
+    sh->capacity = capacity;
+    sh->used = 0;
+
+    node->shared = ( char* )sh;
+    return cfx2_ok;
+}
+
+int cfx2_shared_contains( const cfx2_Node* node, const char* string )
+{
+    const SharedHeader_t* sh;
+
+    for ( sh = ( const SharedHeader_t* )node->shared; sh != NULL; sh = sh->next )
+        if ( string >= shared_data( sh ) && string < shared_data( sh ) + sh->used )
+            return 1;
+
+    return 0;
+}
+
 int cfx2_alloc_shared( char** ptr, cfx2_Node* node, size_t size )
 {
     SharedHeader_t* sh;
@@ -117,11 +145,13 @@ int cfx2_alloc_shared( char** ptr, cfx2_Node* node, size_t size )
             return rc;
     
     sh = ( SharedHeader_t* )node->shared;
-        
+    size = ( size + sizeof( s_nref_t ) - 1 ) & ~( sizeof( s_nref_t ) - 1 );
+    
+    /* a full buffer doesn't grow by itself; the string goes to the heap instead */
     if ( sh->used + size > sh->capacity )
         return cfx2_alloc_error;
 
-    *ptr = node->shared + sizeof( SharedHeader_t ) + sh->used;
+    *ptr = shared_data( sh ) + sh->used;
     sh->used += size;
     return 0;
 }
@@ -129,12 +159,25 @@ int cfx2_alloc_shared( char** ptr, cfx2_Node* node, size_t size )
 int cfx2_salloc( char** ptr, cfx2_Node* parent, cfx2_Node* node, size_t size,
                 const char* initdata, int flags )
 {
+    cfx2_Node* owner;
     char* chunk;
     
     chunk = NULL;
     size += sizeof( s_nref_t );
+
+    owner = ( parent != NULL ) ? parent : node;
     
-    if ( flags & cfx2_use_shared_buffer )
+    /* strings of arena nodes are never freed individually */
+    if ( owner != NULL && owner->arena != NULL )
+    {
+        chunk = ( char* )cfx2_arena_alloc( owner->arena, size );
+
+        if ( chunk == NULL )
+            return cfx2_alloc_error;
+
+        *( s_nref_t* )chunk = 0;
+    }
+    else if ( flags & cfx2_use_shared_buffer )
     {
         chunk = NULL;
         
@@ -149,7 +192,7 @@ int cfx2_salloc( char** ptr, cfx2_Node* parent, cfx2_Node* node, size_t size,
     
     if ( chunk == NULL )
     {
-        chunk = ( char* ) libcfx2_malloc( size );
+        chunk = ( char* ) libcfx2_malloc( size, cfx2_mem_string );
         
         if ( chunk == NULL )
             return cfx2_alloc_error;
@@ -181,11 +224,14 @@ void cfx2_sfree( char* chunk )
         libcfx2_free( chunk );
 }
 
-libcfx2 int cfx2_create_node( cfx2_Node** node_ptr )
+int cfx2_create_arena_node( cfx2_Node** node_ptr, cfx2_Arena* arena )
 {
     cfx2_Node* node;
 
-    node = ( cfx2_Node* )libcfx2_malloc( sizeof( cfx2_Node ) );
+    if ( arena != NULL )
+        node = ( cfx2_Node* )cfx2_arena_alloc( arena, sizeof( cfx2_Node ) );
+    else
+        node = ( cfx2_Node* )libcfx2_malloc( sizeof( cfx2_Node ), cfx2_mem_node );
 
     if ( !node )
         return cfx2_alloc_error;
@@ -197,11 +243,21 @@ libcfx2 int cfx2_create_node( cfx2_Node** node_ptr )
     cfx2_list_init( &node->attributes );
 
     node->shared = NULL;
+    node->arena = arena;
+
+    node->child_index = NULL;
+    node->attrib_index = NULL;
+    node->index_parent = NULL;
     
     *node_ptr = node;
     return cfx2_ok;
 }
 
+libcfx2 int cfx2_create_node( cfx2_Node** node_ptr )
+{
+    return cfx2_create_arena_node( node_ptr, NULL );
+}
+
 libcfx2 cfx2_Node* cfx2_new_node( const char* name )
 {
     cfx2_Node* node;
@@ -224,60 +280,53 @@ libcfx2 void cfx2_release_node( cfx2_Node** node_ptr )
 libcfx2 int cfx2_preallocate_shared_buffer( cfx2_Node* node, size_t size, int flags )
 {
     SharedHeader_t* sh;
-    char* new_shared;
     size_t capacity;
 
-    if ( node->shared != NULL )
-    {
-        sh = ( SharedHeader_t* )node->shared;
+    /* arena nodes keep their strings in the arena */
+    if ( node->arena != NULL )
+        return cfx2_ok;
 
-        if ( size < sh->capacity )
-            return cfx2_param_invalid;
-    }
+    sh = ( SharedHeader_t* )node->shared;
+
+    /* Enough room already? */
+    if ( sh != NULL && sh->capacity - sh->used >= size )
+        return cfx2_ok;
 
     if ( size < 16 )
         capacity = 16;
     else
         capacity = round_up_to_power_of_2( size );
-        
-    new_shared = ( char* )libcfx2_malloc( sizeof( SharedHeader_t ) + capacity );
-        
-    if ( new_shared == NULL )
-        return cfx2_alloc_error;
-        
-    if ( node->shared != NULL )
-    {
-        ptrdiff_t buf_diff;
-
-        memcpy( new_shared, node->shared, sizeof( SharedHeader_t ) + sh->used );
-
-        buf_diff = new_shared - node->shared;
-        fixup_node( node, node->shared, node->shared + sh->capacity, buf_diff );
 
-        libcfx2_free( node->shared );
-    }
-
-    node->shared = new_shared;
-
-    sh = ( SharedHeader_t* )new_shared;
-    sh->capacity = capacity;
-    sh->used = 0;
-
-    return 0;
+    /* existing strings stay where they are */
+    return cfx2_add_shared_chunk( node, capacity );
 }
 
 libcfx2 int cfx2_rename_node( cfx2_Node* node, const char* name )
 {
+    cfx2_Node* parent;
+    int rc;
+
+    /* the parent's child index is keyed by name */
+    parent = node->index_parent;
+
+    if ( parent != NULL )
+        cfx2_index_remove( parent, node );
+
     if ( node->name != NULL )
     {
         cfx2_sfree( node->name );
         node->name = NULL;
     }
 
+    rc = cfx2_ok;
+
     if ( name != NULL )
-        return cfx2_salloc( &node->name, NULL, node, strlen( name ) + 1, name, cfx2_use_shared_buffer );
+        rc = cfx2_salloc( &node->name, NULL, node, strlen( name ) + 1, name, cfx2_use_shared_buffer );
 
-    return cfx2_ok;
+    if ( parent != NULL )
+        cfx2_index_add( parent, node );
+
+    return rc;
 }
 
 libcfx2 int cfx2_set_node_text( cfx2_Node* node, const char* text )
@@ -318,7 +367,7 @@ libcfx2 cfx2_Node* cfx2_clone_node( cfx2_Node* node, int flags )
     {
         cfx2_Attrib* attrib;
 
-        attrib = cfx2_item( node->attributes, i, cfx2_Attrib* );
+        attrib = &cfx2_item( node->attributes, i, cfx2_Attrib );
 
         cfx2_set_node_attrib( clone, attrib->name, attrib->value );
     }
@@ -30,15 +30,33 @@ typedef unsigned int s_nref_t;
 
 typedef struct SharedHeader_t SharedHeader_t;
 
+/*
+ *  A node's shared buffer is a chain of chunks, the newest first.
+ *  Strings are never moved once written, so chunks are only ever added.
+ */
 struct SharedHeader_t
 {
-    size_t capacity, used;
+    SharedHeader_t* next;       /* previous (full) chunk */
+    size_t capacity, used;      /* in bytes, not counting the header */
 };
 
+#define shared_data( sh_ )  ( ( char* )( sh_ ) + sizeof( SharedHeader_t ) )
+
+/* space taken by a string of length_ bytes (incl. the terminator), keeping s_nref_t aligned */
+#define shared_size( length_ )\
+        ( ( sizeof( s_nref_t ) + ( length_ ) + sizeof( s_nref_t ) - 1 ) & ~( sizeof( s_nref_t ) - 1 ) )
+
 int cfx2_salloc( char** ptr, cfx2_Node* parent, cfx2_Node* node, size_t size,
         const char* initdata, int flags );
 void cfx2_sfree( char* chunk );
 
 int cfx2_alloc_shared( char** ptr, cfx2_Node* node, size_t size );
+int cfx2_add_shared_chunk( cfx2_Node* node, size_t capacity );
+int cfx2_shared_contains( const cfx2_Node* node, const char* string );
+
+int cfx2_create_arena_node( cfx2_Node** node_ptr, cfx2_Arena* arena );
+
+/* hash is cfx2_hash_name( name ) */
+cfx2_Node* cfx2_find_child_hashed( cfx2_Node* parent, const char* name, size_t hash );
 
 #endif
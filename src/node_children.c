@@ -21,6 +21,9 @@
     distribution.
 */
 
+#include "arena.h"
+#include "config.h"
+#include "index.h"
 #include "list.h"
 #include "node.h"
 
@@ -29,16 +32,30 @@
 #include <stdlib.h>
 #include <string.h>
 
-static int belongs_to( const char* string, cfx2_Node* owner )
+/*
+ *  A node from elsewhere added to an arena document is released with the document.
+ *  Arena nodes can't outlive theirs, so they only move within it.
+ */
+static int adopt( cfx2_Node* parent, cfx2_Node* child )
 {
-    return string >= owner->shared
-            && owner->shared != NULL
-            && string < owner->shared + ( ( SharedHeader_t* )owner->shared )->capacity;
+    if ( child->arena != NULL && child->arena != parent->arena )
+        return cfx2_param_invalid;
+
+    if ( parent->arena != NULL && child->arena != parent->arena )
+        return cfx2_arena_adopt( parent->arena, child );
+
+    return cfx2_ok;
+}
+
+static void disown( cfx2_Node* parent, cfx2_Node* child )
+{
+    if ( parent->arena != NULL && child->arena != parent->arena )
+        cfx2_arena_disown( parent->arena, child );
 }
 
 static int free_from_possible_owner( char** string, cfx2_Node* owner )
 {
-    if ( belongs_to( *string, owner ) )
+    if ( *string != NULL && cfx2_shared_contains( owner, *string ) )
         return cfx2_salloc( string, NULL, NULL, strlen( *string ) + 1, *string, 0 );
     else
         return 0;
@@ -47,26 +64,42 @@ static int free_from_possible_owner( char** string, cfx2_Node* owner )
 libcfx2 int cfx2_add_child( cfx2_Node* parent, cfx2_Node* child )
 {
     cfx2_Node** p_child;
+    int rc;
+
+    if ( ( rc = adopt( parent, child ) ) != cfx2_ok )
+        return rc;
 
-    p_child = ( cfx2_Node** )cfx2_list_add_item( &parent->children, sizeof( cfx2_Node* ) );
+    p_child = ( cfx2_Node** )cfx2_list_add_item( &parent->children, sizeof( cfx2_Node* ), parent->arena );
     
     if ( p_child == NULL )
+    {
+        disown( parent, child );
         return cfx2_alloc_error;
+    }
 
     *p_child = child;
+    cfx2_index_add( parent, child );
     return cfx2_ok;
 }
 
 libcfx2 int cfx2_insert_child( cfx2_Node* parent, size_t index, cfx2_Node* child )
 {
     cfx2_Node** p_child;
+    int rc;
 
-    p_child = ( cfx2_Node** )cfx2_list_insert_item( &parent->children, sizeof( cfx2_Node* ), index );
+    if ( ( rc = adopt( parent, child ) ) != cfx2_ok )
+        return rc;
+
+    p_child = ( cfx2_Node** )cfx2_list_insert_item( &parent->children, sizeof( cfx2_Node* ), index, parent->arena );
     
     if ( p_child == NULL )
+    {
+        disown( parent, child );
         return cfx2_alloc_error;
+    }
 
     *p_child = child;
+    cfx2_index_add( parent, child );
     return cfx2_ok;
 }
 
@@ -84,8 +117,15 @@ libcfx2 cfx2_Node* cfx2_create_child( cfx2_Node* parent, const char* name, const
 
     if ( child == NULL )
     {
-        child = cfx2_new_node( name );
-        cfx2_add_child( parent, child );
+        /* children of arena nodes are created in the same arena */
+        if ( cfx2_create_arena_node( &child, parent->arena ) != cfx2_ok )
+            return NULL;
+
+        if ( cfx2_rename_node( child, name ) != cfx2_ok || cfx2_add_child( parent, child ) != cfx2_ok )
+        {
+            cfx2_release_node( &child );
+            return NULL;
+        }
     }
 
     if ( text != NULL )
@@ -94,7 +134,7 @@ libcfx2 cfx2_Node* cfx2_create_child( cfx2_Node* parent, const char* name, const
     return child;
 }
 
-libcfx2 cfx2_Node* cfx2_find_child( cfx2_Node* parent, const char* name )
+static cfx2_Node* scan_children( cfx2_Node* parent, const char* name )
 {
     size_t i;
 
@@ -105,6 +145,22 @@ libcfx2 cfx2_Node* cfx2_find_child( cfx2_Node* parent, const char* name )
     return NULL;
 }
 
+cfx2_Node* cfx2_find_child_hashed( cfx2_Node* parent, const char* name, size_t hash )
+{
+    if ( parent->child_index != NULL )
+        return cfx2_index_find( parent->child_index, name, hash );
+
+    return scan_children( parent, name );
+}
+
+libcfx2 cfx2_Node* cfx2_find_child( cfx2_Node* parent, const char* name )
+{
+    if ( parent->child_index != NULL )
+        return cfx2_index_find( parent->child_index, name, cfx2_hash_name( name ) );
+
+    return scan_children( parent, name );
+}
+
 libcfx2 cfx2_Node* cfx2_find_child_by_test( cfx2_Node* parent, cfx2_FindTest test, void* user )
 {
     size_t i;
@@ -132,6 +188,17 @@ libcfx2 int cfx2_remove_child( cfx2_Node* parent, cfx2_Node* child )
     int rc;
     size_t i;
 
+    if ( parent->arena != NULL )
+    {
+        /* strings in the arena stay valid as long as the document does */
+        if ( !cfx2_list_remove_item( &parent->children, sizeof( cfx2_Node* ), &child ) )
+            return cfx2_node_not_found;
+
+        cfx2_index_remove( parent, child );
+        disown( parent, child );
+        return cfx2_ok;
+    }
+
     if ( ( rc = free_from_possible_owner( &child->name, parent ) ) != 0 )
         return rc;
 
@@ -147,8 +214,9 @@ libcfx2 int cfx2_remove_child( cfx2_Node* parent, cfx2_Node* child )
             return rc;
     }
 
-    if ( cfx2_list_remove_item( &parent->children, sizeof( cfx2_Node* ), &child ) )
-        return cfx2_ok;
-    else
+    if ( !cfx2_list_remove_item( &parent->children, sizeof( cfx2_Node* ), &child ) )
         return cfx2_node_not_found;
+
+    cfx2_index_remove( parent, child );
+    return cfx2_ok;
 }
@@ -1,6 +1,7 @@
-
+#include "alloc.h"
 #include "attrib.h"
 #include "config.h"
+#include "index.h"
 #include "lexer.h"
 #include "list.h"
 #include "node.h"
@@ -9,168 +10,1236 @@
 #include <stdlib.h>
 #include <string.h>
 
-/* TODO: this could really use some documentation because of the function's recursiveness */
+/*
+ *  A query is compiled into a plan before it's run:
+ *      node/node/node      - node steps (empty names keep the current node)
+ *      .attrib             - an optional attribute step
+ *      :value              - an optional value to set (with allow_modifications)
+ *  Names are split out and hashed at compile time; "%s" steps are parameters.
+ *
+ *  Patterns: a node step may be "*" (any child) or "**" (the node itself and all
+ *  its descendants), and any node step may be followed by predicates on attributes,
+ *  "[name]" (present) or "[name=value]". Queries with patterns can match any number
+ *  of nodes; cfx2_QueryIter goes through them in document order.
+ */
+
+typedef struct QueryStep_t QueryStep_t;
+typedef struct QueryPredicate_t QueryPredicate_t;
 
-static cfx2_ResultType attrib_process_command( cfx2_Node* base, const char* command,
-        char* buffer, int allow_modifications, void** output )
+/* kinds of node steps */
+#define STEP_NAME           0
+#define STEP_ANY            1
+#define STEP_DESCENDANTS    2
+#define STEP_SELF           3
+
+struct QueryStep_t
 {
-    unsigned pos = 0;
-    cfx2_Attrib* attrib;
+    const char* name;
+    size_t hash;
+    int param;                  /* parameter index or -1 */
+
+    int kind;
+    size_t first_predicate, num_predicates;
+};
+
+struct QueryPredicate_t
+{
+    QueryStep_t attrib;
+    QueryStep_t value;          /* name is NULL (and param -1) if only presence is tested */
+};
+
+struct cfx2_Query
+{
+    const char* command;
+
+    size_t num_steps;
+    QueryStep_t* steps;
+
+    size_t num_predicates;
+    QueryPredicate_t* predicates;
+
+    int has_attrib, has_value;
+    QueryStep_t attrib, value;
+
+    int num_params;
+    int has_patterns;
+};
+
+struct cfx2_QueryIter
+{
+    cfx2_Query* owned_query;    /* compiled by cfx2_query_all */
+    const cfx2_Query* query;
+    const char* const* params;
 
-    /* Read an identifier form the command string. */
-    while ( is_ident_char( *command ) )
-        buffer[pos++] = *( command++ );
+    /* nodes left to expand, innermost last */
+    size_t depth, max_depth;
+    struct IterFrame_t* frames;
+};
+
+typedef struct IterFrame_t IterFrame_t;
+
+struct IterFrame_t
+{
+    cfx2_Node* node;
+    size_t step;                /* the step to match below node */
+    size_t next_child;
+    int self_done;              /* "**": node itself was tried */
+};
+
+/* Batches merge their queries' node steps into a trie; leaves are the values asked for */
+#define TRIE_NONE ( ( size_t ) -1 )
+
+typedef struct TrieNode_t TrieNode_t;
+typedef struct TrieLeaf_t TrieLeaf_t;
+
+struct TrieNode_t
+{
+    const QueryStep_t* step;    /* NULL for the root */
+    size_t first_child, next_sibling, first_leaf;
+};
+
+struct TrieLeaf_t
+{
+    const QueryStep_t* attrib;  /* NULL for the node's text */
+    size_t slot, next;
+};
+
+struct cfx2_QueryBatch
+{
+    size_t count;
+    cfx2_Query** queries;
+
+    cfx2_List nodes, leaves;
+};
+
+struct cfx2_QueryCache
+{
+    size_t capacity, count;
 
-    buffer[pos] = 0;
+    /* most recently used first */
+    cfx2_Query** queries;
+    size_t* hashes;
+};
 
-    switch ( *command )
+/* -------------------------------------------------------------------------- */
+/*  Compilation                                                               */
+/* -------------------------------------------------------------------------- */
+
+typedef struct
+{
+    const char* command;
+    char* strings;
+    int with_params;
+    int num_params;
+}
+Compiler;
+
+static char* copy_string( Compiler* compiler, const char* str, size_t length )
+{
+    char* copy;
+
+    copy = compiler->strings;
+    memcpy( copy, str, length );
+    copy[length] = 0;
+
+    compiler->strings += length + 1;
+    return copy;
+}
+
+static void init_step( QueryStep_t* step )
+{
+    step->name = NULL;
+    step->hash = 0;
+    step->param = -1;
+
+    step->kind = STEP_NAME;
+    step->first_predicate = 0;
+    step->num_predicates = 0;
+}
+
+/* Reads a name (or a parameter) and leaves command at the character after it */
+static void compile_name( Compiler* compiler, QueryStep_t* step )
+{
+    const char* start;
+
+    init_step( step );
+    start = compiler->command;
+
+    if ( compiler->with_params && start[0] == '%' && start[1] == 's' )
     {
-        case 0:
-        case ':':
-        case '/':
-        case '.':
-            break;
+        compiler->command += 2;
+        step->param = compiler->num_params++;
+        return;
+    }
 
-        default:
-            return cfx2_fail;
+    while ( is_ident_char( *compiler->command ) )
+        compiler->command++;
+
+    step->name = copy_string( compiler, start, compiler->command - start );
+    step->hash = cfx2_hash_name( step->name );
+}
+
+/* Reads a value up to (not including) any of the terminators */
+static void compile_value( Compiler* compiler, QueryStep_t* step, const char* terminators )
+{
+    size_t length;
+
+    init_step( step );
+    length = strcspn( compiler->command, terminators );
+
+    if ( compiler->with_params && length == 2 && compiler->command[0] == '%' && compiler->command[1] == 's' )
+        step->param = compiler->num_params++;
+    else
+        step->name = copy_string( compiler, compiler->command, length );
+
+    compiler->command += length;
+}
+
+static int compile_predicates( Compiler* compiler, cfx2_Query* query, QueryStep_t* step )
+{
+    QueryPredicate_t* predicate;
+
+    step->first_predicate = query->num_predicates;
+
+    while ( *compiler->command == '[' )
+    {
+        compiler->command++;
+
+        predicate = &query->predicates[query->num_predicates++];
+        compile_name( compiler, &predicate->attrib );
+
+        if ( predicate->attrib.name != NULL && predicate->attrib.name[0] == 0 )
+            return cfx2_syntax_error;
+
+        if ( *compiler->command == '=' )
+        {
+            compiler->command++;
+            compile_value( compiler, &predicate->value, "]" );
+        }
+        else
+            init_step( &predicate->value );
+
+        if ( *compiler->command != ']' )
+            return cfx2_syntax_error;
+
+        compiler->command++;
+        step->num_predicates++;
     }
 
-    attrib = cfx2_find_attrib( base, buffer );
+    if ( step->num_predicates > 0 )
+        query->has_patterns = 1;
+
+    return cfx2_ok;
+}
 
-    if ( !attrib )
+static int compile_step( Compiler* compiler, cfx2_Query* query, QueryStep_t* step )
+{
+    if ( compiler->command[0] == '*' )
     {
-        if ( allow_modifications )
+        init_step( step );
+
+        if ( compiler->command[1] == '*' )
         {
-            int rc;
-            
-            rc = cfx2_attrib_new( &attrib, base );
-            
-            if ( rc != 0 )
-                return cfx2_fail;
-            
-            rc = cfx2_salloc( &attrib->name, base, NULL, strlen( buffer ) + 1, buffer, cfx2_use_shared_buffer );
-            
-            if ( rc != 0 )
-                return rc;
+            step->kind = STEP_DESCENDANTS;
+            compiler->command += 2;
         }
         else
-            return cfx2_fail;
+        {
+            step->kind = STEP_ANY;
+            compiler->command++;
+        }
+
+        query->has_patterns = 1;
     }
+    else
+        compile_name( compiler, step );
+
+    return compile_predicates( compiler, query, step );
+}
+
+static int compile_query( cfx2_Query** query_ptr, const char* command, int with_params )
+{
+    cfx2_Query* query;
+    Compiler compiler;
+    size_t length, max_steps, max_predicates;
+    const char* p;
+
+    length = strlen( command );
+    max_steps = 1;
+    max_predicates = 0;
 
-    if ( *command == 0 )
+    for ( p = command; *p != 0; p++ )
+        if ( *p == '/' )
+            max_steps++;
+        else if ( *p == '[' )
+            max_predicates++;
+
+    /* the plan, its steps, predicates and all its strings in one block */
+    query = ( cfx2_Query* )libcfx2_malloc( sizeof( cfx2_Query ) + max_steps * sizeof( QueryStep_t )
+            + max_predicates * sizeof( QueryPredicate_t ) + 2 * ( length + 1 ) + max_steps + 2 * max_predicates + 2,
+            cfx2_mem_query );
+
+    if ( query == NULL )
+        return cfx2_alloc_error;
+
+    query->steps = ( QueryStep_t* )( query + 1 );
+    query->num_steps = 0;
+    query->predicates = ( QueryPredicate_t* )( query->steps + max_steps );
+    query->num_predicates = 0;
+    query->has_attrib = 0;
+    query->has_value = 0;
+    query->has_patterns = 0;
+
+    compiler.command = command;
+    compiler.strings = ( char* )( query->predicates + max_predicates );
+    compiler.with_params = with_params;
+    compiler.num_params = 0;
+
+    query->command = copy_string( &compiler, command, length );
+
+    for ( ; ; )
     {
-        if ( output )
+        QueryStep_t* step;
+
+        step = &query->steps[query->num_steps];
+
+        if ( compile_step( &compiler, query, step ) != cfx2_ok )
+        {
+            libcfx2_free( query );
+            return cfx2_syntax_error;
+        }
+
+        /* an empty name stays at the same node */
+        if ( step->kind != STEP_NAME || step->param >= 0 || step->name[0] != 0 )
+            query->num_steps++;
+        else if ( step->num_predicates > 0 )
         {
-            *output = ( void* )attrib;
-            return cfx2_attrib;
+            /* ...but predicates still apply to it */
+            step->kind = STEP_SELF;
+            query->num_steps++;
         }
+
+        if ( *compiler.command == '/' )
+            compiler.command++;
         else
-            return cfx2_void;
+            break;
+    }
+
+    if ( *compiler.command == '.' )
+    {
+        compiler.command++;
+
+        query->has_attrib = 1;
+        compile_name( &compiler, &query->attrib );
+    }
+
+    if ( *compiler.command == ':' )
+    {
+        compiler.command++;
+
+        query->has_value = 1;
+        compile_value( &compiler, &query->value, "" );
+    }
+    else if ( *compiler.command != 0 )
+    {
+        libcfx2_free( query );
+        return cfx2_syntax_error;
+    }
+
+    query->num_params = compiler.num_params;
+
+    *query_ptr = query;
+    return cfx2_ok;
+}
+
+libcfx2 int cfx2_compile_query( cfx2_Query** query_ptr, const char* command )
+{
+    if ( query_ptr == NULL || command == NULL )
+        return cfx2_param_invalid;
+
+    return compile_query( query_ptr, command, 1 );
+}
+
+libcfx2 void cfx2_release_query( cfx2_Query** query_ptr )
+{
+    libcfx2_free( *query_ptr );
+    *query_ptr = NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Execution                                                                 */
+/* -------------------------------------------------------------------------- */
+
+static const char* step_name( const QueryStep_t* step, const char* const* params, size_t* hash )
+{
+    if ( step->param < 0 )
+    {
+        *hash = step->hash;
+        return step->name;
     }
-    else if ( *command == ':' && allow_modifications )
+
+    if ( params[step->param] == NULL )
+        return NULL;
+
+    *hash = cfx2_hash_name( params[step->param] );
+    return params[step->param];
+}
+
+static cfx2_Attrib* query_attrib( cfx2_Node* node, const char* name, size_t hash, int allow_modifications )
+{
+    cfx2_Attrib* attrib;
+
+    attrib = cfx2_find_attrib_hashed( node, name, hash );
+
+    /*
+        The requested attribute does not exist.
+        We'll try to create it then (without a value).
+    */
+
+    if ( attrib == NULL && allow_modifications )
+    {
+        if ( cfx2_attrib_new( &attrib, node ) != cfx2_ok )
+            return NULL;
+
+        if ( cfx2_salloc( &attrib->name, node, NULL, strlen( name ) + 1, name, cfx2_use_shared_buffer ) != cfx2_ok )
+            return NULL;
+
+        cfx2_attrib_index_add( node, cfx2_list_length( node->attributes ) - 1 );
+    }
+
+    return attrib;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Pattern Matching                                                          */
+/* -------------------------------------------------------------------------- */
+
+static int match_predicates( const cfx2_Query* query, const QueryStep_t* step, const char* const* params, cfx2_Node* node )
+{
+    const QueryPredicate_t* predicate;
+    cfx2_Attrib* attrib;
+    const char* name, * value;
+    size_t i, hash;
+
+    for ( i = 0; i < step->num_predicates; i++ )
+    {
+        predicate = &query->predicates[step->first_predicate + i];
+
+        if ( ( name = step_name( &predicate->attrib, params, &hash ) ) == NULL
+                || ( attrib = cfx2_find_attrib_hashed( node, name, hash ) ) == NULL )
+            return 0;
+
+        value = ( predicate->value.param >= 0 ) ? params[predicate->value.param] : predicate->value.name;
+
+        if ( value != NULL && ( attrib->value == NULL || strcmp( attrib->value, value ) != 0 ) )
+            return 0;
+    }
+
+    return 1;
+}
+
+static int iter_push( cfx2_QueryIter* iter, cfx2_Node* node, size_t step )
+{
+    IterFrame_t* frame;
+
+    if ( iter->depth == iter->max_depth )
+    {
+        frame = ( IterFrame_t* )libcfx2_realloc( iter->frames, iter->max_depth * 2 * sizeof( IterFrame_t ), cfx2_mem_query );
+
+        if ( frame == NULL )
+            return cfx2_alloc_error;
+
+        iter->frames = frame;
+        iter->max_depth *= 2;
+    }
+
+    frame = &iter->frames[iter->depth++];
+    frame->node = node;
+    frame->step = step;
+    frame->next_child = 0;
+    frame->self_done = 0;
+    return cfx2_ok;
+}
+
+static int iter_start( cfx2_QueryIter* iter, const cfx2_Query* query, cfx2_Node* base, const char* const* params )
+{
+    iter->owned_query = NULL;
+    iter->query = query;
+    iter->params = params;
+
+    iter->depth = 0;
+    iter->max_depth = 16;
+    iter->frames = ( IterFrame_t* )libcfx2_malloc( iter->max_depth * sizeof( IterFrame_t ), cfx2_mem_query );
+
+    if ( iter->frames == NULL )
+        return cfx2_alloc_error;
+
+    return iter_push( iter, base, 0 );
+}
+
+/*
+ *  Depth-first, so matches come in document order. A frame tries its node's children
+ *  against its step one at a time; matching children get frames for the next step.
+ */
+static cfx2_ResultType iter_next( cfx2_QueryIter* iter, void** output )
+{
+    const cfx2_Query* query;
+    const QueryStep_t* step;
+    IterFrame_t* frame;
+    cfx2_Node* node;
+    cfx2_Attrib* attrib;
+    const char* name;
+    size_t k, hash;
+    int rc;
+
+    query = iter->query;
+
+    while ( iter->depth > 0 )
     {
-        cfx2_attrib_set_value( attrib, command + 1 );
+        frame = &iter->frames[iter->depth - 1];
+        node = frame->node;
+        k = frame->step;
 
-        if ( output )
+        /* all steps matched */
+        if ( k == query->num_steps )
         {
-            *output = ( void* )attrib;
-            return cfx2_attrib;
+            iter->depth--;
+
+            if ( !query->has_attrib )
+            {
+                *output = ( void* )node;
+                return cfx2_node;
+            }
+
+            if ( ( name = step_name( &query->attrib, iter->params, &hash ) ) != NULL
+                    && ( attrib = cfx2_find_attrib_hashed( node, name, hash ) ) != NULL )
+            {
+                *output = ( void* )attrib;
+                return cfx2_attrib;
+            }
+
+            continue;
+        }
+
+        step = &query->steps[k];
+        rc = cfx2_ok;
+
+        if ( step->kind == STEP_SELF )
+        {
+            iter->depth--;
+
+            if ( match_predicates( query, step, iter->params, node ) )
+                rc = iter_push( iter, node, k + 1 );
+        }
+        else if ( step->kind == STEP_DESCENDANTS && !frame->self_done )
+        {
+            frame->self_done = 1;
+
+            if ( match_predicates( query, step, iter->params, node ) )
+                rc = iter_push( iter, node, k + 1 );
         }
+        else if ( frame->next_child >= cfx2_list_length( node->children ) )
+            iter->depth--;
         else
-            return cfx2_void;
+        {
+            node = cfx2_item( node->children, frame->next_child++, cfx2_Node* );
+
+            if ( step->kind == STEP_DESCENDANTS )
+                rc = iter_push( iter, node, k );
+            else if ( step->kind == STEP_ANY )
+            {
+                if ( match_predicates( query, step, iter->params, node ) )
+                    rc = iter_push( iter, node, k + 1 );
+            }
+            else if ( ( name = step_name( step, iter->params, &hash ) ) != NULL
+                    && node->name != NULL && strcmp( node->name, name ) == 0
+                    && match_predicates( query, step, iter->params, node ) )
+                rc = iter_push( iter, node, k + 1 );
+        }
+
+        if ( rc != cfx2_ok )
+        {
+            iter->depth = 0;
+            return cfx2_fail;
+        }
     }
-    else
+
+    return cfx2_void;
+}
+
+/* The first match of a query with patterns */
+static cfx2_ResultType first_match( const cfx2_Query* query, cfx2_Node* base, const char* const* params, void** output )
+{
+    cfx2_QueryIter iter;
+    cfx2_ResultType type;
+    void* result;
+
+    /* no modifications through patterns */
+    if ( query->has_value || iter_start( &iter, query, base, params ) != cfx2_ok )
+        return cfx2_fail;
+
+    type = iter_next( &iter, &result );
+    libcfx2_free( iter.frames );
+
+    if ( type != cfx2_node && type != cfx2_attrib )
         return cfx2_fail;
+
+    if ( !output )
+        return cfx2_void;
+
+    *output = result;
+    return type;
 }
 
-static cfx2_ResultType process_command( cfx2_Node* base, const char* command, char* buffer, int allow_modifications, void** output )
+libcfx2 int cfx2_create_query_iter( cfx2_QueryIter** iter_ptr, const cfx2_Query* query, cfx2_Node* base,
+        const char* const* params )
 {
-    unsigned pos = 0;
-    cfx2_Node* child;
+    cfx2_QueryIter* iter;
+    int rc;
 
-    /* Read an identifier form the command string. */
-    while ( is_ident_char( *command ) )
-        buffer[pos++] = *( command++ );
+    if ( iter_ptr == NULL || query == NULL || base == NULL || query->has_value
+            || ( query->num_params > 0 && params == NULL ) )
+        return cfx2_param_invalid;
 
-    buffer[pos] = 0;
+    iter = ( cfx2_QueryIter* )libcfx2_malloc( sizeof( cfx2_QueryIter ), cfx2_mem_query );
 
-    switch ( *command )
+    if ( iter == NULL )
+        return cfx2_alloc_error;
+
+    if ( ( rc = iter_start( iter, query, base, params ) ) != cfx2_ok )
     {
-        case 0:
-        case ':':
-        case '/':
-        case '.':
-            break;
+        libcfx2_free( iter->frames );
+        libcfx2_free( iter );
+        return rc;
+    }
 
-        default:
-            return cfx2_fail;
+    *iter_ptr = iter;
+    return cfx2_ok;
+}
+
+libcfx2 int cfx2_query_all( cfx2_QueryIter** iter_ptr, cfx2_Node* base, const char* command )
+{
+    cfx2_Query* query;
+    int rc;
+
+    if ( command == NULL )
+        return cfx2_param_invalid;
+
+    if ( ( rc = compile_query( &query, command, 0 ) ) != cfx2_ok )
+        return rc;
+
+    if ( ( rc = cfx2_create_query_iter( iter_ptr, query, base, NULL ) ) != cfx2_ok )
+    {
+        cfx2_release_query( &query );
+        return rc;
     }
 
-    if ( !buffer[0] )
-        child = base;
-    else
-        child = cfx2_find_child( base, buffer );
+    ( *iter_ptr )->owned_query = query;
+    return cfx2_ok;
+}
+
+libcfx2 cfx2_ResultType cfx2_query_iter_next( cfx2_QueryIter* iter, void** output )
+{
+    void* result;
+
+    return iter_next( iter, output != NULL ? output : &result );
+}
 
-    if ( !child )
+libcfx2 void cfx2_release_query_iter( cfx2_QueryIter** iter_ptr )
+{
+    cfx2_QueryIter* iter;
+
+    if ( ( iter = *iter_ptr ) == NULL )
+        return;
+
+    libcfx2_free( iter->owned_query );
+    libcfx2_free( iter->frames );
+    libcfx2_free( iter );
+    *iter_ptr = NULL;
+}
+
+libcfx2 cfx2_ResultType cfx2_execute_query( const cfx2_Query* query, cfx2_Node* base, const char* const* params,
+        int allow_modifications, void** output )
+{
+    cfx2_Node* node, * child;
+    cfx2_Attrib* attrib;
+    const char* name;
+    size_t i, hash;
+
+    if ( !query || !base || ( query->num_params > 0 && params == NULL ) )
+        return cfx2_fail;
+
+    if ( query->has_patterns )
+        return first_match( query, base, params, output );
+
+    for ( node = base, i = 0; i < query->num_steps; i++, node = child )
     {
+        if ( ( name = step_name( &query->steps[i], params, &hash ) ) == NULL )
+            return cfx2_fail;
+
+        child = cfx2_find_child_hashed( node, name, hash );
+
         /*
             The requested node does not exist.
             We'll try to create it then.
-            If we aren't allowed to do so, we return NULL.
+            If we aren't allowed to do so, we fail.
         */
 
-        if ( allow_modifications )
-            child = cfx2_create_child( base, buffer, 0, 0 );
-        else
+        if ( child == NULL )
+        {
+            if ( allow_modifications )
+                child = cfx2_create_child( node, name, 0, cfx2_multiple );
+
+            if ( child == NULL )
+                return cfx2_fail;
+        }
+    }
+
+    attrib = NULL;
+
+    if ( query->has_attrib )
+    {
+        if ( ( name = step_name( &query->attrib, params, &hash ) ) == NULL
+                || ( attrib = query_attrib( node, name, hash, allow_modifications ) ) == NULL )
             return cfx2_fail;
     }
 
-    if ( *command == 0 )
+    if ( query->has_value )
     {
-        if ( output )
-        {
-            *output = ( void* )child;
-            return cfx2_node;
-        }
+        if ( !allow_modifications )
+            return cfx2_fail;
+
+        if ( ( name = step_name( &query->value, params, &hash ) ) == NULL )
+            return cfx2_fail;
+
+        if ( attrib != NULL )
+            cfx2_attrib_set_value( node, attrib, name );
         else
-            return cfx2_void;
+            cfx2_set_node_text( node, name );
     }
-    else if ( *command == '/' )
-        return process_command( child, command + 1, buffer, allow_modifications, output );
-    else if ( *command == '.' )
-        return attrib_process_command( child, command + 1, buffer, allow_modifications, output );
-    else if ( *command == ':' && allow_modifications )
+
+    if ( !output )
+        return cfx2_void;
+
+    if ( attrib != NULL )
     {
-        cfx2_set_node_text( child, command + 1 );
+        *output = ( void* )attrib;
+        return cfx2_attrib;
+    }
+    else
+    {
+        *output = ( void* )node;
+        return cfx2_node;
+    }
+}
+
+libcfx2 const char* cfx2_execute_query_value( const cfx2_Query* query, cfx2_Node* base, const char* const* params )
+{
+    void* output;
+    cfx2_ResultType result;
+
+    result = cfx2_execute_query( query, base, params, 0, &output );
+
+    if ( result == cfx2_node )
+        return ( ( cfx2_Node* )output )->text;
+    else if ( result == cfx2_attrib )
+        return ( ( cfx2_Attrib* )output )->value;
+    else
+        return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Queries on Views                                                          */
+/* -------------------------------------------------------------------------- */
+
+typedef struct
+{
+    cfx2_ViewNode node;
+    size_t step, next_child;
+    int self_done;
+}
+ViewFrame_t;
+
+static int view_match_predicates( const cfx2_Query* query, const QueryStep_t* step, const char* const* params,
+        const cfx2_View* view, cfx2_ViewNode node )
+{
+    const QueryPredicate_t* predicate;
+    const char* name, * value, * attrib_value;
+    size_t i, hash;
+
+    for ( i = 0; i < step->num_predicates; i++ )
+    {
+        predicate = &query->predicates[step->first_predicate + i];
+
+        if ( ( name = step_name( &predicate->attrib, params, &hash ) ) == NULL
+                || cfx2_view_find_attrib( view, node, name, &attrib_value ) != cfx2_ok )
+            return 0;
+
+        value = ( predicate->value.param >= 0 ) ? params[predicate->value.param] : predicate->value.name;
+
+        if ( value != NULL && ( attrib_value == NULL || strcmp( attrib_value, value ) != 0 ) )
+            return 0;
+    }
+
+    return 1;
+}
 
-        if ( output )
+/* The same walk as iter_next, stopping at the first match */
+static cfx2_ViewNode view_first_match( const cfx2_Query* query, const cfx2_View* view, cfx2_ViewNode base,
+        const char* const* params )
+{
+    const QueryStep_t* step;
+    ViewFrame_t* frames, * frame;
+    size_t depth, max_depth, k, hash;
+    cfx2_ViewNode node, match;
+    const char* name, * child_name;
+
+    max_depth = 16;
+    frames = ( ViewFrame_t* )libcfx2_malloc( max_depth * sizeof( ViewFrame_t ), cfx2_mem_query );
+
+    if ( frames == NULL )
+        return cfx2_no_view_node;
+
+    frames[0].node = base;
+    frames[0].step = 0;
+    frames[0].next_child = 0;
+    frames[0].self_done = 0;
+    depth = 1;
+    match = cfx2_no_view_node;
+
+    while ( depth > 0 && match == cfx2_no_view_node )
+    {
+        frame = &frames[depth - 1];
+        node = frame->node;
+        k = frame->step;
+
+        if ( k == query->num_steps )
+        {
+            depth--;
+
+            if ( !query->has_attrib
+                    || ( ( name = step_name( &query->attrib, params, &hash ) ) != NULL
+                    && cfx2_view_find_attrib( view, node, name, NULL ) == cfx2_ok ) )
+                match = node;
+
+            continue;
+        }
+
+        step = &query->steps[k];
+
+        /* the frame to push, if any, goes to k + 1 unless node is a descendant to expand */
+        if ( step->kind == STEP_SELF )
+        {
+            depth--;
+
+            if ( !view_match_predicates( query, step, params, view, node ) )
+                continue;
+
+            k++;
+        }
+        else if ( step->kind == STEP_DESCENDANTS && !frame->self_done )
+        {
+            frame->self_done = 1;
+
+            if ( !view_match_predicates( query, step, params, view, node ) )
+                continue;
+
+            k++;
+        }
+        else if ( frame->next_child >= cfx2_view_num_children( view, node ) )
         {
-            *output = ( void* )child;
-            return cfx2_node;
+            depth--;
+            continue;
         }
         else
-            return cfx2_void;
+        {
+            node = cfx2_view_child( view, node, frame->next_child++ );
+
+            if ( step->kind == STEP_ANY )
+            {
+                if ( !view_match_predicates( query, step, params, view, node ) )
+                    continue;
+
+                k++;
+            }
+            else if ( step->kind == STEP_NAME )
+            {
+                if ( ( name = step_name( step, params, &hash ) ) == NULL
+                        || ( child_name = cfx2_view_name( view, node ) ) == NULL || strcmp( child_name, name ) != 0
+                        || !view_match_predicates( query, step, params, view, node ) )
+                    continue;
+
+                k++;
+            }
+        }
+
+        if ( depth == max_depth )
+        {
+            frame = ( ViewFrame_t* )libcfx2_realloc( frames, max_depth * 2 * sizeof( ViewFrame_t ), cfx2_mem_query );
+
+            if ( frame == NULL )
+                break;
+
+            frames = frame;
+            max_depth *= 2;
+        }
+
+        frame = &frames[depth++];
+        frame->node = node;
+        frame->step = k;
+        frame->next_child = 0;
+        frame->self_done = 0;
     }
+
+    libcfx2_free( frames );
+    return match;
+}
+
+libcfx2 const char* cfx2_view_execute_query_value( const cfx2_View* view, const cfx2_Query* query, cfx2_ViewNode base,
+        const char* const* params )
+{
+    cfx2_ViewNode node;
+    const char* name, * value;
+    size_t i, hash;
+
+    /* views are read-only */
+    if ( !query || !view || query->has_value || ( query->num_params > 0 && params == NULL ) )
+        return NULL;
+
+    if ( query->has_patterns )
+        node = view_first_match( query, view, base, params );
     else
-        return cfx2_fail;
+    {
+        for ( node = base, i = 0; i < query->num_steps && node != cfx2_no_view_node; i++ )
+        {
+            if ( ( name = step_name( &query->steps[i], params, &hash ) ) == NULL )
+                return NULL;
+
+            node = cfx2_view_find_child( view, node, name );
+        }
+    }
+
+    if ( node == cfx2_no_view_node )
+        return NULL;
+
+    if ( !query->has_attrib )
+        return cfx2_view_text( view, node );
+
+    if ( ( name = step_name( &query->attrib, params, &hash ) ) == NULL
+            || cfx2_view_find_attrib( view, node, name, &value ) != cfx2_ok )
+        return NULL;
+
+    return value;
+}
+
+libcfx2 const char* cfx2_view_query_value( const cfx2_View* view, cfx2_ViewNode base, const char* command )
+{
+    cfx2_Query* query;
+    const char* value;
+
+    if ( !view || !command || compile_query( &query, command, 0 ) != cfx2_ok )
+        return NULL;
+
+    value = cfx2_view_execute_query_value( view, query, base, NULL );
+
+    cfx2_release_query( &query );
+    return value;
 }
 
+/* -------------------------------------------------------------------------- */
+/*  Query Cache                                                               */
+/* -------------------------------------------------------------------------- */
+
+libcfx2 int cfx2_create_query_cache( cfx2_QueryCache** cache_ptr, size_t capacity )
+{
+    cfx2_QueryCache* cache;
+
+    if ( cache_ptr == NULL || capacity == 0 )
+        return cfx2_param_invalid;
+
+    cache = ( cfx2_QueryCache* )libcfx2_malloc( sizeof( cfx2_QueryCache )
+            + capacity * ( sizeof( cfx2_Query* ) + sizeof( size_t ) ), cfx2_mem_query );
+
+    if ( cache == NULL )
+        return cfx2_alloc_error;
+
+    cache->capacity = capacity;
+    cache->count = 0;
+    cache->queries = ( cfx2_Query** )( cache + 1 );
+    cache->hashes = ( size_t* )( cache->queries + capacity );
+
+    *cache_ptr = cache;
+    return cfx2_ok;
+}
+
+libcfx2 const cfx2_Query* cfx2_cached_query( cfx2_QueryCache* cache, const char* command )
+{
+    cfx2_Query* query;
+    size_t i, hash;
+
+    if ( cache == NULL || command == NULL )
+        return NULL;
+
+    hash = cfx2_hash_name( command );
+
+    for ( i = 0; i < cache->count; i++ )
+        if ( cache->hashes[i] == hash && strcmp( cache->queries[i]->command, command ) == 0 )
+            break;
+
+    if ( i < cache->count )
+        query = cache->queries[i];
+    else
+    {
+        if ( compile_query( &query, command, 1 ) != cfx2_ok )
+            return NULL;
+
+        /* evict the least recently used query */
+        if ( cache->count == cache->capacity )
+            cfx2_release_query( &cache->queries[--cache->count] );
+
+        i = cache->count++;
+    }
+
+    /* move to the front */
+    memmove( cache->queries + 1, cache->queries, i * sizeof( cfx2_Query* ) );
+    memmove( cache->hashes + 1, cache->hashes, i * sizeof( size_t ) );
+
+    cache->queries[0] = query;
+    cache->hashes[0] = hash;
+    return query;
+}
+
+libcfx2 void cfx2_release_query_cache( cfx2_QueryCache** cache_ptr )
+{
+    cfx2_QueryCache* cache;
+    size_t i;
+
+    if ( ( cache = *cache_ptr ) == NULL )
+        return;
+
+    for ( i = 0; i < cache->count; i++ )
+        cfx2_release_query( &cache->queries[i] );
+
+    libcfx2_free( cache );
+    *cache_ptr = NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Batch Queries                                                             */
+/* -------------------------------------------------------------------------- */
+
+#define trie_node( batch_, index_ ) ( &cfx2_item( ( batch_ )->nodes, index_, TrieNode_t ) )
+#define trie_leaf( batch_, index_ ) ( &cfx2_item( ( batch_ )->leaves, index_, TrieLeaf_t ) )
+
+static size_t add_trie_node( cfx2_QueryBatch* batch, size_t parent, const QueryStep_t* step )
+{
+    TrieNode_t* node;
+    size_t index;
+
+    index = cfx2_list_length( batch->nodes );
+    node = ( TrieNode_t* )cfx2_list_add_item( &batch->nodes, sizeof( TrieNode_t ), NULL );
+
+    if ( node == NULL )
+        return TRIE_NONE;
+
+    node->step = step;
+    node->first_child = TRIE_NONE;
+    node->first_leaf = TRIE_NONE;
+
+    if ( parent != TRIE_NONE )
+    {
+        node->next_sibling = trie_node( batch, parent )->first_child;
+        trie_node( batch, parent )->first_child = index;
+    }
+    else
+        node->next_sibling = TRIE_NONE;
+
+    return index;
+}
+
+/* The trie node for the step below parent, added if it isn't there yet */
+static size_t trie_child( cfx2_QueryBatch* batch, size_t parent, const QueryStep_t* step )
+{
+    const TrieNode_t* node;
+    size_t i;
+
+    for ( i = trie_node( batch, parent )->first_child; i != TRIE_NONE; i = node->next_sibling )
+    {
+        node = trie_node( batch, i );
+
+        if ( node->step->hash == step->hash && strcmp( node->step->name, step->name ) == 0 )
+            return i;
+    }
+
+    return add_trie_node( batch, parent, step );
+}
+
+static int add_to_trie( cfx2_QueryBatch* batch, const cfx2_Query* query, size_t slot )
+{
+    TrieLeaf_t* leaf;
+    size_t node, i;
+
+    for ( node = 0, i = 0; i < query->num_steps; i++ )
+        if ( ( node = trie_child( batch, node, &query->steps[i] ) ) == TRIE_NONE )
+            return cfx2_alloc_error;
+
+    leaf = ( TrieLeaf_t* )cfx2_list_add_item( &batch->leaves, sizeof( TrieLeaf_t ), NULL );
+
+    if ( leaf == NULL )
+        return cfx2_alloc_error;
+
+    leaf->attrib = query->has_attrib ? &query->attrib : NULL;
+    leaf->slot = slot;
+    leaf->next = trie_node( batch, node )->first_leaf;
+
+    trie_node( batch, node )->first_leaf = cfx2_list_length( batch->leaves ) - 1;
+    return cfx2_ok;
+}
+
+libcfx2 int cfx2_compile_query_batch( cfx2_QueryBatch** batch_ptr, const char* const* commands, size_t count )
+{
+    cfx2_QueryBatch* batch;
+    size_t i;
+    int rc;
+
+    if ( batch_ptr == NULL || ( commands == NULL && count > 0 ) )
+        return cfx2_param_invalid;
+
+    batch = ( cfx2_QueryBatch* )libcfx2_malloc( sizeof( cfx2_QueryBatch ) + count * sizeof( cfx2_Query* ), cfx2_mem_query );
+
+    if ( batch == NULL )
+        return cfx2_alloc_error;
+
+    batch->count = count;
+    batch->queries = ( cfx2_Query** )( batch + 1 );
+
+    cfx2_list_init( &batch->nodes );
+    cfx2_list_init( &batch->leaves );
+
+    for ( i = 0; i < count; i++ )
+        batch->queries[i] = NULL;
+
+    rc = ( add_trie_node( batch, TRIE_NONE, NULL ) != TRIE_NONE ) ? cfx2_ok : cfx2_alloc_error;
+
+    for ( i = 0; i < count && rc == cfx2_ok; i++ )
+    {
+        /* invalid queries (and modifications and patterns) simply have no value */
+        if ( commands[i] == NULL )
+            continue;
+
+        rc = compile_query( &batch->queries[i], commands[i], 0 );
+
+        if ( rc == cfx2_syntax_error )
+        {
+            rc = cfx2_ok;
+            continue;
+        }
+
+        if ( rc == cfx2_ok && !batch->queries[i]->has_value && !batch->queries[i]->has_patterns )
+            rc = add_to_trie( batch, batch->queries[i], i );
+    }
+
+    if ( rc != cfx2_ok )
+    {
+        cfx2_release_query_batch( &batch );
+        return rc;
+    }
+
+    *batch_ptr = batch;
+    return cfx2_ok;
+}
+
+static void execute_trie( const cfx2_QueryBatch* batch, size_t index, cfx2_Node* node, const char** values )
+{
+    const TrieNode_t* trie;
+    const TrieLeaf_t* leaf;
+    cfx2_Attrib* attrib;
+    cfx2_Node* child;
+    size_t i;
+
+    trie = trie_node( batch, index );
+
+    for ( i = trie->first_leaf; i != TRIE_NONE; i = leaf->next )
+    {
+        leaf = trie_leaf( batch, i );
+
+        if ( leaf->attrib == NULL )
+            values[leaf->slot] = node->text;
+        else if ( ( attrib = cfx2_find_attrib_hashed( node, leaf->attrib->name, leaf->attrib->hash ) ) != NULL )
+            values[leaf->slot] = attrib->value;
+    }
+
+    for ( i = trie->first_child; i != TRIE_NONE; i = trie_node( batch, i )->next_sibling )
+    {
+        child = cfx2_find_child_hashed( node, trie_node( batch, i )->step->name, trie_node( batch, i )->step->hash );
+
+        if ( child != NULL )
+            execute_trie( batch, i, child, values );
+    }
+}
+
+libcfx2 void cfx2_execute_query_batch( const cfx2_QueryBatch* batch, cfx2_Node* base, const char** values )
+{
+    size_t i;
+
+    for ( i = 0; i < batch->count; i++ )
+        values[i] = NULL;
+
+    if ( base != NULL )
+        execute_trie( batch, 0, base, values );
+}
+
+libcfx2 void cfx2_release_query_batch( cfx2_QueryBatch** batch_ptr )
+{
+    cfx2_QueryBatch* batch;
+    size_t i;
+
+    if ( ( batch = *batch_ptr ) == NULL )
+        return;
+
+    for ( i = 0; i < batch->count; i++ )
+        libcfx2_free( batch->queries[i] );
+
+    cfx2_list_release( &batch->nodes );
+    cfx2_list_release( &batch->leaves );
+
+    libcfx2_free( batch );
+    *batch_ptr = NULL;
+}
+
+libcfx2 int cfx2_query_values( cfx2_Node* base, const char* const* commands, size_t count, const char** values )
+{
+    cfx2_QueryBatch* batch;
+    int rc;
+
+    if ( ( rc = cfx2_compile_query_batch( &batch, commands, count ) ) != cfx2_ok )
+        return rc;
+
+    cfx2_execute_query_batch( batch, base, values );
+    cfx2_release_query_batch( &batch );
+    return cfx2_ok;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Queries                                                                   */
+/* -------------------------------------------------------------------------- */
+
 libcfx2 cfx2_ResultType cfx2_query( cfx2_Node* base, const char* command,
         int allow_modifications, void** output )
 {
-    char* buffer;
+    cfx2_Query* query;
     cfx2_ResultType type;
 
     if ( !base || !command )
         return cfx2_fail;
 
-    /* this one is used by process_command() to store identifiers */
-    buffer = ( char* )libcfx2_malloc( strlen( command ) + 1 );
+    /* plain queries take no parameters; "%s" is just an invalid name (or a value) */
+    if ( compile_query( &query, command, 0 ) != cfx2_ok )
+        return cfx2_fail;
 
-    /* enter the matrix */
-    type = process_command( base, command, buffer, allow_modifications, output );
+    type = cfx2_execute_query( query, base, NULL, allow_modifications, output );
 
-    libcfx2_free( buffer );
+    cfx2_release_query( &query );
 
     return type;
 }
@@ -21,522 +21,1263 @@
     distribution.
 */
 
+#include "alloc.h"
+#include "arena.h"
 #include "attrib.h"
 #include "config.h"
+#include "index.h"
+#include "intern.h"
 #include "lexer.h"
 #include "list.h"
 #include "node.h"
+#include "reader.h"
+#include "thread.h"
 
 #include <confix2.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/* handler building the document tree from the reader events */
 typedef struct
 {
-    cfx2_Node* node;        /* base node */
-    cfx2_int16_t index;     /* attribute index or -1 */
-    cfx2_uint16_t offset;   /* offset within node or attrib struct */
+    int rc;
+    const cfx2_Allocator* allocator;
+
+    /* set for arena documents; strings then go straight to the arena */
+    cfx2_Arena* arena;
+
+    /* attribute names of a heap document (an arena document has its own table) */
+    NameTable_t names;
+
+    /* nodes[0] is the document, nodes[depth] the innermost open node */
+    size_t depth, max_depth;
+    cfx2_Node** nodes;
 }
-Fixup_t;
+TreeBuilder;
+
+/* what the parser expects next */
+#define S_node              0
+#define S_after_name        1
+#define S_text              2
+#define S_after_text        3
+#define S_attr_name         4
+#define S_after_attr_name   5
+#define S_attr_value        6
+#define S_after_attr_value  7
 
 typedef struct
 {
     Lexer* lexer;
+    const cfx2_ReadHandler* handler;
+    const cfx2_Allocator* allocator;
+
     int rc, terminated;
+    int expect;
 
-    /* shared buffers */
-    int buf_level;
-    size_t buf_used;
-    char* bufs[PARSER_NUM_BUFS];
-    char* buf;
-    
-    /* buffer pointer fixups */
-    size_t num_fixups, max_fixups;
-    Fixup_t* fixups;
+    /* attribute waiting for its value; the name is a slice of the lexer input */
+    size_t attr_name_pos, attr_name_len;
+
+    /* indentation of every open node */
+    size_t depth, max_depth;
+    int* indents;
 }
 ParseState;
 
-static void push_buf( ParseState* state, ParseState* shadow_state )
+struct cfx2_Parser
+{
+    cfx2_RdOpt rd_opt;
+    Lexer lexer;
+    ParseState state;
+
+    cfx2_ReadHandler handler;
+    TreeBuilder builder;
+
+    /* input not consumed yet (an incomplete token) */
+    char* pending;
+    size_t pending_len, pending_capacity;
+};
+
+/* Strings of a node's children are stored in the node's shared buffer */
+static int shared_alloc( cfx2_Node* owner, char** ptr_out, const char* str_in, size_t str_len )
 {
-    size_t offset, length;
+    SharedHeader_t* sh;
+    size_t size;
+    char* chunk;
+    int rc;
 
-    offset = offsetof( ParseState, buf_level );
-    length = sizeof( ParseState ) - offset;
+    size = shared_size( str_len + 1 );
+    sh = ( SharedHeader_t* )owner->shared;
 
-    memcpy( ( char* )shadow_state + offset, ( char* )state + offset, length );
-    memset( ( char* )state + offset, 0, length );
-    
-    state->buf_level = -1;
+    /* Will fit in current chunk? (if any) */
+    if ( sh == NULL || sh->used + size > sh->capacity )
+    {
+        size_t capacity;
+
+        /* If not, start a bigger one; the strings written so far stay where they are */
+        capacity = ( sh != NULL ) ? sh->capacity * 2 : PARSER_MIN_CHUNK;
+
+        if ( capacity > PARSER_MAX_CHUNK )
+            capacity = PARSER_MAX_CHUNK;
+
+        if ( capacity < size )
+            capacity = size;
+
+        if ( ( rc = cfx2_add_shared_chunk( owner, capacity ) ) != cfx2_ok )
+            return rc;
+
+        sh = ( SharedHeader_t* )owner->shared;
+    }
+
+    chunk = shared_data( sh ) + sh->used;
+    sh->used += size;
+
+    *( s_nref_t* )chunk = 0;
+    chunk += sizeof( s_nref_t );
+
+    memcpy( chunk, str_in, str_len );
+    chunk[str_len] = 0;
+
+    *ptr_out = chunk;
+    return cfx2_ok;
 }
 
-static void pop_buf( ParseState* state, ParseState* shadow_state )
+/* -------------------------------------------------------------------------- */
+/*  Tree Builder                                                              */
+/* -------------------------------------------------------------------------- */
+
+static int builder_init( TreeBuilder* builder, cfx2_Node** doc_ptr, const cfx2_RdOpt* rd_opt )
 {
-    size_t offset, length;
+    builder->rc = cfx2_ok;
+    builder->allocator = cfx2_rd_opt_allocator( rd_opt );
+    builder->arena = NULL;
+    cfx2_names_init( &builder->names, NULL, builder->allocator );
+    builder->depth = 0;
+    builder->max_depth = 8;
+    builder->nodes = ( cfx2_Node** )cfx2_alloc_with( builder->allocator, builder->max_depth * sizeof( cfx2_Node* ), cfx2_mem_parser );
 
-    offset = offsetof( ParseState, buf_level );
-    length = sizeof( ParseState ) - offset;
-    
-    memcpy( ( char* )state + offset, ( char* )shadow_state + offset, length );
+    if ( builder->nodes == NULL )
+        return cfx2_alloc_error;
+
+    *doc_ptr = NULL;
+
+    if ( ( rd_opt->flags & cfx2_arena_document )
+            && ( builder->rc = cfx2_arena_create( &builder->arena, builder->allocator ) ) != cfx2_ok )
+    {
+        cfx2_free_with( builder->allocator, builder->nodes );
+        builder->nodes = NULL;
+        return builder->rc;
+    }
+
+    if ( ( builder->rc = cfx2_create_arena_node( doc_ptr, builder->arena ) ) != cfx2_ok )
+    {
+        if ( builder->arena != NULL )
+            cfx2_arena_release( builder->arena );
+
+        cfx2_free_with( builder->allocator, builder->nodes );
+        builder->nodes = NULL;
+        return builder->rc;
+    }
+
+    /* the root owns the arena */
+    if ( builder->arena != NULL )
+        builder->arena->root = *doc_ptr;
+
+    builder->nodes[0] = *doc_ptr;
+
+    return cfx2_ok;
+}
+
+/* Closes any nodes left open (the document included) and returns the document */
+static cfx2_Node* builder_finish( TreeBuilder* builder )
+{
+    cfx2_Node* doc;
+
+    if ( builder->nodes == NULL )
+        return NULL;
+
+    doc = builder->nodes[0];
+
+    while ( builder->depth > 0 )
+        cfx2_index_node( builder->nodes[builder->depth--] );
+
+    cfx2_index_node( doc );
+
+    cfx2_free_with( builder->allocator, builder->nodes );
+    builder->nodes = NULL;
+
+    cfx2_names_release( &builder->names );
+
+    return doc;
+}
+
+static int builder_string( TreeBuilder* builder, char** ptr_out, const char* str_in, size_t str_len )
+{
+    char* chunk;
+
+    /* the node's own strings go to its parent's buffer (the document's attributes to its own) */
+    if ( builder->arena == NULL )
+        return shared_alloc( builder->nodes[builder->depth > 0 ? builder->depth - 1 : 0], ptr_out, str_in, str_len );
+
+    chunk = ( char* )cfx2_arena_alloc( builder->arena, sizeof( s_nref_t ) + str_len + 1 );
+
+    if ( chunk == NULL )
+        return cfx2_alloc_error;
+
+    *( s_nref_t* )chunk = 0;
+    chunk += sizeof( s_nref_t );
+
+    memcpy( chunk, str_in, str_len );
+    chunk[str_len] = 0;
+
+    *ptr_out = chunk;
+    return cfx2_ok;
+}
+
+static int builder_attrib_name( TreeBuilder* builder, char** ptr_out, const char* name, size_t name_length )
+{
+    int rc;
+
+    rc = cfx2_intern_name( builder->arena != NULL ? &builder->arena->names : &builder->names,
+            ptr_out, name, name_length );
+
+    /* too many distinct names: store it like any other string */
+    if ( rc == cfx2_ok && *ptr_out == NULL )
+        rc = builder_string( builder, ptr_out, name, name_length );
+
+    return rc;
 }
 
-static void save_buf_to_node( ParseState* state, cfx2_Node* node )
+/* Allocation failures stop the reader; the builder keeps the error code */
+#define builder_check( rc_ ) if ( ( builder->rc = ( rc_ ) ) != cfx2_ok ) return cfx2_stop
+
+static int builder_begin_node( void* user, const char* name, size_t name_length )
 {
-    if ( state->buf_used > 0 )
+    TreeBuilder* builder;
+    cfx2_Node* parent, * node, ** p_child;
+
+    builder = ( TreeBuilder* )user;
+
+    if ( builder->depth + 1 >= builder->max_depth )
+    {
+        cfx2_Node** nodes;
+
+        nodes = ( cfx2_Node** )cfx2_realloc_with( builder->allocator, builder->nodes,
+                builder->max_depth * 2 * sizeof( cfx2_Node* ), cfx2_mem_parser );
+
+        if ( nodes == NULL )
+        {
+            builder->rc = cfx2_alloc_error;
+            return cfx2_stop;
+        }
+
+        builder->nodes = nodes;
+        builder->max_depth *= 2;
+    }
+
+    builder_check( cfx2_create_arena_node( &node, builder->arena ) );
+
+    /* the node and its parent are in the same arena (or none), so there is nothing to adopt;
+       wide nodes are indexed when they are complete */
+    parent = builder->nodes[builder->depth];
+    p_child = ( cfx2_Node** )cfx2_list_add_item( &parent->children, sizeof( cfx2_Node* ), parent->arena );
+
+    if ( p_child == NULL )
+    {
+        cfx2_release_node( &node );
+        builder->rc = cfx2_alloc_error;
+        return cfx2_stop;
+    }
+
+    *p_child = node;
+    builder->nodes[++builder->depth] = node;
+
+    builder_check( builder_string( builder, &node->name, name, name_length ) );
+
+    return cfx2_continue;
+}
+
+static int builder_node_text( void* user, const char* text, size_t length )
+{
+    TreeBuilder* builder;
+
+    builder = ( TreeBuilder* )user;
+
+    builder_check( builder_string( builder, &builder->nodes[builder->depth]->text, text, length ) );
+
+    return cfx2_continue;
+}
+
+static int builder_attrib( void* user, const char* name, size_t name_length, const char* value, size_t value_length )
+{
+    TreeBuilder* builder;
+    cfx2_Attrib* attr;
+
+    builder = ( TreeBuilder* )user;
+
+    builder_check( cfx2_attrib_new( &attr, builder->nodes[builder->depth] ) );
+    builder_check( builder_attrib_name( builder, &attr->name, name, name_length ) );
+
+    if ( value != NULL )
+        builder_check( builder_string( builder, &attr->value, value, value_length ) );
+
+    return cfx2_continue;
+}
+
+static int builder_end_node( void* user )
+{
+    TreeBuilder* builder;
+
+    builder = ( TreeBuilder* )user;
+    cfx2_index_node( builder->nodes[builder->depth--] );
+    return cfx2_continue;
+}
+
+#undef builder_check
+
+static void builder_handler( cfx2_ReadHandler* handler, TreeBuilder* builder )
+{
+    handler->user = builder;
+    handler->begin_node = builder_begin_node;
+    handler->node_text = builder_node_text;
+    handler->attrib = builder_attrib;
+    handler->end_node = builder_end_node;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Reader                                                                    */
+/* -------------------------------------------------------------------------- */
+
+static void error( ParseState* state, const char* desc )
+{
+    state->rc = cfx2_syntax_error;
+    state->lexer->rd_opt->on_error( state->lexer->rd_opt, cfx2_syntax_error, state->lexer->line, desc );
+    state->terminated = 1;
+}
+
+static int init_state( ParseState* state, Lexer* lexer, const cfx2_ReadHandler* handler )
+{
+    state->lexer = lexer;
+    state->handler = handler;
+    state->allocator = cfx2_rd_opt_allocator( lexer->rd_opt );
+    state->rc = cfx2_ok;
+    state->terminated = 0;
+    state->expect = S_node;
+
+    state->attr_name_pos = 0;
+    state->attr_name_len = 0;
+
+    state->depth = 0;
+    state->max_depth = 8;
+    state->indents = ( int* )cfx2_alloc_with( state->allocator, state->max_depth * sizeof( int ), cfx2_mem_parser );
+
+    if ( state->indents == NULL )
+        return cfx2_alloc_error;
+
+    return cfx2_ok;
+}
+
+static void release_state( ParseState* state )
+{
+    cfx2_free_with( state->allocator, state->indents );
+    state->indents = NULL;
+}
+
+/* A callback asked for the parsing to end */
+static int stop( ParseState* state )
+{
+    state->rc = cfx2_interrupted;
+    state->terminated = 1;
+    return state->rc;
+}
+
+static int close_nodes( ParseState* state, int indent )
+{
+    /* Any nodes with the same or deeper indentation are complete now */
+    while ( state->depth > 0 && indent <= state->indents[state->depth - 1] )
+    {
+        state->depth--;
+
+        if ( state->handler->end_node != NULL && state->handler->end_node( state->handler->user ) == cfx2_stop )
+            return stop( state );
+    }
+
+    return cfx2_ok;
+}
+
+static int open_node( ParseState* state, Token* token )
+{
+    int rc;
+
+    if ( ( rc = close_nodes( state, token->indent ) ) != cfx2_ok )
+        return rc;
+
+    if ( state->depth >= state->max_depth )
+    {
+        int* indents;
+
+        indents = ( int* )cfx2_realloc_with( state->allocator, state->indents, state->max_depth * 2 * sizeof( int ), cfx2_mem_parser );
+
+        if ( indents == NULL )
+            return cfx2_alloc_error;
+
+        state->indents = indents;
+        state->max_depth *= 2;
+    }
+
+    state->indents[state->depth++] = token->indent;
+
+    if ( state->handler->begin_node != NULL
+            && state->handler->begin_node( state->handler->user, token->text, token->length ) == cfx2_stop )
+        return stop( state );
+
+    return cfx2_ok;
+}
+
+static int add_text( ParseState* state, Token* token )
+{
+    if ( state->handler->node_text != NULL
+            && state->handler->node_text( state->handler->user, token->text, token->length ) == cfx2_stop )
+        return stop( state );
+
+    return cfx2_ok;
+}
+
+static int add_attrib( ParseState* state, Token* value )
+{
+    if ( state->handler->attrib != NULL
+            && state->handler->attrib( state->handler->user,
+                    state->lexer->document + state->attr_name_pos, state->attr_name_len,
+                    value != NULL ? value->text : NULL, value != NULL ? value->length : 0 ) == cfx2_stop )
+        return stop( state );
+
+    return cfx2_ok;
+}
+
+/*
+ *  Runs the parser on all input available to the lexer.
+ *  Nesting is tracked on an explicit stack instead of recursion, so the parsing can be
+ *  suspended whenever the input ends mid-token and resumed once more of it arrives.
+ */
+static void parse_tokens( ParseState* state )
+{
+    Token* token;
+    int rc;
+
+    while ( !state->terminated )
+    {
+        rc = lexer_get_current( state->lexer, &token );
+
+        if ( rc == lexer_need_input )
+            return;
+        else if ( rc == cfx2_EOF )
+            token = NULL;
+        else if ( rc != cfx2_ok )
+        {
+            state->rc = rc;
+            state->terminated = 1;
+            return;
+        }
+
+        switch ( state->expect )
+        {
+            case S_after_name:
+            case S_after_text:
+                /* Read the node plain value, if it has any. */
+                if ( token != NULL && token->type == T_colon && state->expect == S_after_name )
+                {
+                    state->expect = S_text;
+                    break;
+                }
+
+                /* Parse attributes, if present. */
+                if ( token != NULL && token->type == T_paren_l )
+                {
+                    state->expect = S_attr_name;
+                    break;
+                }
+
+                /* Anything else belongs to the next node */
+                state->expect = S_node;
+
+                /* fall through */
+
+            case S_node:
+                /* Check whether there are any (more) nodes to process */
+                if ( token == NULL )
+                {
+                    if ( close_nodes( state, -1 ) == cfx2_ok )
+                        state->terminated = 1;
+
+                    return;
+                }
+
+                /* node-name expected */
+                if ( token->type != T_text )
+                {
+                    /* Not terminating the parsing here would cause an infinite loop. */
+                    error( state, "Expected node name." );
+                    return;
+                }
+
+                state->rc = open_node( state, token );
+                state->expect = S_after_name;
+                break;
+
+            case S_text:
+                if ( token == NULL || token->type != T_text )
+                {
+                    error( state, "Expected node value after ':' symbol." );
+                    return;
+                }
+
+                state->rc = add_text( state, token );
+                state->expect = S_after_text;
+                break;
+
+            case S_attr_name:
+                if ( token == NULL || token->type != T_text )
+                {
+                    error( state, "Expected attribute name." );
+                    return;
+                }
+
+                /* the attribute is reported once its value is known */
+                state->attr_name_pos = token->text - state->lexer->document;
+                state->attr_name_len = token->length;
+                state->expect = S_after_attr_name;
+                break;
+
+            case S_after_attr_name:
+                if ( token == NULL )
+                {
+                    error( state, "Expected one of ':', ',' or ')'." );
+                    return;
+                }
+
+                if ( token->type == T_colon )
+                {
+                    state->expect = S_attr_value;
+                    break;
+                }
+
+                if ( ( state->rc = add_attrib( state, NULL ) ) != cfx2_ok )
+                    break;
+
+                /* fall through */
+
+            case S_after_attr_value:
+                if ( token != NULL && token->type == T_comma )
+                    state->expect = S_attr_name;
+                else if ( token != NULL && token->type == T_paren_r )
+                    state->expect = S_node;
+                else
+                {
+                    error( state, "Expected ')' symbol after attribute list." );
+                    return;
+                }
+                break;
+
+            case S_attr_value:
+                if ( token == NULL || token->type != T_text )
+                {
+                    error( state, "Expected attribute value after ':'." );
+                    return;
+                }
+
+                state->rc = add_attrib( state, token );
+                state->expect = S_after_attr_value;
+                break;
+        }
+
+        if ( state->rc != cfx2_ok )
+        {
+            state->terminated = 1;
+            return;
+        }
+
+        lexer_read( state->lexer, NULL );
+    }
+}
+
+/* Input before this offset is no longer needed by the parser */
+static size_t parse_retained_from( ParseState* state )
+{
+    if ( ( state->expect == S_after_attr_name || state->expect == S_attr_value )
+            && state->attr_name_pos < state->lexer->document_pos )
+        return state->attr_name_pos;
+
+    return state->lexer->document_pos;
+}
+
+static void parse_rebase( ParseState* state, size_t offset )
+{
+    lexer_rebase( state->lexer, offset );
+
+    if ( state->expect == S_after_attr_name || state->expect == S_attr_value )
+        state->attr_name_pos -= offset;
+}
+
+/* Parses the whole input of rd_opt; line numbers start at first_line */
+static int parse_document( const cfx2_ReadHandler* handler, cfx2_RdOpt* rd_opt, unsigned first_line )
+{
+    ParseState state;
+    Lexer lexer;
+    int lexer_error;
+
+    /* Construct the lexer object */
+    lexer_error = create_lexer( &lexer, rd_opt );
+
+    if ( lexer_error )
+        return lexer_error;
+
+    lexer.line = first_line;
+
+    /* State initialization begins here */
+    if ( ( state.rc = init_state( &state, &lexer, handler ) ) == cfx2_ok )
+    {
+        /* And launch the parsing! */
+        parse_tokens( &state );
+        release_state( &state );
+    }
+
+    return state.rc;
+}
+
+int cfx2_build_document( cfx2_Node** doc_ptr, cfx2_RdOpt* rd_opt, cfx2_EventSource produce, void* source )
+{
+    cfx2_ReadHandler handler;
+    TreeBuilder builder;
+    int rc;
+
+    if ( ( rc = builder_init( &builder, doc_ptr, rd_opt ) ) != cfx2_ok )
+        return rc;
+
+    builder_handler( &handler, &builder );
+    rc = produce( &handler, source );
+    builder_finish( &builder );
+
+    /* an interruption means the builder failed */
+    if ( rc == cfx2_interrupted )
+        rc = builder.rc;
+
+    if ( rc > 0 )
+    {
+        cfx2_release_node( doc_ptr );
+        return rc;
+    }
+
+    return cfx2_ok;
+}
+
+/* the text document of rd_opt as an event source */
+typedef struct
+{
+    cfx2_RdOpt* rd_opt;
+    unsigned first_line;
+}
+TextSource_t;
+
+static int produce_text( const cfx2_ReadHandler* handler, void* source )
+{
+    TextSource_t* text = ( TextSource_t* )source;
+
+    return parse_document( handler, text->rd_opt, text->first_line );
+}
+
+static int build_tree( cfx2_Node** doc_ptr, cfx2_RdOpt* rd_opt, unsigned first_line )
+{
+    TextSource_t text;
+
+    text.rd_opt = rd_opt;
+    text.first_line = first_line;
+
+    return cfx2_build_document( doc_ptr, rd_opt, produce_text, &text );
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Parallel Reader                                                           */
+/* -------------------------------------------------------------------------- */
+
+/*
+ *  Nesting only depends on indentation, so a node starting a line with no indentation
+ *  closes everything before it. The input is split at such nodes and the pieces are
+ *  parsed on separate threads into documents of their own, whose top-level nodes
+ *  (and the string chunks holding their names and texts) are then moved to the first.
+ *
+ *  The scan for split points skips comments and strings and only splits where the
+ *  parser is sure to expect a node: outside attribute lists and not right after ':'.
+ *  Splits are placed every so many bytes, so the scan stops once it has found them all.
+ */
+
+typedef struct
+{
+    cfx2_RdOpt rd_opt;          /* first, so that record_error can find the task */
+    unsigned first_line;
+
+    cfx2_Node* doc;
+    int rc;
+
+    /* the first syntax error, reported by the calling thread once all pieces are done */
+    int error_rc, error_line;
+    const char* error_desc;
+}
+ParseTask_t;
+
+static int record_error( cfx2_RdOpt* rd_opt, int rc, int line, const char* desc )
+{
+    ParseTask_t* task = ( ParseTask_t* )rd_opt;
+
+    if ( task->error_rc == cfx2_ok )
     {
-        node->shared = state->buf;
-        
-        ( ( SharedHeader_t* )node->shared )->capacity = ( size_t ) PARSER_MIN_BUF << state->buf_level;
-        ( ( SharedHeader_t* )node->shared )->used = state->buf_used;
-        
-        if ( state->buf_level < PARSER_NUM_BUFS )
-            state->bufs[state->buf_level] = ( char* )libcfx2_malloc( ( size_t ) PARSER_MIN_BUF << state->buf_level );
+        task->error_rc = rc;
+        task->error_line = line;
+        task->error_desc = desc;
     }
+
+    return 0;
 }
 
-static void release_bufs( ParseState* state )
+static void parse_task( void* task_ptr )
 {
-    size_t i;
+    ParseTask_t* task = ( ParseTask_t* )task_ptr;
 
-    for ( i = 0; i < PARSER_NUM_BUFS; i++ )
-        libcfx2_free( state->bufs[i] );
-
-    libcfx2_free( state->fixups );
+    task->rc = build_tree( &task->doc, &task->rd_opt, task->first_line );
 }
 
-static int shared_alloc( ParseState* state, char** ptr_out, const char* str_in, ptrdiff_t str_len,
-        cfx2_Node* fixup_node, ptrdiff_t fixup_index, cfx2_uint16_t fixup_offset )
+/*
+ *  Finds up to max_splits split points at least spacing bytes apart: unindented lines that start
+ *  with a token the lexer reads as text or a string (starts_text), outside attribute lists,
+ *  comments, strings and after a ':'. A string can't name a node, but it fails the same way
+ *  at the start of a piece as it does in the whole document.
+ */
+static size_t find_splits( const char* doc, size_t length, size_t spacing,
+        size_t* splits, unsigned* lines, size_t max_splits )
 {
-    size_t size;
-    char* chunk;
-    
-    if ( fixup_index >= 0x7FFF )
-        return cfx2_param_invalid;
-    
-    if ( str_len < 0 )
-        str_len = strlen( str_in );
-        
-    size = sizeof( s_nref_t ) + str_len + 1;
-    
-    if ( state->buf_used == 0 )
-        size += sizeof( SharedHeader_t );
-    
-    /* Will fit in current buffer? (if any) */
-    if ( state->buf_level < 0 || state->buf_used + size > ( ( size_t ) PARSER_MIN_BUF << state->buf_level ) )
+    size_t pos, next, count;
+    unsigned line;
+    int parens, after_colon;
+    char c, quote;
+
+    pos = 0;
+    next = spacing;
+    count = 0;
+    line = 1;
+    parens = 0;
+    after_colon = 0;
+
+    while ( pos < length && count < max_splits )
     {
-        /* If not, migrate to a new one */
-        
-        int new_level;
-        char* new_buf;
-        
-        size_t i;
-        ptrdiff_t buf_diff;
-        
-        new_level = state->buf_level + 1;
-        
-        while ( state->buf_used + size > ( ( size_t ) PARSER_MIN_BUF << new_level ) )
-            new_level++;
-        
-        if ( new_level < PARSER_NUM_BUFS )
-        {
-            if ( state->bufs[new_level] == NULL )
-                state->bufs[new_level] = ( char* )libcfx2_malloc( ( size_t ) PARSER_MIN_BUF << new_level );
-            
-            new_buf = state->bufs[new_level];
-        }
-        else
-            new_buf = ( char* )libcfx2_malloc( ( size_t ) PARSER_MIN_BUF << new_level );
-        
-        if ( state->buf_used != 0 )
+        c = doc[pos++];
+
+        switch ( c )
         {
-            memcpy( new_buf, state->buf, state->buf_used );
-        
-            buf_diff = new_buf - state->buf;
-        
-            for ( i = 0; i < state->num_fixups; i++ )
-            {
-                char** ptr_to_fix;
+            case '\n':
+                line++;
 
-                if ( state->fixups[i].index != -1 )
+                if ( pos >= next && pos < length && parens == 0 && !after_colon
+                        && starts_text( doc[pos] ) )
                 {
-                    cfx2_Attrib* attr;
-                    attr = &cfx2_item( state->fixups[i].node->attributes, state->fixups[i].index, cfx2_Attrib );
-                    ptr_to_fix = ( char** )( ( char* )attr + state->fixups[i].offset );
+                    splits[count] = pos;
+                    lines[count++] = line;
+                    next = pos + spacing;
                 }
-                else
-                    ptr_to_fix = ( char** )( ( char* )state->fixups[i].node + state->fixups[i].offset );
+                break;
 
-                if ( *ptr_to_fix != NULL )
-                    *ptr_to_fix += buf_diff;
-            }
+            case '{':
+                /* comments don't end a node's "name: text" */
+                for ( ; pos < length && doc[pos] != '}'; pos++ )
+                    if ( doc[pos] == '\n' )
+                        line++;
 
-            if ( state->buf_level >= PARSER_NUM_BUFS )
-                libcfx2_free( state->buf );
-        }
-        else
-        {
-            state->buf_used = sizeof( SharedHeader_t );
-            size -= sizeof( SharedHeader_t );
+                pos++;
+                break;
+
+            case '\'':
+            case '"':
+                /* the lexer doesn't count lines inside strings */
+                for ( quote = c; pos < length && doc[pos] != quote; pos++ )
+                    if ( doc[pos] == '\\' )
+                        pos++;
+
+                pos++;
+                after_colon = 0;
+                break;
+
+            case '(': parens++; after_colon = 0; break;
+            case ')': parens--; after_colon = 0; break;
+            case ':': after_colon = 1; break;
+
+            default:
+                if ( !( lexer_char_class[( unsigned char ) c] & CC_space ) )
+                    after_colon = 0;
         }
-        
-        state->buf_level = new_level;
-        state->buf = new_buf;
-    }
-    
-    chunk = state->buf + state->buf_used;
-    
-    *( s_nref_t* )chunk = 0;
-    chunk += sizeof( s_nref_t );
-    
-    *ptr_out = chunk;
-    state->buf_used += size;
-    
-    if ( str_in != NULL )
-        memcpy( *ptr_out, str_in, str_len + 1 );
-    
-    /* add new fixup entry */
-    if ( state->num_fixups + 1 > state->max_fixups )
-    {
-        state->max_fixups = (state->max_fixups > 0) ? state->max_fixups * 2 : 8;
-        state->fixups = ( Fixup_t* )realloc( state->fixups, state->max_fixups * sizeof( Fixup_t ) );
     }
-    
-    state->fixups[state->num_fixups].node = fixup_node;
-    state->fixups[state->num_fixups].index = ( cfx2_int16_t )fixup_index;
-    state->fixups[state->num_fixups].offset = fixup_offset;
-    state->num_fixups++;
-    
-    return 0;
+
+    return count;
 }
 
-static int get_token( ParseState* state, Token** token_out )
+/* Moves the top-level nodes of src (and the strings they keep in its buffer) to doc, which isn't indexed */
+static int append_document( cfx2_Node* doc, cfx2_Node* src )
 {
-    state->rc = lexer_get_current( state->lexer, token_out );
+    SharedHeader_t* sh;
+    cfx2_Node** children;
+    size_t count;
 
-    if ( state->rc == cfx2_ok )
-        return 1;
-    else
+    count = cfx2_list_length( src->children );
+
+    if ( count > 0 )
     {
-        if ( state->rc == cfx2_EOF )
-            state->rc = cfx2_ok;
+        children = ( cfx2_Node** )cfx2_list_add_items( &doc->children, sizeof( cfx2_Node* ), count, NULL );
 
-        state->terminated = 1;
-        return 0;
+        if ( children == NULL )
+            return cfx2_alloc_error;
+
+        /* the index of src lists these nodes as its children */
+        cfx2_drop_child_index( src );
+        memcpy( children, src->children.items, count * sizeof( cfx2_Node* ) );
+        cfx2_list_release( &src->children );
+        cfx2_list_init( &src->children );
     }
-}
 
-static void free_token( ParseState* state )
-{
-    lexer_read( state->lexer, NULL );
+    if ( src->shared != NULL )
+    {
+        for ( sh = ( SharedHeader_t* )src->shared; sh->next != NULL; sh = sh->next )
+            ;
+
+        sh->next = ( SharedHeader_t* )doc->shared;
+        doc->shared = src->shared;
+        src->shared = NULL;
+    }
+
+    return cfx2_ok;
 }
 
-static cfx2_Node* parse_node( ParseState* state, cfx2_Node* parent, int min_indent )
+/* Returns cfx2_EOF (without reading anything) if the document isn't worth splitting */
+static int read_parallel( cfx2_Node** doc_ptr, cfx2_RdOpt* rd_opt, unsigned num_threads )
 {
-    cfx2_Node* node, * child;
-    ParseState shadow_state;
-    Token* token;
+    const cfx2_Allocator* allocator;
+    ParseTask_t* tasks;
+    size_t* splits;
+    unsigned* lines;
+    size_t max_tasks, num_tasks, spacing, i, end;
+    int rc;
 
-    /* Check whether there are any (more) nodes to process */
-    if ( !get_token( state, &token ) )
-        return NULL;
+    if ( rd_opt->document_len < 2 * PARSER_PARALLEL_MIN_SIZE )
+        return cfx2_EOF;
+
+    allocator = cfx2_rd_opt_allocator( rd_opt );
 
-    /* node-name expected */
-    if ( token->type != T_text )
+    max_tasks = num_threads * PARSER_TASKS_PER_THREAD;
+    spacing = rd_opt->document_len / max_tasks;
+
+    if ( spacing < PARSER_PARALLEL_MIN_SIZE )
     {
-        /* Not terminating the parsing here would cause an infinite loop. */
-        state->lexer->rd_opt->on_error( state->lexer->rd_opt, state->rc = cfx2_syntax_error, state->lexer->line, "Expected node name." );
-        state->terminated = 1;
-        return NULL;
+        spacing = PARSER_PARALLEL_MIN_SIZE;
+        max_tasks = rd_opt->document_len / spacing;
     }
 
-    /* If this node has lower indentation than expected on this level, it's none of our bussiness */
-    if ( token->indent < min_indent )
-        return NULL;
+    tasks = ( ParseTask_t* )cfx2_alloc_with( allocator,
+            max_tasks * ( sizeof( ParseTask_t ) + sizeof( size_t ) + sizeof( unsigned ) ), cfx2_mem_parser );
 
-    min_indent = token->indent;
+    if ( tasks == NULL )
+        return cfx2_EOF;
 
-    /* When we know the node name, create the object */
-    state->rc = cfx2_create_node( &node );
-    
-    if ( state->rc != 0 )
+    splits = ( size_t* )( tasks + max_tasks );
+    lines = ( unsigned* )( splits + max_tasks );
+
+    num_tasks = 1 + find_splits( rd_opt->document, rd_opt->document_len, spacing, splits + 1, lines + 1, max_tasks - 1 );
+
+    if ( num_tasks < 2 )
     {
-        state->terminated = 1;
-        return NULL;
+        cfx2_free_with( allocator, tasks );
+        return cfx2_EOF;
     }
-    
-    state->rc = shared_alloc( state, &node->name, token->text, -1,
-            node, -1, offsetof( cfx2_Node, name ) );
 
-    if ( state->rc != 0 )
+    splits[0] = 0;
+    lines[0] = 1;
+
+    for ( i = 0; i < num_tasks; i++ )
     {
-        state->terminated = 1;
-        return node;
+        end = ( i + 1 < num_tasks ) ? splits[i + 1] : rd_opt->document_len;
+
+        /* every piece is a borrowed slice of the input */
+        tasks[i].rd_opt = *rd_opt;
+        tasks[i].rd_opt.document = rd_opt->document + splits[i];
+        tasks[i].rd_opt.document_len = end - splits[i];
+        tasks[i].rd_opt.on_error = record_error;
+        tasks[i].rd_opt.flags = ( rd_opt->flags & ~cfx2_mapped_input ) | cfx2_borrowed_input;
+        tasks[i].first_line = lines[i];
+
+        tasks[i].doc = NULL;
+        tasks[i].error_rc = cfx2_ok;
     }
-    
-    free_token( state );
 
-    /* Read the node plain value, if it has any. */
-    if ( !get_token( state, &token ) )
-        return node;
+    cfx2_run_tasks( parse_task, tasks, sizeof( ParseTask_t ), num_tasks, num_threads );
 
-    if ( token->type == T_colon )
-    {
-        free_token( state );
+    /* the first error wins, just like when reading in one go */
+    rc = cfx2_ok;
 
-        if ( !get_token( state, &token ) || token->type != T_text )
-        {
-            state->lexer->rd_opt->on_error( state->lexer->rd_opt, state->rc = cfx2_syntax_error, state->lexer->line, "Expected node value after ':' symbol." );
-            state->terminated = 1;
-            return node;
-        }
+    for ( i = 0; i < num_tasks && rc == cfx2_ok; i++ )
+    {
+        rc = tasks[i].rc;
 
-        state->rc = shared_alloc( state, &node->text, token->text, -1,
-                node, -1, offsetof( cfx2_Node, text ) );
-        
-        if ( state->rc != 0 )
-        {
-            state->terminated = 1;
-            return node;
-        }
-        
-        free_token( state );
+        if ( rc != cfx2_ok && tasks[i].error_rc != cfx2_ok && rd_opt->on_error != NULL )
+            rd_opt->on_error( rd_opt, tasks[i].error_rc, tasks[i].error_line, tasks[i].error_desc );
     }
 
-    /* Parse attributes, if present. */
-    if ( !get_token( state, &token ) )
-        return node;
+    /* the top-level nodes are indexed once they are all in */
+    if ( rc == cfx2_ok )
+        cfx2_drop_child_index( tasks[0].doc );
+
+    for ( i = 1; i < num_tasks && rc == cfx2_ok; i++ )
+        rc = append_document( tasks[0].doc, tasks[i].doc );
+
+    if ( rc == cfx2_ok )
+        cfx2_index_node( tasks[0].doc );
+
+    for ( i = ( rc == cfx2_ok ) ? 1 : 0; i < num_tasks; i++ )
+        cfx2_release_node( &tasks[i].doc );
+
+    *doc_ptr = tasks[0].doc;
+    cfx2_free_with( allocator, tasks );
+    return rc;
+}
+
+libcfx2 int cfx2_read_events( const cfx2_ReadHandler* handler, cfx2_RdOpt* rd_opt )
+{
+    int rc;
+
+    rc = parse_document( handler, rd_opt, 1 );
+
+    /* We don't need the input any more, so let's free it (unless it's borrowed). */
+    cfx2_release_input( rd_opt );
+
+    return rc;
+}
+
+libcfx2 int cfx2_read( cfx2_Node** doc_ptr, cfx2_RdOpt* rd_opt )
+{
+    unsigned num_threads;
+    int rc;
+
+    rc = cfx2_EOF;
 
-    if ( token->type == T_paren_l )
+    /* an arena can't be shared between threads */
+    if ( ( rd_opt->flags & cfx2_parallel_input ) && !( rd_opt->flags & cfx2_arena_document ) )
     {
-        free_token( state );
+        num_threads = ( rd_opt->num_threads > 0 ) ? rd_opt->num_threads : cfx2_processor_count();
 
-        for ( ; ; )
-        {
-            cfx2_Attrib* attr;
-
-            if ( !get_token( state, &token ) || token->type != T_text )
-            {
-                state->lexer->rd_opt->on_error( state->lexer->rd_opt, state->rc = cfx2_syntax_error, state->lexer->line, "Expected attribute name." );
-                state->terminated = 1;
-                return node;
-            }
-
-            cfx2_attrib_new( &attr, node );
-
-            if ( state->rc != 0 )
-            {
-                state->terminated = 1;
-                return node;
-            }
-
-            state->rc = shared_alloc( state, &attr->name, token->text, -1,
-                    node, node->attributes.length - 1, offsetof( cfx2_Attrib, name ) );
-            
-            if ( state->rc != 0 )
-            {
-                state->terminated = 1;
-                return node;
-            }
-            
-            free_token( state );
-
-            if ( !get_token( state, &token ) )
-            {
-                state->lexer->rd_opt->on_error( state->lexer->rd_opt, state->rc = cfx2_syntax_error, state->lexer->line, "Expected one of ':', ',' or ')'." );
-                return node;
-            }
-
-            if ( token->type == T_colon )
-            {
-                free_token( state );
-
-                if ( !get_token( state, &token ) || token->type != T_text )
-                {
-                    cfx2_attrib_release( attr );
+        if ( num_threads > 1 )
+            rc = read_parallel( doc_ptr, rd_opt, num_threads );
+    }
 
-                    state->lexer->rd_opt->on_error( state->lexer->rd_opt, state->rc = cfx2_syntax_error, state->lexer->line, "Expected attribute value after ':'." );
-                    state->terminated = 1;
-                    return node;
-                }
+    if ( rc == cfx2_EOF )
+        rc = build_tree( doc_ptr, rd_opt, 1 );
 
-                state->rc = shared_alloc( state, &attr->value, token->text, -1,
-                        node, node->attributes.length - 1, offsetof( cfx2_Attrib, value ) );
-                
-                if ( state->rc != 0 )
-                {
-                    state->terminated = 1;
-                    return node;
-                }
-        
-                free_token( state );
-            }
+    cfx2_release_input( rd_opt );
+    return rc;
+}
 
-            if ( !get_token( state, &token ) || token->type != T_comma )
-                break;
-            else
-                free_token( state );
-        }
+int cfx2_file_input( cfx2_RdOpt* rd_opt, const char* filename, const cfx2_RdOpt* rd_opt_in )
+{
+    int rc;
 
-        if ( !get_token( state, &token ) || token->type != T_paren_r )
-        {
-            state->lexer->rd_opt->on_error( state->lexer->rd_opt, state->rc = cfx2_syntax_error, state->lexer->line, "Expected ')' symbol after attribute list." );
-            state->terminated = 1;
-            return node;
-        }
+    memset( rd_opt, 0, sizeof( *rd_opt ) );
 
-        free_token( state );
+    /* the input buffer comes from the reader's allocator too */
+    if ( rd_opt_in != NULL && ( rd_opt_in->flags & cfx2_use_allocator ) )
+    {
+        rd_opt->flags = cfx2_use_allocator;
+        rd_opt->allocator = rd_opt_in->allocator;
     }
 
-    push_buf( state, &shadow_state );
+    if ( rd_opt_in != NULL )
+        rd_opt->num_threads = rd_opt_in->num_threads;
     
-    while ( !state->terminated )
+    if ( rd_opt_in != NULL && ( rd_opt_in->flags & cfx2_mapped_input ) )
+        rc = cfx2_mapped_input_from_file( rd_opt, filename );
+    else
+        rc = cfx2_buffer_input_from_file( rd_opt, filename );
+    
+    rd_opt->client_priv = ( void* )filename;
+    
+    if ( rd_opt_in != NULL )
     {
-        child = parse_node( state, node, min_indent + 1 );
+        if ( rd_opt_in->on_error != NULL )
+        {
+            rd_opt->client_priv = rd_opt_in->client_priv;
+            rd_opt->on_error = rd_opt_in->on_error;
+        }
+        
+        /* cfx2_mapped_input now reflects whether the input was actually mapped */
+        rd_opt->flags = ( rd_opt_in->flags & ~( cfx2_mapped_input | cfx2_borrowed_input ) )
+                | ( rd_opt->flags & cfx2_mapped_input );
+    }
 
-        if ( child && state->rc != cfx2_ok )
-            cfx2_release_node( &child );
+    return rc;
+}
 
-        if ( child )
-            cfx2_add_child( node, child );
-        else
-            break;
+static int string_input( cfx2_RdOpt* rd_opt, const char* string, const cfx2_RdOpt* rd_opt_in )
+{
+    if ( rd_opt_in != NULL )
+        memcpy( rd_opt, rd_opt_in, sizeof( cfx2_RdOpt ) );
+    else
+    {
+        /* num_threads, allocator and the rest mustn't be left to the stack */
+        memset( rd_opt, 0, sizeof( cfx2_RdOpt ) );
+        rd_opt->client_priv = NULL;
+        rd_opt->on_error = NULL;
+        rd_opt->flags = 0;
     }
     
-    save_buf_to_node( state, node );
-    release_bufs( state );
+    rd_opt->flags &= ~cfx2_mapped_input;
+    return cfx2_buffer_input_from_string( rd_opt, string );
+}
+
+libcfx2 int cfx2_read_file( cfx2_Node** doc_ptr, const char* filename, const cfx2_RdOpt* rd_opt_in )
+{
+    cfx2_RdOpt rd_opt;
+    int rc;
+
+    rc = cfx2_file_input( &rd_opt, filename, rd_opt_in );
 
-    pop_buf( state, &shadow_state );
+    return ( rc != 0 ) ? rc : cfx2_read( doc_ptr, &rd_opt );
+}
+
+libcfx2 int cfx2_read_from_string( cfx2_Node** doc_ptr, const char* string, const cfx2_RdOpt* rd_opt_in )
+{
+    cfx2_RdOpt rd_opt;
+    int rc;
     
-    return node;
+    rc = string_input( &rd_opt, string, rd_opt_in );
+
+    return ( rc != 0 ) ? rc : cfx2_read( doc_ptr, &rd_opt );
 }
 
-static int parse_document( ParseState* state, cfx2_Node** doc_ptr )
+libcfx2 int cfx2_read_events_from_file( const cfx2_ReadHandler* handler, const char* filename, const cfx2_RdOpt* rd_opt_in )
 {
-    cfx2_Node* child;
+    cfx2_RdOpt rd_opt;
     int rc;
 
-    rc = cfx2_create_node( doc_ptr );
+    rc = cfx2_file_input( &rd_opt, filename, rd_opt_in );
 
-    if ( rc != cfx2_ok )
-        return rc;
+    return ( rc != 0 ) ? rc : cfx2_read_events( handler, &rd_opt );
+}
 
-    while ( !state->terminated )
-    {
-        child = parse_node( state, NULL, 0 );
+libcfx2 int cfx2_read_events_from_string( const cfx2_ReadHandler* handler, const char* string, const cfx2_RdOpt* rd_opt_in )
+{
+    cfx2_RdOpt rd_opt;
+    int rc;
 
-        if ( child && state->rc != cfx2_ok )
-            cfx2_release_node( &child );
+    rc = string_input( &rd_opt, string, rd_opt_in );
 
-        if ( child )
-            cfx2_add_child( *doc_ptr, child );
-        else
-            break;
-    }
+    return ( rc != 0 ) ? rc : cfx2_read_events( handler, &rd_opt );
+}
 
-    save_buf_to_node( state, *doc_ptr );
+libcfx2 cfx2_Node* cfx2_load_document( const char* filename )
+{
+    cfx2_Node* doc;
 
-    return state->rc;
+    if ( cfx2_read_file( &doc, filename, NULL ) == cfx2_ok )
+        return doc;
+    else
+        return NULL;
 }
 
-libcfx2 int cfx2_read( cfx2_Node** doc_ptr, cfx2_RdOpt* rd_opt )
+/* -------------------------------------------------------------------------- */
+/*  Incremental Reader                                                        */
+/* -------------------------------------------------------------------------- */
+
+static int create_parser( cfx2_Parser** parser_ptr, const cfx2_ReadHandler* handler, const cfx2_RdOpt* rd_opt_in )
 {
-    ParseState state;
-    Lexer lexer;
-    int lexer_error;
-    unsigned int i;
+    const cfx2_Allocator* allocator;
+    cfx2_Parser* parser;
+    cfx2_Node* doc;
+    int rc;
 
-    /* Construct the lexer object */
-    lexer_error = create_lexer( &lexer, rd_opt );
+    allocator = cfx2_rd_opt_allocator( rd_opt_in );
+    parser = ( cfx2_Parser* )cfx2_alloc_with( allocator, sizeof( cfx2_Parser ), cfx2_mem_parser );
 
-    if ( lexer_error )
-        return lexer_error;
+    if ( parser == NULL )
+        return cfx2_alloc_error;
 
-    /* State initialization begins here */
-    state.lexer = &lexer;
-    state.rc = cfx2_ok;
-    state.terminated = 0;
-    
-    state.buf_level = -1;
-    state.buf_used = 0;
-    
-    for ( i = 0; i < PARSER_NUM_BUFS; i++ )
-        state.bufs[i] = NULL;
-    
-    state.buf = NULL;
+    memset( &parser->rd_opt, 0, sizeof( parser->rd_opt ) );
 
-    state.num_fixups = 0;
-    state.max_fixups = 0;
-    state.fixups = NULL;
-    
-    *doc_ptr = 0;
+    if ( rd_opt_in != NULL )
+    {
+        parser->rd_opt.client_priv = rd_opt_in->client_priv;
+        parser->rd_opt.on_error = rd_opt_in->on_error;
+        parser->rd_opt.flags = rd_opt_in->flags & ~( cfx2_mapped_input | cfx2_borrowed_input );
+        parser->rd_opt.allocator = rd_opt_in->allocator;
+    }
 
-    /* And launch the parsing! */
-    state.rc = parse_document( &state, doc_ptr );
+    if ( parser->rd_opt.on_error == NULL )
+        parser->rd_opt.on_error = BufferInput_on_error;
 
-    /* We don't need the input any more, so let's free it. */
-    free( rd_opt->document );
+    create_lexer( &parser->lexer, &parser->rd_opt );
+    lexer_set_input( &parser->lexer, NULL, 0, 0 );
 
-    release_bufs( &state );
+    /* without a handler of its own, the parser builds a document */
+    parser->builder.nodes = NULL;
 
-    if ( state.rc > 0 )
+    if ( handler != NULL )
+        parser->handler = *handler;
+    else
     {
-        cfx2_release_node( doc_ptr );
-        return state.rc;
+        if ( ( rc = builder_init( &parser->builder, &doc, &parser->rd_opt ) ) != cfx2_ok )
+        {
+            cfx2_free_with( allocator, parser );
+            return rc;
+        }
+
+        builder_handler( &parser->handler, &parser->builder );
+    }
+
+    if ( ( rc = init_state( &parser->state, &parser->lexer, &parser->handler ) ) != cfx2_ok )
+    {
+        doc = builder_finish( &parser->builder );
+        cfx2_release_node( &doc );
+        cfx2_free_with( allocator, parser );
+        return rc;
     }
 
+    parser->pending = NULL;
+    parser->pending_len = 0;
+    parser->pending_capacity = 0;
+
+    *parser_ptr = parser;
     return cfx2_ok;
 }
 
-libcfx2 int cfx2_read_file( cfx2_Node** doc_ptr, const char* filename, const cfx2_RdOpt* rd_opt_in )
+libcfx2 int cfx2_create_parser( cfx2_Parser** parser_ptr, const cfx2_RdOpt* rd_opt_in )
 {
-    cfx2_RdOpt rd_opt;
-    int rc;
+    return create_parser( parser_ptr, NULL, rd_opt_in );
+}
 
-    memset( &rd_opt, 0, sizeof( rd_opt ) );
-    
-    rc = cfx2_buffer_input_from_file( &rd_opt, filename );
-    
-    rd_opt.client_priv = ( void* )filename;
-    
-    if ( rd_opt_in != NULL )
+libcfx2 int cfx2_create_event_parser( cfx2_Parser** parser_ptr, const cfx2_ReadHandler* handler, const cfx2_RdOpt* rd_opt_in )
+{
+    if ( handler == NULL )
+        return cfx2_param_invalid;
+
+    return create_parser( parser_ptr, handler, rd_opt_in );
+}
+
+static int append_pending( cfx2_Parser* parser, const char* data, size_t length )
+{
+    if ( length == 0 )
+        return cfx2_ok;
+
+    if ( parser->pending_len + length > parser->pending_capacity )
     {
-        if ( rd_opt_in->on_error != NULL )
-        {
-            rd_opt.client_priv = rd_opt_in->client_priv;
-            rd_opt.on_error = rd_opt_in->on_error;
-        }
-        
-        rd_opt.flags = rd_opt_in->flags;
+        size_t capacity;
+        char* pending;
+
+        capacity = parser->pending_capacity > 0 ? parser->pending_capacity : 256;
+
+        while ( capacity < parser->pending_len + length )
+            capacity *= 2;
+
+        pending = ( char* )cfx2_realloc_with( cfx2_rd_opt_allocator( &parser->rd_opt ), parser->pending, capacity, cfx2_mem_parser );
+
+        if ( pending == NULL )
+            return cfx2_alloc_error;
+
+        parser->pending = pending;
+        parser->pending_capacity = capacity;
     }
 
-    return ( rc != 0 ) ? rc : cfx2_read( doc_ptr, &rd_opt );
+    memcpy( parser->pending + parser->pending_len, data, length );
+    parser->pending_len += length;
+    return cfx2_ok;
 }
 
-libcfx2 int cfx2_read_from_string( cfx2_Node** doc_ptr, const char* string, const cfx2_RdOpt* rd_opt_in )
+libcfx2 int cfx2_parser_feed( cfx2_Parser* parser, const char* chunk, size_t length )
 {
-    cfx2_RdOpt rd_opt;
+    size_t consumed;
     int rc;
-    
-    if ( rd_opt_in != NULL )
-        memcpy( &rd_opt, rd_opt_in, sizeof( cfx2_RdOpt ) );
+
+    if ( parser->state.terminated )
+        return ( parser->state.rc != cfx2_ok ) ? parser->state.rc : cfx2_param_invalid;
+
+    if ( parser->pending_len == 0 )
+    {
+        /* Nothing left over, so parse straight from the caller's chunk */
+        lexer_set_input( &parser->lexer, chunk, length, 0 );
+        parse_tokens( &parser->state );
+
+        consumed = parse_retained_from( &parser->state );
+        parse_rebase( &parser->state, consumed );
+
+        /* Keep what's left of an incomplete token */
+        if ( ( rc = append_pending( parser, chunk + consumed, length - consumed ) ) != cfx2_ok )
+            return parser->state.rc = rc;
+    }
     else
     {
-        rd_opt.client_priv = NULL;
-        rd_opt.on_error = NULL;
-        rd_opt.flags = 0;
+        if ( ( rc = append_pending( parser, chunk, length ) ) != cfx2_ok )
+            return parser->state.rc = rc;
+
+        lexer_set_input( &parser->lexer, parser->pending, parser->pending_len, 0 );
+        parse_tokens( &parser->state );
+
+        consumed = parse_retained_from( &parser->state );
+        parse_rebase( &parser->state, consumed );
+
+        memmove( parser->pending, parser->pending + consumed, parser->pending_len - consumed );
+        parser->pending_len -= consumed;
     }
-    
-    rc = cfx2_buffer_input_from_string( &rd_opt, string );
 
-    return ( rc != 0 ) ? rc : cfx2_read( doc_ptr, &rd_opt );
+    lexer_set_input( &parser->lexer, parser->pending, parser->pending_len, 0 );
+    return parser->state.rc;
 }
 
-libcfx2 cfx2_Node* cfx2_load_document( const char* filename )
+libcfx2 int cfx2_parser_finish( cfx2_Parser* parser, cfx2_Node** doc_ptr )
 {
     cfx2_Node* doc;
+    int rc;
 
-    if ( cfx2_read_file( &doc, filename, NULL ) == cfx2_ok )
-        return doc;
+    lexer_set_input( &parser->lexer, parser->pending, parser->pending_len, 1 );
+    parse_tokens( &parser->state );
+    release_state( &parser->state );
+
+    rc = parser->state.rc;
+    doc = builder_finish( &parser->builder );
+
+    /* an interruption of the tree builder means it failed */
+    if ( doc != NULL && rc == cfx2_interrupted )
+        rc = parser->builder.rc;
+
+    if ( rc > 0 )
+        cfx2_release_node( &doc );
+
+    if ( doc_ptr != NULL )
+        *doc_ptr = doc;
     else
-        return NULL;
+        cfx2_release_node( &doc );
+
+    return rc;
+}
+
+libcfx2 void cfx2_release_parser( cfx2_Parser** parser_ptr )
+{
+    const cfx2_Allocator* allocator;
+    cfx2_Parser* parser;
+    cfx2_Node* doc;
+
+    parser = *parser_ptr;
+
+    if ( parser == NULL )
+        return;
+
+    allocator = cfx2_rd_opt_allocator( &parser->rd_opt );
+
+    /* not finished: the document is discarded */
+    release_state( &parser->state );
+    doc = builder_finish( &parser->builder );
+    cfx2_release_node( &doc );
+
+    cfx2_free_with( allocator, parser->pending );
+    cfx2_free_with( allocator, parser );
+    *parser_ptr = NULL;
 }
@@ -0,0 +1,42 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+#ifndef libcfx2_reader_h
+#define libcfx2_reader_h
+
+#include <confix2.h>
+
+/*
+ *  Documents in other formats are built by the same tree builder as text documents:
+ *  produce reports the document to handler, as the text reader would, and returns
+ *  cfx2_ok, cfx2_interrupted if a callback stopped it, or another error code.
+ *  rd_opt selects the allocator and an arena document (cfx2_arena_document).
+ */
+typedef int ( *cfx2_EventSource )( const cfx2_ReadHandler* handler, void* source );
+
+int cfx2_build_document( cfx2_Node** doc_ptr, cfx2_RdOpt* rd_opt, cfx2_EventSource produce, void* source );
+
+/* sets up rd_opt to read a file, with the options of rd_opt_in (may be NULL) */
+int cfx2_file_input( cfx2_RdOpt* rd_opt, const char* filename, const cfx2_RdOpt* rd_opt_in );
+
+#endif
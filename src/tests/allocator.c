@@ -0,0 +1,118 @@
+
+#include "tests.h"
+
+#include <string.h>
+
+#define allocator_filename  "usertable.cfx2"
+
+typedef struct
+{
+    long live, total;
+}
+Counter;
+
+static void* counting_alloc(void* user, size_t size)
+{
+    ((Counter*) user)->live++;
+    ((Counter*) user)->total++;
+    return malloc(size);
+}
+
+static void* counting_realloc(void* user, void* ptr, size_t size)
+{
+    if (ptr == NULL)
+    {
+        ((Counter*) user)->live++;
+        ((Counter*) user)->total++;
+    }
+
+    return realloc(ptr, size);
+}
+
+static void counting_free(void* user, void* ptr)
+{
+    ((Counter*) user)->live--;
+    free(ptr);
+}
+
+static int count_node(void* user, const char* name, size_t name_length)
+{
+    (*(int*) user)++;
+    return cfx2_continue;
+}
+
+int allocator(void)
+{
+    cfx2_Allocator global_alloc, reader_alloc, saved;
+    Counter global_count, reader_count;
+    cfx2_ReadHandler handler;
+    cfx2_RdOpt rd_opt;
+    cfx2_Node* doc;
+    int nodes, rc;
+
+    global_count.live = global_count.total = 0;
+    reader_count.live = reader_count.total = 0;
+
+    global_alloc.user = &global_count;
+    global_alloc.alloc = counting_alloc;
+    global_alloc.realloc = counting_realloc;
+    global_alloc.free = counting_free;
+
+    reader_alloc = global_alloc;
+    reader_alloc.user = &reader_count;
+
+    tests_assert(cfx2_set_allocator(&global_alloc) == cfx2_ok)
+    cfx2_get_allocator(&saved);
+    tests_assert(saved.user == &global_count)
+
+    /* everything goes through the global allocator */
+    doc = cfx2_load_document(allocator_filename);
+    tests_assert(doc != NULL)
+    tests_assert(global_count.live > 0)
+
+    tests_assert(cfx2_set_node_attrib(doc, "attrib", "value") == cfx2_ok)
+    tests_assert(cfx2_set_node_attrib(doc, "attrib", "changed") == cfx2_ok)
+    tests_assert(cfx2_create_child(doc, "Child", "text", cfx2_multiple) != NULL)
+
+    cfx2_release_node(&doc);
+    tests_assert(global_count.live == 0)
+
+    /* arena documents and the reader's scratch memory use the reader allocator */
+    rd_opt.client_priv = NULL;
+    rd_opt.on_error = NULL;
+    rd_opt.flags = cfx2_use_allocator | cfx2_arena_document;
+    rd_opt.allocator = &reader_alloc;
+
+    global_count.total = 0;
+
+    rc = cfx2_read_file(&doc, allocator_filename, &rd_opt);
+
+    if (rc != cfx2_ok)
+        tests_fail(("failed to load '%s': %s", allocator_filename, cfx2_get_error_desc(rc)))
+
+    tests_assert(reader_count.live > 0)
+    tests_assert(global_count.total == 0)
+
+    cfx2_release_node(&doc);
+    tests_assert(reader_count.live == 0)
+
+    /* the event reader allocates nothing but scratch memory */
+    memset(&handler, 0, sizeof(handler));
+    handler.user = &nodes;
+    handler.begin_node = count_node;
+
+    nodes = 0;
+    reader_count.total = 0;
+
+    rc = cfx2_read_events_from_file(&handler, allocator_filename, &rd_opt);
+    tests_assert(rc == cfx2_ok)
+    tests_assert(nodes > 0)
+    tests_assert(reader_count.total > 0 && reader_count.live == 0)
+    tests_assert(global_count.total == 0)
+
+    tests_assert(cfx2_set_allocator(NULL) == cfx2_ok)
+    cfx2_get_allocator(&saved);
+    tests_assert(saved.user == NULL)
+
+    return 0;
+}
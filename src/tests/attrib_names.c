@@ -0,0 +1,129 @@
+
+#include "tests.h"
+
+#include <string.h>
+
+#define attrib_count    200
+#define operation_count 20000
+
+static const char widgets[] =
+    "Button: 'OK' (x: 10, y: 20, width: 80, height: 24)\n"
+    "Button: 'Cancel' (x: 100, y: 20, width: 80, height: 24)\n"
+    "Label: 'Name' (x: 10, y: 60, width: 170, height: 16)\n";
+
+/* what cfx2_find_attrib returned before there was an index */
+static cfx2_Attrib* find_attrib_linear(cfx2_Node* node, const char* name)
+{
+    size_t i;
+
+    for (i = 0; i < cfx2_list_length(node->attributes); i++)
+        if (strcmp(cfx2_item(node->attributes, i, cfx2_Attrib).name, name) == 0)
+            return &cfx2_item(node->attributes, i, cfx2_Attrib);
+
+    return NULL;
+}
+
+static void check_shared_names(cfx2_Node* doc)
+{
+    cfx2_Node* first, * node;
+    size_t i, j;
+
+    first = cfx2_item(doc->children, 0, cfx2_Node*);
+
+    for (i = 1; i < cfx2_list_length(doc->children); i++)
+    {
+        node = cfx2_item(doc->children, i, cfx2_Node*);
+
+        for (j = 0; j < cfx2_list_length(node->attributes); j++)
+            tests_assert(cfx2_item(node->attributes, j, cfx2_Attrib).name
+                    == cfx2_item(first->attributes, j, cfx2_Attrib).name)
+    }
+}
+
+static void exercise_index(cfx2_Node* node)
+{
+    char name[16], value[16];
+    int i, expected;
+
+    for (i = 0; i < attrib_count; i++)
+    {
+        sprintf(name, "a%i", i);
+        tests_assert(cfx2_set_node_attrib(node, name, "0") == cfx2_ok)
+    }
+
+    tests_assert(cfx2_find_attrib(node, "a0") != NULL)
+    tests_assert(node->attrib_index != NULL)
+
+    for (i = 0; i < operation_count; i++)
+    {
+        sprintf(name, "a%i", rand() % (attrib_count * 2));
+        sprintf(value, "%i", i);
+
+        if (rand() % 3 == 0)
+        {
+            expected = (find_attrib_linear(node, name) != NULL) ? cfx2_ok : cfx2_attrib_not_found;
+            tests_assert(cfx2_remove_attrib(node, name) == expected)
+        }
+        else
+            tests_assert(cfx2_set_node_attrib(node, name, value) == cfx2_ok)
+
+        sprintf(name, "a%i", rand() % (attrib_count * 2));
+        tests_assert(cfx2_find_attrib(node, name) == find_attrib_linear(node, name))
+    }
+}
+
+int attrib_names(void)
+{
+    cfx2_Node* doc, * node;
+    cfx2_RdOpt rd_opt;
+    const char* value;
+    int rc;
+
+    srand(0);
+
+    /* heap documents share reference-counted names, which outlive the document */
+    rc = cfx2_read_from_string(&doc, widgets, NULL);
+    tests_assert(rc == cfx2_ok)
+    check_shared_names(doc);
+
+    node = cfx2_item(doc->children, 1, cfx2_Node*);
+    tests_assert(cfx2_remove_child(doc, node) == cfx2_ok)
+    cfx2_release_node(&doc);
+
+    tests_assert(cfx2_get_node_attrib(node, "width", &value) == cfx2_ok && strcmp(value, "80") == 0)
+    exercise_index(node);
+    cfx2_release_node(&node);
+
+    /* arena documents intern attributes added later too */
+    rd_opt.client_priv = NULL;
+    rd_opt.on_error = NULL;
+    rd_opt.flags = cfx2_arena_document;
+
+    rc = cfx2_read_from_string(&doc, widgets, &rd_opt);
+    tests_assert(rc == cfx2_ok)
+    check_shared_names(doc);
+
+    node = cfx2_create_child(doc, "Button", "Apply", cfx2_multiple);
+    tests_assert(node != NULL)
+    tests_assert(cfx2_set_node_attrib(node, "x", "190") == cfx2_ok)
+    tests_assert(cfx2_item(node->attributes, 0, cfx2_Attrib).name
+            == cfx2_item(cfx2_item(doc->children, 0, cfx2_Node*)->attributes, 0, cfx2_Attrib).name)
+
+    exercise_index(node);
+    cfx2_release_node(&doc);
+
+    /* the reader indexes wide nodes, lookups only read */
+    rc = cfx2_read_from_string(&doc, "wide (a0: 0, a1: 1, a2: 2, a3: 3, a4: 4, a5: 5, a6: 6, a7: 7, a8: 8, a9: 9,\n"
+            "a10: 10, a11: 11, a12: 12, a13: 13, a14: 14, a15: 15, a16: 16, a17: 17)\nnarrow (a0: 0)\n", NULL);
+    tests_assert(rc == cfx2_ok)
+
+    node = cfx2_find_child(doc, "wide");
+    tests_assert(node != NULL && node->attrib_index != NULL)
+    tests_assert(cfx2_get_node_attrib(node, "a17", &value) == cfx2_ok && strcmp(value, "17") == 0)
+
+    node = cfx2_find_child(doc, "narrow");
+    tests_assert(cfx2_get_node_attrib(node, "a0", &value) == cfx2_ok && node->attrib_index == NULL)
+    cfx2_release_node(&doc);
+
+    return 0;
+}
@@ -0,0 +1,193 @@
+
+#include "tests.h"
+
+#include "usertable.h"
+
+#include <string.h>
+
+#define binary_filename     "binary_roundtrip.cfx2b"
+#define broken_filename     "binary_broken.cfx2b"
+
+#define wide_count          2000
+#define chain_depth         500
+
+static int count_error(cfx2_RdOpt* rd_opt, int rc, int line, const char* desc)
+{
+    (void) rc;
+    (void) line;
+    (void) desc;
+
+    (*(int*) rd_opt->client_priv)++;
+    return 0;
+}
+
+/* damaged files are reported once and don't leave a document behind */
+static void check_broken(const char* filename)
+{
+    cfx2_Node* doc;
+    cfx2_RdOpt rd_opt;
+    int errors;
+
+    errors = 0;
+    doc = NULL;
+
+    memset(&rd_opt, 0, sizeof(rd_opt));
+    rd_opt.client_priv = &errors;
+    rd_opt.on_error = count_error;
+
+    tests_assert_2(cfx2_load_binary(&doc, filename, &rd_opt) == cfx2_bad_format, filename)
+    tests_assert_2(errors == 1 && doc == NULL, filename)
+}
+
+static void write_whole_file(const char* filename, const char* data, size_t size)
+{
+    FILE* file;
+
+    file = fopen(filename, "wb");
+    tests_assert_2(file != NULL, filename)
+    tests_assert(fwrite(data, 1, size, file) == size)
+    fclose(file);
+}
+
+/* text -> binary -> tree must serialize exactly like the original, heap and arena alike */
+static void check_roundtrip(cfx2_Node* doc, const char* desc)
+{
+    cfx2_Node* loaded;
+    cfx2_RdOpt rd_opt;
+    char* expected, * output;
+    size_t expected_len, output_len;
+    int pass;
+
+    expected = tests_serialize(doc, &expected_len);
+    tests_assert_2(cfx2_save_binary(doc, binary_filename) == cfx2_ok, desc)
+
+    memset(&rd_opt, 0, sizeof(rd_opt));
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        rd_opt.flags = (pass == 0) ? 0 : cfx2_arena_document;
+
+        tests_assert_2(cfx2_load_binary(&loaded, binary_filename, &rd_opt) == cfx2_ok, desc)
+        tests_assert_2((loaded->arena != NULL) == (pass == 1), desc)
+
+        output = tests_serialize(loaded, &output_len);
+        tests_assert_2(output_len == expected_len, desc)
+        tests_assert_2(output_len == 0 || memcmp(output, expected, output_len) == 0, desc)
+
+        free(output);
+        cfx2_release_node(&loaded);
+    }
+
+    free(expected);
+}
+
+/* the shared document, behind a node with valueless attributes and above a deep chain */
+static cfx2_Node* build_doc(void)
+{
+    cfx2_Node* doc, * node;
+    size_t i;
+
+    doc = tests_build_doc(wide_count);
+
+    node = cfx2_new_node("valueless");
+    tests_assert(node != NULL)
+    tests_assert(cfx2_set_node_text(node, "text") == cfx2_ok)
+    tests_assert(cfx2_set_node_attrib(node, "flag", NULL) == cfx2_ok)
+    tests_assert(cfx2_set_node_attrib(node, "other", "1") == cfx2_ok)
+    tests_assert(cfx2_set_node_attrib(node, "last", NULL) == cfx2_ok)
+    tests_assert(cfx2_insert_child(doc, 0, node) == cfx2_ok)
+
+    for (node = doc, i = 0; i < chain_depth; i++)
+    {
+        node = cfx2_create_child(node, "level", NULL, cfx2_multiple);
+        tests_assert(node != NULL)
+    }
+
+    return doc;
+}
+
+int binary_roundtrip(void)
+{
+    cfx2_Node* doc, * loaded, * node;
+    char* data;
+    size_t size, i;
+    int rc;
+
+    /* a document from a text file */
+    rc = cfx2_read_file(&doc, usertable_filename, NULL);
+
+    if (rc != cfx2_ok)
+        tests_fail(("failed to load '%s': %s", usertable_filename, cfx2_get_error_desc(rc)))
+
+    check_roundtrip(doc, usertable_filename);
+    cfx2_release_node(&doc);
+
+    /* generated ones */
+    doc = cfx2_new_node(NULL);
+    check_roundtrip(doc, "empty document");
+    cfx2_release_node(&doc);
+
+    doc = build_doc();
+    check_roundtrip(doc, "wide and deep document");
+
+    /* attributes without values stay that way */
+    tests_assert(cfx2_load_binary(&loaded, binary_filename, NULL) == cfx2_ok)
+    node = cfx2_find_child(loaded, "valueless");
+    tests_assert(node != NULL && cfx2_list_length(node->attributes) == 3)
+    tests_assert(cfx2_find_attrib(node, "flag")->value == NULL)
+    tests_assert(strcmp(cfx2_find_attrib(node, "other")->value, "1") == 0)
+    tests_assert(cfx2_find_attrib(node, "last")->value == NULL)
+    tests_assert(strcmp(cfx2_item(loaded->children, 2, cfx2_Node*)->text, "it's #1") == 0)
+    tests_assert(cfx2_item(loaded->children, 1, cfx2_Node*)->text == NULL)
+    cfx2_release_node(&loaded);
+
+    /* which the text format can't store, neither can the binary one */
+    tests_assert(cfx2_create_child(cfx2_item(doc->children, 8, cfx2_Node*), "", NULL, cfx2_multiple) != NULL)
+    tests_assert(cfx2_save_binary(doc, broken_filename) == cfx2_missing_node_name)
+    cfx2_release_node(&doc);
+
+    /* strings are stored once: 9 nodes with a 4-byte name and text need only one 12-byte string */
+    doc = cfx2_new_node(NULL);
+
+    for (i = 0; i < 9; i++)
+        tests_assert(cfx2_create_child(doc, "same", "same", cfx2_multiple) != NULL)
+
+    tests_assert(cfx2_save_binary(doc, binary_filename) == cfx2_ok)
+    free(tests_read_file(binary_filename, &size));
+    tests_assert(size == 32 + 10 * 24 + 12)
+    cfx2_release_node(&doc);
+
+    /* damaged files are rejected, not read past their end */
+    doc = build_doc();
+    tests_assert(cfx2_save_binary(doc, binary_filename) == cfx2_ok)
+    cfx2_release_node(&doc);
+
+    data = tests_read_file(binary_filename, &size);
+
+    for (i = 0; i < size; i += (i < 256) ? 1 : size / 64)
+    {
+        write_whole_file(broken_filename, data, i);
+        check_broken(broken_filename);
+    }
+
+    data[0] = 'x';
+    write_whole_file(broken_filename, data, size);
+    check_broken(broken_filename);
+
+    /* the second node claims the children of the first */
+    data[0] = 'c';
+    data[32 + 24 + 8] = data[32 + 8];
+    write_whole_file(broken_filename, data, size);
+    check_broken(broken_filename);
+
+    free(data);
+
+    /* a text document is not a binary one */
+    check_broken(usertable_filename);
+    tests_assert(cfx2_load_binary(&loaded, "no such file.cfx2b", NULL) == cfx2_cant_open_file)
+
+    remove(binary_filename);
+    remove(broken_filename);
+
+    return 0;
+}
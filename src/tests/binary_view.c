@@ -0,0 +1,199 @@
+
+#include "tests.h"
+
+#include "usertable.h"
+
+#include <string.h>
+
+#define view_filename       "binary_view.cfx2b"
+#define wide_count          200000
+
+static const char* commands[] =
+{
+    "Users/root.homeDir",
+    "Users/root",
+    "Users/nobody.homeDir",
+    "Users/root.nothing",
+    "Users/*.homeDir",
+    "Users/*[passwordHash=33].homeDir",
+    "Users/*[hasPassword=1][passwordHash=51].homeDir",
+    "**[hasPassword=0].homeDir",
+    "**[passwordHash=34].homeDir",
+    "**/root.passwordHash",
+    "Users/[hasPassword].homeDir",
+    "Users/root.homeDir:changed",
+    "Users/*[hasPassword",
+    NULL
+};
+
+static const char text_document[] = "Users\n  root (homeDir: '/root')\n";
+
+static int strings_equal(const char* a, const char* b)
+{
+    return (a == NULL) ? (b == NULL) : (b != NULL && strcmp(a, b) == 0);
+}
+
+/* the view shows the same as the tree, and finds the same children and attributes */
+static void compare_node(cfx2_Node* node, const cfx2_View* view, cfx2_ViewNode view_node, int is_root)
+{
+    cfx2_Node* child;
+    cfx2_Attrib* attrib;
+    const char* name, * value;
+    size_t i;
+
+    if (!is_root)
+    {
+        tests_assert(strings_equal(node->name, cfx2_view_name(view, view_node)))
+        tests_assert(strings_equal(node->text, cfx2_view_text(view, view_node)))
+    }
+
+    tests_assert(cfx2_list_length(node->attributes) == cfx2_view_num_attribs(view, view_node))
+
+    for (i = 0; i < cfx2_list_length(node->attributes); i++)
+    {
+        attrib = &cfx2_item(node->attributes, i, cfx2_Attrib);
+
+        tests_assert(cfx2_view_attrib(view, view_node, i, &name, &value) == cfx2_ok)
+        tests_assert(strcmp(attrib->name, name) == 0 && strings_equal(attrib->value, value))
+
+        tests_assert(cfx2_view_find_attrib(view, view_node, attrib->name, &value) == cfx2_ok)
+        tests_assert(strings_equal(cfx2_find_attrib(node, attrib->name)->value, value))
+    }
+
+    tests_assert(cfx2_view_attrib(view, view_node, i, &name, &value) == cfx2_attrib_not_found)
+    tests_assert(cfx2_view_find_attrib(view, view_node, "no such attribute", NULL) == cfx2_attrib_not_found)
+
+    tests_assert(cfx2_list_length(node->children) == cfx2_view_num_children(view, view_node))
+    tests_assert(cfx2_view_child(view, view_node, cfx2_list_length(node->children)) == cfx2_no_view_node)
+    tests_assert(cfx2_view_find_child(view, view_node, "no such node") == cfx2_no_view_node)
+
+    for (i = 0; i < cfx2_list_length(node->children); i++)
+    {
+        child = cfx2_item(node->children, i, cfx2_Node*);
+
+        /* duplicate names find the first */
+        if (cfx2_find_child(node, child->name) == child)
+            tests_assert(cfx2_view_find_child(view, view_node, child->name) == cfx2_view_child(view, view_node, i))
+
+        compare_node(child, view, cfx2_view_child(view, view_node, i), 0);
+    }
+}
+
+/* damaged records read as missing; walking everything must still end */
+static size_t walk_all(const cfx2_View* view, cfx2_ViewNode node)
+{
+    const char* name, * value;
+    size_t count, i;
+
+    cfx2_view_name(view, node);
+    cfx2_view_text(view, node);
+
+    for (i = 0; i < cfx2_view_num_attribs(view, node); i++)
+        cfx2_view_attrib(view, node, i, &name, &value);
+
+    for (count = 1, i = 0; i < cfx2_view_num_children(view, node); i++)
+        count += walk_all(view, cfx2_view_child(view, node, i));
+
+    return count;
+}
+
+int binary_view(void)
+{
+    cfx2_Node* doc, * node;
+    cfx2_View* view;
+    cfx2_Query* query;
+    const char* params[2];
+    char* data, name[32];
+    size_t size, num_nodes, i;
+    tests_Perf perf;
+    int rc;
+
+    rc = cfx2_read_file(&doc, usertable_filename, NULL);
+
+    if (rc != cfx2_ok)
+        tests_fail(("failed to load '%s': %s", usertable_filename, cfx2_get_error_desc(rc)))
+
+    tests_assert(cfx2_save_binary(doc, view_filename) == cfx2_ok)
+    tests_assert(cfx2_open_view(&view, view_filename) == cfx2_ok)
+
+    compare_node(doc, view, cfx2_view_root, 1);
+
+    /* queries give what they give on the tree */
+    for (i = 0; commands[i] != NULL; i++)
+        tests_assert_2(strings_equal(cfx2_query_value(doc, commands[i]), cfx2_view_query_value(view, cfx2_view_root, commands[i])), commands[i])
+
+    tests_assert(strcmp(cfx2_view_query_value(view, cfx2_view_find_child(view, cfx2_view_root, "Users"), "root.homeDir"), "/root") == 0)
+
+    tests_assert(cfx2_compile_query(&query, "Users/%s.%s") == cfx2_ok)
+    params[0] = "root";
+    params[1] = "homeDir";
+    tests_assert(strcmp(cfx2_view_execute_query_value(view, query, cfx2_view_root, params), "/root") == 0)
+    tests_assert(cfx2_view_execute_query_value(view, query, cfx2_view_root, NULL) == NULL)
+    cfx2_release_query(&query);
+
+    /* nodes that don't exist */
+    tests_assert(cfx2_view_name(view, 1000000) == NULL)
+    tests_assert(cfx2_view_num_children(view, cfx2_no_view_node) == 0)
+    tests_assert(cfx2_view_find_child(view, cfx2_no_view_node, "Users") == cfx2_no_view_node)
+    tests_assert(cfx2_view_query_value(view, cfx2_no_view_node, "Users/root.homeDir") == NULL)
+
+    cfx2_release_view(&view);
+    tests_assert(view == NULL)
+    cfx2_release_node(&doc);
+
+    /* damaged documents */
+    data = tests_read_file(view_filename, &size);
+
+    tests_assert(cfx2_open_view_from_memory(&view, data, 16) == cfx2_bad_format)
+    tests_assert(cfx2_open_view_from_memory(&view, text_document, strlen(text_document)) == cfx2_bad_format)
+
+    /* every node's children start at the document: no walk may loop */
+    num_nodes = (unsigned char) data[8] | (unsigned char) data[9] << 8 | (unsigned char) data[10] << 16;
+
+    for (i = 0; i < num_nodes; i++)
+        memset(data + 32 + i * 24 + 8, 0, 4);
+
+    tests_assert(cfx2_open_view_from_memory(&view, data, size) == cfx2_ok)
+    tests_assert(walk_all(view, cfx2_view_root) == 1)
+    tests_assert(cfx2_view_query_value(view, cfx2_view_root, "**.homeDir") == NULL)
+    cfx2_release_view(&view);
+
+    /* strings out of the file */
+    memset(data + 32, 0x7F, size - 32);
+    tests_assert(cfx2_open_view_from_memory(&view, data, size) == cfx2_ok)
+    tests_assert(walk_all(view, cfx2_view_root) == 1)
+    tests_assert(cfx2_view_query_value(view, cfx2_view_root, "**/root.homeDir") == NULL)
+    cfx2_release_view(&view);
+
+    free(data);
+
+    /* a view is ready at once; the tree has to be read first */
+    doc = cfx2_new_node(NULL);
+
+    for (i = 0; i < wide_count; i++)
+    {
+        sprintf(name, "node%i", (int) i);
+        node = cfx2_create_child(doc, name, NULL, cfx2_multiple);
+        tests_assert(node != NULL)
+        tests_assert(cfx2_set_node_attrib_int(node, "index", (long) i) == cfx2_ok)
+    }
+
+    tests_assert(cfx2_save_binary(doc, view_filename) == cfx2_ok)
+    cfx2_release_node(&doc);
+
+    tests_perf_start(&perf);
+    tests_assert(cfx2_load_binary(&doc, view_filename, NULL) == cfx2_ok)
+    tests_assert(strcmp(cfx2_query_value(doc, "node199999.index"), "199999") == 0)
+    tests_perf_end(&perf, "load and query");
+    cfx2_release_node(&doc);
+
+    tests_perf_start(&perf);
+    tests_assert(cfx2_open_view(&view, view_filename) == cfx2_ok)
+    tests_assert(strcmp(cfx2_view_query_value(view, cfx2_view_root, "node199999.index"), "199999") == 0)
+    tests_perf_end(&perf, "open view and query");
+    cfx2_release_view(&view);
+
+    remove(view_filename);
+
+    return 0;
+}
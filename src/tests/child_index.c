@@ -0,0 +1,187 @@
+
+#include "tests.h"
+
+#include <string.h>
+
+#define child_count     500
+#define operation_count 20000
+#define wide_count      4000
+#define wide_children   40
+
+/* what cfx2_find_child returned before there was an index */
+static cfx2_Node* find_child_linear(cfx2_Node* parent, const char* name)
+{
+    size_t i;
+
+    for (i = 0; i < cfx2_list_length(parent->children); i++)
+        if (strcmp(cfx2_item(parent->children, i, cfx2_Node*)->name, name) == 0)
+            return cfx2_item(parent->children, i, cfx2_Node*);
+
+    return NULL;
+}
+
+static void random_name(char* name)
+{
+    /* few enough names to get plenty of duplicates */
+    sprintf(name, "n%i", rand() % (child_count / 4));
+}
+
+static void check_lookups(cfx2_Node* parent)
+{
+    char name[16];
+    int i;
+
+    for (i = 0; i < child_count / 4 + 1; i++)
+    {
+        sprintf(name, "n%i", i);
+        tests_assert(cfx2_find_child(parent, name) == find_child_linear(parent, name))
+    }
+}
+
+static void exercise(cfx2_Node* parent)
+{
+    cfx2_Node* child;
+    char name[16];
+    size_t length;
+    int i;
+
+    for (i = 0; i < child_count; i++)
+    {
+        random_name(name);
+        tests_assert(cfx2_create_child(parent, name, NULL, cfx2_multiple) != NULL)
+    }
+
+    check_lookups(parent);
+    tests_assert(parent->child_index != NULL)
+
+    for (i = 0; i < operation_count; i++)
+    {
+        length = cfx2_list_length(parent->children);
+        random_name(name);
+
+        switch (rand() % 5)
+        {
+            case 0:
+                tests_assert(cfx2_add_child(parent, cfx2_new_node(name)) == cfx2_ok)
+                break;
+
+            case 1:
+                tests_assert(cfx2_insert_child(parent, rand() % (length + 1), cfx2_new_node(name)) == cfx2_ok)
+                break;
+
+            case 2:
+                if (length == 0)
+                    break;
+
+                child = cfx2_item(parent->children, rand() % length, cfx2_Node*);
+                tests_assert(cfx2_remove_child(parent, child) == cfx2_ok)
+                tests_assert(child->index_parent == NULL)
+                cfx2_release_node(&child);
+                break;
+
+            case 3:
+                if (length == 0)
+                    break;
+
+                child = cfx2_item(parent->children, rand() % length, cfx2_Node*);
+                tests_assert(cfx2_rename_node(child, name) == cfx2_ok)
+                break;
+
+            case 4:
+                child = cfx2_create_child(parent, name, NULL, cfx2_unique);
+                tests_assert(child != NULL && child == find_child_linear(parent, name))
+                break;
+        }
+
+        tests_assert(cfx2_find_child(parent, name) == find_child_linear(parent, name))
+
+        if (i % 1000 == 0)
+            check_lookups(parent);
+    }
+
+    check_lookups(parent);
+}
+
+/* wide nodes come out of the reader indexed, so lookups never have to build anything */
+static void check_read(unsigned num_threads)
+{
+    cfx2_Node* doc, * node;
+    cfx2_RdOpt rd_opt;
+    char* text, * p, name[16];
+    int i, j;
+
+    text = (char*) malloc(wide_count * (16 + wide_children * 16) + 1);
+    tests_assert(text != NULL)
+
+    for (p = text, i = 0; i < wide_count; i++)
+    {
+        p += sprintf(p, "parent%i\n", i);
+
+        for (j = 0; j < wide_children; j++)
+            p += sprintf(p, "  c%i\n", j);
+    }
+
+    memset(&rd_opt, 0, sizeof(rd_opt));
+    rd_opt.flags = (num_threads > 1) ? cfx2_parallel_input : 0;
+    rd_opt.num_threads = num_threads;
+
+    tests_assert(cfx2_read_from_string(&doc, text, &rd_opt) == cfx2_ok)
+    tests_assert(doc->child_index != NULL)
+
+    for (i = 0; i < wide_count; i++)
+    {
+        node = cfx2_item(doc->children, i, cfx2_Node*);
+        tests_assert(node->child_index != NULL && node->index_parent == doc)
+    }
+
+    check_lookups(doc);
+    sprintf(name, "parent%i", wide_count - 1);
+    tests_assert(cfx2_find_child(doc, name) == find_child_linear(doc, name))
+    tests_assert(cfx2_find_child(cfx2_find_child(doc, name), "c7") != NULL)
+
+    /* renaming keeps the index the reader built in sync */
+    tests_assert(cfx2_rename_node(cfx2_find_child(doc, name), "renamed") == cfx2_ok)
+    tests_assert(cfx2_find_child(doc, name) == NULL && cfx2_find_child(doc, "renamed") != NULL)
+
+    cfx2_release_node(&doc);
+    free(text);
+}
+
+int child_index(void)
+{
+    cfx2_Node* doc, * node;
+    cfx2_RdOpt rd_opt;
+    int rc;
+
+    srand(0);
+
+    doc = cfx2_new_node(NULL);
+    tests_assert(doc != NULL)
+
+    exercise(doc);
+    cfx2_release_node(&doc);
+
+    /* arena documents keep their index in the arena */
+    rd_opt.client_priv = NULL;
+    rd_opt.on_error = NULL;
+    rd_opt.flags = cfx2_arena_document;
+
+    rc = cfx2_read_from_string(&doc, "Root\n", &rd_opt);
+    tests_assert(rc == cfx2_ok && doc->arena != NULL)
+
+    node = cfx2_find_child(doc, "Root");
+    tests_assert(node != NULL)
+
+    exercise(node);
+    cfx2_release_node(&doc);
+
+    check_read(1);
+    check_read(4);
+
+    /* a narrow node stays unindexed, lookups don't change that */
+    tests_assert(cfx2_read_from_string(&doc, "a\nb\nc\n", NULL) == cfx2_ok)
+    tests_assert(cfx2_find_child(doc, "b") != NULL && doc->child_index == NULL)
+    cfx2_release_node(&doc);
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+
+#include "tests.h"
+
+#include "usertable.h"
+
+#include <string.h>
+
+#define edit_rounds     20
+
+static size_t held_bytes(const cfx2_DocumentStats* stats)
+{
+    tests_assert(stats->wasted_bytes == stats->list_slack + stats->buffer_slack + stats->dead_bytes)
+    return stats->used_bytes + stats->index_bytes + stats->wasted_bytes;
+}
+
+/* the statistics account for every byte the document holds */
+static void check_held(cfx2_Node* doc, const char* what)
+{
+    cfx2_DocumentStats stats;
+    cfx2_MemoryStats memory;
+    size_t held;
+
+    tests_assert_2(cfx2_document_stats(doc, &stats) == cfx2_ok, what)
+    tests_assert_2(cfx2_get_memory_stats(cfx2_mem_total, &memory) == cfx2_ok, what)
+
+    /* shared strings are split among their users, rounding down */
+    held = held_bytes(&stats);
+    tests_assert_2(held <= memory.live_bytes && memory.live_bytes - held <= stats.attribs, what)
+}
+
+/* what a long-lived document goes through */
+static void edit(cfx2_Node* doc)
+{
+    cfx2_Node* users, * node, * child;
+    char text[64];
+    size_t i, round;
+
+    users = cfx2_find_child(doc, "Users");
+    tests_assert(users != NULL)
+
+    for (round = 0; round < edit_rounds; round++)
+    {
+        for (i = 0; i < cfx2_list_length(users->children); i++)
+        {
+            node = cfx2_item(users->children, i, cfx2_Node*);
+
+            sprintf(text, "%s, edited %i times", node->name, (int) round);
+            tests_assert(cfx2_set_node_text(node, text) == cfx2_ok)
+            tests_assert(cfx2_set_node_attrib_int(node, "lastLogin", (long) (round * 1000 + i)) == cfx2_ok)
+            tests_assert(cfx2_set_node_attrib(node, "homeDir", round % 2 ? "/home/elsewhere" : "/home") == cfx2_ok)
+
+            child = cfx2_create_child(node, "session", text, cfx2_multiple);
+            tests_assert(child != NULL)
+            tests_assert(cfx2_set_node_attrib(child, "temporary", "1") == cfx2_ok)
+
+            /* sessions come and go, one is left */
+            if (round + 1 < edit_rounds)
+            {
+                tests_assert(cfx2_remove_child(node, child) == cfx2_ok)
+                cfx2_release_node(&child);
+            }
+        }
+
+        tests_assert(cfx2_remove_attrib(cfx2_find_child(users, "root"), "lastLogin") == cfx2_ok)
+
+        node = cfx2_find_child(users, round % 2 ? "visitor" : "guest");
+        tests_assert(node != NULL)
+        tests_assert(cfx2_rename_node(node, round % 2 ? "guest" : "visitor") == cfx2_ok)
+    }
+}
+
+int compact(void)
+{
+    cfx2_DocumentStats before, after;
+    cfx2_Node* doc, * node;
+    cfx2_RdOpt rd_opt;
+    char* expected, * output;
+
+    tests_assert(cfx2_document_stats(NULL, &before) == cfx2_param_invalid)
+    tests_assert(cfx2_compact(NULL) == cfx2_param_invalid)
+
+    tests_assert(cfx2_enable_memory_stats(1) == cfx2_ok)
+
+    /* as read */
+    tests_assert(cfx2_read_file(&doc, usertable_filename, NULL) == cfx2_ok)
+    check_held(doc, "read");
+
+    tests_assert(cfx2_document_stats(doc, &before) == cfx2_ok)
+    tests_assert(before.nodes == 13 && before.attribs == 32)
+    tests_assert(before.used_bytes > 0 && before.dead_bytes == 0)
+
+    tests_assert(cfx2_compact(doc) == cfx2_ok)
+    check_held(doc, "compacted after reading");
+
+    tests_assert(cfx2_document_stats(doc, &after) == cfx2_ok)
+    tests_assert(after.nodes == before.nodes && after.attribs == before.attribs)
+    tests_assert(after.wasted_bytes == 0)
+    tests_assert(held_bytes(&after) < held_bytes(&before))
+
+    /* edited */
+    edit(doc);
+    check_held(doc, "edited");
+
+    tests_assert(cfx2_document_stats(doc, &before) == cfx2_ok)
+    tests_assert(before.dead_bytes > 0 && before.list_slack > 0)
+
+    expected = tests_serialize(doc, NULL);
+    tests_assert(cfx2_compact(doc) == cfx2_ok)
+    check_held(doc, "compacted after editing");
+
+    tests_assert(cfx2_document_stats(doc, &after) == cfx2_ok)
+    tests_assert(after.nodes == before.nodes && after.attribs == before.attribs)
+    tests_assert(after.wasted_bytes == 0)
+    tests_assert(held_bytes(&after) < held_bytes(&before))
+
+    output = tests_serialize(doc, NULL);
+    tests_assert(strcmp(output, expected) == 0)
+    free(output);
+
+    /* and it can still be edited */
+    edit(doc);
+    tests_assert(cfx2_compact(doc) == cfx2_ok)
+    check_held(doc, "compacted again");
+
+    /* a subtree taken out keeps its strings */
+    node = cfx2_find_child(cfx2_find_child(doc, "Users"), "randuser3");
+    tests_assert(cfx2_remove_child(cfx2_find_child(doc, "Users"), node) == cfx2_ok)
+    tests_assert(cfx2_compact(node) == cfx2_ok)
+    tests_assert(strcmp(node->name, "randuser3") == 0)
+    tests_assert(strcmp(cfx2_find_child(node, "session")->text, "randuser3, edited 19 times") == 0)
+    cfx2_release_node(&node);
+
+    cfx2_release_node(&doc);
+    free(expected);
+
+    /* arena documents are measured, but left as they are */
+    memset(&rd_opt, 0, sizeof(rd_opt));
+    rd_opt.flags = cfx2_arena_document;
+
+    tests_assert(cfx2_read_file(&doc, usertable_filename, &rd_opt) == cfx2_ok)
+    check_held(doc, "arena");
+
+    tests_assert(cfx2_document_stats(doc, &before) == cfx2_ok)
+    tests_assert(before.nodes == 13 && before.attribs == 32)
+    tests_assert(before.buffer_slack > 0)
+
+    edit(doc);
+    check_held(doc, "edited arena");
+
+    tests_assert(cfx2_compact(doc) == cfx2_ok)
+    tests_assert(cfx2_document_stats(doc, &after) == cfx2_ok)
+    tests_assert(after.dead_bytes > 0)
+
+    cfx2_release_node(&doc);
+
+    tests_assert(cfx2_enable_memory_stats(0) == cfx2_ok)
+
+    return 0;
+}
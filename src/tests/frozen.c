@@ -0,0 +1,171 @@
+
+#include "tests.h"
+
+#include "usertable.h"
+
+#include <string.h>
+
+#define generated_count     20000
+
+static int same_string(const char* a, const char* b)
+{
+    return (a == NULL) ? (b == NULL) : (b != NULL && strcmp(a, b) == 0);
+}
+
+/* node and the frozen node agree, and everything below them, in document order */
+static void compare(const cfx2_Frozen* frozen, cfx2_Node* node, cfx2_FrozenNode* index)
+{
+    const cfx2_Attrib* attrib;
+    const char* name, * value;
+    cfx2_FrozenNode self, child;
+    size_t i;
+
+    self = (*index)++;
+
+    tests_assert(same_string(cfx2_frozen_name(frozen, self), node->name))
+    tests_assert(same_string(cfx2_frozen_text(frozen, self), node->text))
+    tests_assert(cfx2_frozen_num_attribs(frozen, self) == cfx2_list_length(node->attributes))
+
+    for (i = 0; i < cfx2_list_length(node->attributes); i++)
+    {
+        attrib = &cfx2_item(node->attributes, i, cfx2_Attrib);
+
+        tests_assert(cfx2_frozen_attrib(frozen, self, i, &name, &value) == cfx2_ok)
+        tests_assert(strcmp(name, attrib->name) == 0 && same_string(value, attrib->value))
+
+        tests_assert(cfx2_frozen_find_attrib(frozen, self, attrib->name, &value) == cfx2_ok)
+        tests_assert(same_string(value, cfx2_find_attrib(node, attrib->name)->value))
+    }
+
+    tests_assert(cfx2_frozen_attrib(frozen, self, i, &name, &value) == cfx2_attrib_not_found)
+
+    /* the first child comes right after its parent */
+    child = cfx2_frozen_first_child(frozen, self);
+    tests_assert(cfx2_list_length(node->children) == 0 ? child == cfx2_no_frozen_node : child == self + 1)
+
+    for (i = 0; i < cfx2_list_length(node->children); i++)
+    {
+        tests_assert(child == *index)
+        compare(frozen, cfx2_item(node->children, i, cfx2_Node*), index);
+
+        tests_assert(cfx2_frozen_find_child(frozen, self, cfx2_frozen_name(frozen, child))
+                == cfx2_frozen_find_child(frozen, self, cfx2_item(node->children, i, cfx2_Node*)->name))
+
+        child = cfx2_frozen_next_sibling(frozen, child);
+    }
+
+    tests_assert(child == cfx2_no_frozen_node)
+}
+
+static void check_frozen(cfx2_Node* doc, const char* what)
+{
+    cfx2_Frozen* frozen;
+    cfx2_FrozenNode index;
+    cfx2_RdOpt rd_opt;
+    cfx2_Node* thawed;
+    char* expected, * output;
+    tests_Perf perf;
+    int arena;
+
+    tests_perf_start(&perf);
+    tests_assert_2(cfx2_freeze(&frozen, doc) == cfx2_ok, what)
+    tests_perf_end(&perf, "freeze");
+
+    index = cfx2_frozen_root;
+    compare(frozen, doc, &index);
+    tests_assert_2(index == cfx2_frozen_num_nodes(frozen), what)
+
+    /* and back, into heap and arena documents */
+    expected = tests_serialize(doc, NULL);
+
+    for (arena = 0; arena < 2; arena++)
+    {
+        memset(&rd_opt, 0, sizeof(rd_opt));
+        rd_opt.flags = arena ? cfx2_arena_document : 0;
+
+        tests_perf_start(&perf);
+        tests_assert_2(cfx2_thaw(&thawed, frozen, &rd_opt) == cfx2_ok, what)
+        tests_perf_end(&perf, "thaw");
+
+        output = tests_serialize(thawed, NULL);
+        tests_assert_2(strcmp(output, expected) == 0, what)
+        free(output);
+
+        index = cfx2_frozen_root;
+        compare(frozen, thawed, &index);
+
+        cfx2_release_node(&thawed);
+    }
+
+    free(expected);
+    cfx2_release_frozen(&frozen);
+    tests_assert(frozen == NULL)
+}
+
+int frozen(void)
+{
+    cfx2_Frozen* frozen;
+    cfx2_FrozenNode users, root;
+    cfx2_Node* doc, * thawed;
+    const char* value;
+
+    tests_assert(cfx2_freeze(NULL, NULL) == cfx2_param_invalid)
+    tests_assert(cfx2_thaw(&doc, NULL, NULL) == cfx2_param_invalid)
+    tests_assert(cfx2_frozen_num_nodes(NULL) == 0)
+    tests_assert(cfx2_frozen_name(NULL, cfx2_frozen_root) == NULL)
+    tests_assert(cfx2_frozen_first_child(NULL, cfx2_frozen_root) == cfx2_no_frozen_node)
+
+    /* lookups */
+    tests_assert(cfx2_read_file(&doc, usertable_filename, NULL) == cfx2_ok)
+    tests_assert(cfx2_freeze(&frozen, doc) == cfx2_ok)
+
+    users = cfx2_frozen_find_child(frozen, cfx2_frozen_root, "Users");
+    tests_assert(users != cfx2_no_frozen_node)
+    tests_assert(cfx2_frozen_find_child(frozen, cfx2_frozen_root, "Use") == cfx2_no_frozen_node)
+    tests_assert(cfx2_frozen_find_child(frozen, cfx2_frozen_num_nodes(frozen), "Users") == cfx2_no_frozen_node)
+
+    root = cfx2_frozen_find_child(frozen, users, "root");
+    tests_assert(root != cfx2_no_frozen_node)
+    tests_assert(cfx2_frozen_find_attrib(frozen, root, "homeDir", &value) == cfx2_ok && strcmp(value, "/root") == 0)
+    tests_assert(cfx2_frozen_find_attrib(frozen, root, "homeDi", &value) == cfx2_attrib_not_found)
+    tests_assert(cfx2_frozen_num_attribs(frozen, cfx2_no_frozen_node) == 0)
+
+    /* independent of the document it came from */
+    cfx2_release_node(&doc);
+    tests_assert(strcmp(cfx2_frozen_name(frozen, root), "root") == 0)
+    cfx2_release_frozen(&frozen);
+
+    tests_assert(cfx2_read_file(&doc, usertable_filename, NULL) == cfx2_ok)
+    check_frozen(doc, "usertable");
+
+    /* the document's own name, text and attributes are kept too */
+    tests_assert(cfx2_rename_node(doc, "document") == cfx2_ok)
+    tests_assert(cfx2_set_node_text(doc, "text") == cfx2_ok)
+    tests_assert(cfx2_set_node_attrib(doc, "version", "2") == cfx2_ok)
+    check_frozen(doc, "document attributes");
+
+    tests_assert(cfx2_freeze(&frozen, doc) == cfx2_ok)
+    tests_assert(cfx2_thaw(&thawed, frozen, NULL) == cfx2_ok)
+    tests_assert(strcmp(thawed->name, "document") == 0 && strcmp(thawed->text, "text") == 0)
+    tests_assert(cfx2_get_node_attrib(thawed, "version", &value) == cfx2_ok && strcmp(value, "2") == 0)
+    cfx2_release_node(&thawed);
+    cfx2_release_frozen(&frozen);
+
+    /* nodes without a name can't be written, nor frozen */
+    tests_assert(cfx2_create_child(cfx2_find_child(doc, "Users"), "", NULL, cfx2_multiple) != NULL)
+    tests_assert(cfx2_freeze(&frozen, doc) == cfx2_missing_node_name)
+    tests_assert(frozen == NULL)
+    cfx2_release_node(&doc);
+
+    /* empty and many */
+    doc = cfx2_new_node(NULL);
+    tests_assert(doc != NULL)
+    check_frozen(doc, "empty");
+    cfx2_release_node(&doc);
+
+    doc = tests_build_doc(generated_count);
+    check_frozen(doc, "generated");
+    cfx2_release_node(&doc);
+
+    return 0;
+}
@@ -0,0 +1,214 @@
+
+#include "tests.h"
+
+#include "../lexer.h"
+
+#include <string.h>
+
+#define max_padding     40
+#define max_length      40
+#define max_tokens      16
+#define max_document    (max_padding + max_length + 8)
+
+typedef struct
+{
+    TokenType type;
+    unsigned short indent;
+    int line;
+    size_t offset, length;
+}
+Lexed;
+
+typedef struct
+{
+    Lexed tokens[max_tokens];
+    size_t count;
+    unsigned line;
+    int rc;
+}
+Lexing;
+
+static int ignore_error(cfx2_RdOpt* rd_opt, int rc, int line, const char* desc)
+{
+    (void) rd_opt;
+    (void) rc;
+    (void) line;
+    (void) desc;
+
+    return 0;
+}
+
+/*
+ *  one_by_one: the input grows a byte at a time, so there are never VEC_SIZE bytes to scan
+ *  and only the scalar loops run; otherwise the whole document is there from the start.
+ */
+static void lex(const char* doc, size_t length, int one_by_one, Lexing* out)
+{
+    cfx2_RdOpt rd_opt;
+    Lexer lexer;
+    Token* token;
+    size_t available;
+    int rc;
+
+    memset(&rd_opt, 0, sizeof(rd_opt));
+    rd_opt.document = doc;
+    rd_opt.document_len = length;
+    rd_opt.on_error = ignore_error;
+
+    tests_assert(create_lexer(&lexer, &rd_opt) == cfx2_ok)
+
+    available = one_by_one ? 0 : length;
+    lexer_set_input(&lexer, doc, available, available == length);
+
+    out->count = 0;
+
+    for (;;)
+    {
+        rc = lexer_read(&lexer, &token);
+
+        if (rc == lexer_need_input)
+        {
+            tests_assert(available < length)
+            available++;
+            lexer_set_input(&lexer, doc, available, available == length);
+            continue;
+        }
+
+        if (rc != cfx2_ok)
+            break;
+
+        tests_assert(out->count < max_tokens)
+        out->tokens[out->count].type = token->type;
+        out->tokens[out->count].indent = token->indent;
+        out->tokens[out->count].line = token->line;
+        out->tokens[out->count].offset = 0;
+        out->tokens[out->count].length = 0;
+
+        /* symbols don't set the text */
+        if (token->type == T_text || token->type == T_string)
+        {
+            out->tokens[out->count].offset = token->text - doc;
+            out->tokens[out->count].length = token->length;
+        }
+
+        out->count++;
+    }
+
+    out->line = lexer.line;
+    out->rc = rc;
+}
+
+/* whitespace with newlines and tabs, so that lines and indentation are counted across it */
+static size_t pad(char* p, size_t length)
+{
+    static const char pattern[] = "  \n\t \n    \r\n \t   \n";
+    size_t i;
+
+    for (i = 0; i < length; i++)
+        p[i] = pattern[i % (sizeof(pattern) - 1)];
+
+    return length;
+}
+
+/* a token of kind 0-4 spanning exactly length bytes (length >= 2) */
+static size_t token(char* p, int kind, size_t length)
+{
+    static const char ident_chars[] = "abcXYZ019_-~!@#$%";
+    size_t i;
+
+    switch (kind)
+    {
+        case 0:
+            for (i = 0; i < length; i++)
+                p[i] = ident_chars[i % (sizeof(ident_chars) - 1)];
+            break;
+
+        case 1:
+        case 2:
+            /* escapes (of the quote too) land on every offset as the length changes */
+            p[0] = (kind == 1) ? '\'' : '"';
+
+            for (i = 1; i + 1 < length; i++)
+                p[i] = (i % 5 == 3 && i + 2 < length) ? '\\' : (i % 5 == 4) ? p[0] : 'a' + i % 26;
+
+            p[length - 1] = p[0];
+            break;
+
+        case 3:
+            p[0] = '{';
+
+            for (i = 1; i + 1 < length; i++)
+                p[i] = (i % 4 == 0) ? '\n' : (i % 7 == 0) ? '{' : 'x';
+
+            p[length - 1] = '}';
+            break;
+
+        case 4:
+            /* an unterminated string runs to the end of the input */
+            p[0] = '\'';
+
+            for (i = 1; i < length; i++)
+                p[i] = (i % 6 == 0) ? '\n' : 'q';
+            break;
+    }
+
+    return length;
+}
+
+static void compare(const char* doc, size_t length)
+{
+    Lexing vectors, scalar;
+    size_t i;
+
+    lex(doc, length, 0, &vectors);
+    lex(doc, length, 1, &scalar);
+
+    tests_assert_2(vectors.rc == scalar.rc, doc)
+    tests_assert_2(vectors.count == scalar.count, doc)
+    tests_assert_2(vectors.line == scalar.line, doc)
+
+    for (i = 0; i < vectors.count; i++)
+    {
+        tests_assert_2(vectors.tokens[i].type == scalar.tokens[i].type, doc)
+        tests_assert_2(vectors.tokens[i].indent == scalar.tokens[i].indent, doc)
+        tests_assert_2(vectors.tokens[i].line == scalar.tokens[i].line, doc)
+        tests_assert_2(vectors.tokens[i].offset == scalar.tokens[i].offset, doc)
+        tests_assert_2(vectors.tokens[i].length == scalar.tokens[i].length, doc)
+    }
+}
+
+int lexer_vectors(void)
+{
+    static const char* tails[] = { "", " x: 'y'\n", "\n(a)", "}" };
+
+    char doc[max_document + 1];
+    size_t padding, length, tail, end;
+    int kind;
+
+    /*
+     *  Every kind of token ending at every offset up to max_padding + max_length
+     *  (15-17 and 31-33 among them, around 16- and 32-byte blocks), followed by more
+     *  input or by the end of the buffer.
+     */
+    for (kind = 0; kind < 5; kind++)
+        for (padding = 0; padding <= max_padding; padding++)
+            for (length = 2; length <= max_length; length++)
+                for (tail = 0; tail < sizeof(tails) / sizeof(*tails); tail++)
+                {
+                    end = pad(doc, padding);
+                    end += token(doc + end, kind, length);
+                    strcpy(doc + end, tails[tail]);
+
+                    compare(doc, end + strlen(tails[tail]));
+                }
+
+    /* whitespace alone, ending anywhere */
+    for (length = 0; length <= max_document; length++)
+    {
+        pad(doc, length);
+        doc[length] = 0;
+        compare(doc, length);
+    }
+
+    return 0;
+}
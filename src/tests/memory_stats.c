@@ -0,0 +1,148 @@
+
+#include "tests.h"
+
+#include "usertable.h"
+
+#include <string.h>
+
+static size_t live_bytes(int category)
+{
+    cfx2_MemoryStats stats;
+
+    tests_assert(cfx2_get_memory_stats(category, &stats) == cfx2_ok)
+    return stats.live_bytes;
+}
+
+/* nothing the library allocated for itself is left over */
+static void check_scratch_released(const char* what)
+{
+    tests_assert_2(live_bytes(cfx2_mem_input) == 0, what)
+    tests_assert_2(live_bytes(cfx2_mem_parser) == 0, what)
+    tests_assert_2(live_bytes(cfx2_mem_output) == 0, what)
+    tests_assert_2(live_bytes(cfx2_mem_query) == 0, what)
+}
+
+static void check_document_released(const char* what)
+{
+    int category;
+
+    for (category = 0; category < cfx2_mem_categories; category++)
+        tests_assert_2(live_bytes(category) == 0, what)
+
+    tests_assert_2(live_bytes(cfx2_mem_total) == 0, what)
+}
+
+static void check_totals(void)
+{
+    cfx2_MemoryStats stats, total;
+    size_t allocs, live;
+    int category;
+
+    allocs = 0;
+    live = 0;
+
+    for (category = 0; category < cfx2_mem_categories; category++)
+    {
+        tests_assert(cfx2_get_memory_stats(category, &stats) == cfx2_ok)
+        tests_assert(stats.peak_bytes >= stats.live_bytes)
+        allocs += stats.allocs;
+        live += stats.live_bytes;
+    }
+
+    tests_assert(cfx2_get_memory_stats(cfx2_mem_total, &total) == cfx2_ok)
+    tests_assert(total.allocs == allocs)
+    tests_assert(total.live_bytes == live)
+}
+
+int memory_stats(void)
+{
+    cfx2_MemoryStats stats;
+    cfx2_RdOpt rd_opt;
+    cfx2_Node* doc;
+    char* text, * document;
+    size_t capacity, used, i;
+
+    tests_assert(cfx2_get_memory_stats(-1, &stats) == cfx2_param_invalid)
+    tests_assert(cfx2_get_memory_stats(cfx2_mem_total + 1, &stats) == cfx2_param_invalid)
+
+    tests_assert(cfx2_enable_memory_stats(1) == cfx2_ok)
+    check_document_released("nothing allocated yet");
+
+    /* reading */
+    tests_assert(cfx2_read_file(&doc, usertable_filename, NULL) == cfx2_ok)
+
+    tests_assert(live_bytes(cfx2_mem_node) > 0)
+    tests_assert(live_bytes(cfx2_mem_list) > 0)
+    tests_assert(live_bytes(cfx2_mem_string) > 0)
+    check_scratch_released("read");
+    check_totals();
+
+    tests_assert(cfx2_get_memory_stats(cfx2_mem_parser, &stats) == cfx2_ok)
+    tests_assert(stats.allocs > 0 && stats.frees > 0 && stats.peak_bytes > 0)
+
+    /* writing; the buffer belongs to the caller */
+    text = NULL;
+    capacity = 0;
+    used = 0;
+
+    tests_assert(cfx2_write_to_buffer(doc, &text, &capacity, &used) == cfx2_ok)
+    check_scratch_released("write");
+
+    tests_assert(cfx2_get_memory_stats(cfx2_mem_output, &stats) == cfx2_ok)
+    tests_assert(stats.allocs + stats.reallocs > 0)
+
+    /* resetting keeps what is live */
+    cfx2_reset_memory_stats();
+    tests_assert(cfx2_get_memory_stats(cfx2_mem_node, &stats) == cfx2_ok)
+    tests_assert(stats.allocs == 0 && stats.frees == 0 && stats.live_blocks > 0)
+    tests_assert(stats.peak_bytes == stats.live_bytes)
+
+    cfx2_release_node(&doc);
+    check_document_released("release");
+
+    tests_assert(cfx2_get_memory_stats(cfx2_mem_node, &stats) == cfx2_ok)
+    tests_assert(stats.frees > 0 && stats.live_blocks == 0)
+
+    /* queries and parallel reading */
+    document = (char*) malloc(used * 20 + 1);
+    tests_assert(document != NULL)
+
+    for (i = 0; i < 20; i++)
+        memcpy(document + i * used, text, used);
+
+    document[used * 20] = 0;
+
+    memset(&rd_opt, 0, sizeof(rd_opt));
+    rd_opt.flags = cfx2_parallel_input;
+    rd_opt.num_threads = 4;
+
+    tests_assert(cfx2_read_from_string(&doc, document, &rd_opt) == cfx2_ok)
+    check_scratch_released("parallel read");
+
+    tests_assert(strcmp(cfx2_query_value(doc, "Users/root.homeDir"), "/root") == 0)
+    check_scratch_released("query");
+    check_totals();
+
+    cfx2_release_node(&doc);
+    check_document_released("release");
+
+    /* arenas */
+    rd_opt.flags = cfx2_arena_document;
+
+    tests_assert(cfx2_read_from_string(&doc, document, &rd_opt) == cfx2_ok)
+    tests_assert(live_bytes(cfx2_mem_arena) > 0)
+    check_scratch_released("arena read");
+
+    cfx2_release_node(&doc);
+    check_document_released("arena release");
+
+    free(document);
+    free(text);
+
+    /* disabling forgets everything */
+    tests_assert(cfx2_enable_memory_stats(0) == cfx2_ok)
+    tests_assert(cfx2_get_memory_stats(cfx2_mem_total, &stats) == cfx2_ok)
+    tests_assert(stats.allocs == 0 && stats.live_bytes == 0)
+
+    return 0;
+}
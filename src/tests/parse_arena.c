@@ -0,0 +1,82 @@
+
+#include "tests.h"
+
+#include <string.h>
+
+#define arena_filename  "usertable.cfx2"
+
+int parse_arena(void)
+{
+    cfx2_Node* doc, * arena_doc, * node;
+    cfx2_RdOpt rd_opt;
+    char* expected, * text;
+    size_t expected_len, used;
+    const char* value;
+
+    int rc;
+
+    doc = cfx2_load_document(arena_filename);
+    tests_assert(doc != NULL)
+
+    expected = tests_serialize(doc, &expected_len);
+
+    rd_opt.client_priv = NULL;
+    rd_opt.on_error = NULL;
+    rd_opt.flags = cfx2_arena_document;
+
+    rc = cfx2_read_file(&arena_doc, arena_filename, &rd_opt);
+
+    if (rc != cfx2_ok)
+        tests_fail(("failed to load '%s' into an arena: %s", arena_filename, cfx2_get_error_desc(rc)))
+
+    tests_assert(arena_doc->arena != NULL)
+
+    text = tests_serialize(arena_doc, &used);
+    tests_assert(used == expected_len && memcmp(text, expected, used) == 0)
+    free(text);
+
+    /* modifications allocate from the arena or are adopted by it */
+    node = cfx2_item(arena_doc->children, 0, cfx2_Node*);
+    tests_assert(node->arena == arena_doc->arena)
+
+    tests_assert(cfx2_rename_node(node, "Renamed") == cfx2_ok)
+    tests_assert(cfx2_set_node_attrib(node, "added", "value") == cfx2_ok)
+    tests_assert(cfx2_set_node_attrib(node, "added", "changed") == cfx2_ok)
+    tests_assert(cfx2_create_child(node, "Created", "text", cfx2_unique) != NULL)
+    tests_assert(cfx2_add_child(node, cfx2_new_node("Adopted")) == cfx2_ok)
+    tests_assert(cfx2_query_node(arena_doc, "Renamed/Queried/Deep", 1) != NULL)
+
+    value = cfx2_query_value(arena_doc, "Renamed.added");
+    tests_assert(value != NULL && strcmp(value, "changed") == 0)
+
+    value = cfx2_query_value(arena_doc, "Renamed/Created");
+    tests_assert(value != NULL && strcmp(value, "text") == 0)
+
+    /* a removed heap node belongs to the caller again */
+    node = cfx2_new_node("Removed");
+    tests_assert(cfx2_add_child(arena_doc, node) == cfx2_ok)
+    tests_assert(cfx2_remove_child(arena_doc, node) == cfx2_ok)
+    cfx2_release_node(&node);
+
+    /* a removed arena node can only go back into its own document */
+    node = cfx2_find_child(arena_doc, "Renamed");
+    tests_assert(node != NULL && cfx2_remove_child(arena_doc, node) == cfx2_ok)
+    tests_assert(cfx2_add_child(doc, node) == cfx2_param_invalid)
+    tests_assert(cfx2_insert_child(doc, 0, node) == cfx2_param_invalid)
+    tests_assert(cfx2_find_child(doc, "Renamed") == NULL)
+
+    tests_assert(cfx2_insert_child(cfx2_item(arena_doc->children, 0, cfx2_Node*), 0, node) == cfx2_ok)
+    tests_assert(cfx2_remove_child(cfx2_item(arena_doc->children, 0, cfx2_Node*), node) == cfx2_ok)
+    tests_assert(cfx2_insert_child(arena_doc, 0, node) == cfx2_ok)
+
+    /* releasing an arena node other than the root does nothing */
+    node = cfx2_query_node(arena_doc, "Renamed/Created", 0);
+    tests_assert(node != NULL && node->arena == arena_doc->arena)
+    cfx2_release_node(&node);
+
+    cfx2_release_node(&arena_doc);
+    cfx2_release_node(&doc);
+    free(expected);
+
+    return 0;
+}
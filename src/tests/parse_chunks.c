@@ -0,0 +1,108 @@
+
+#include "tests.h"
+
+#include <string.h>
+
+static const char* filenames[] =
+{
+    "menu.cfx2",
+    "usertable.cfx2",
+    "damaged1.cfx2",
+    "damaged2.cfx2",
+    "damaged3.cfx2",
+    "damaged4.cfx2",
+    NULL
+};
+
+/* chunk sizes used to split the input; 1 puts a chunk boundary inside every token */
+static const size_t chunk_sizes[] = { 1, 2, 3, 7, 64, 4096 };
+
+static int parse_in_chunks(cfx2_Node** doc_ptr, const char* data, size_t length, size_t chunk_size)
+{
+    cfx2_Parser* parser;
+    cfx2_RdOpt rd_opt;
+    size_t pos;
+    int rc;
+
+    rd_opt.client_priv = NULL;
+    rd_opt.on_error = &tests_parse_error;
+    rd_opt.flags = 0;
+
+    rc = cfx2_create_parser(&parser, &rd_opt);
+
+    if (rc != cfx2_ok)
+        tests_fail(("failed to create parser: %s", cfx2_get_error_desc(rc)))
+
+    for (pos = 0; pos < length && rc == cfx2_ok; pos += chunk_size)
+        rc = cfx2_parser_feed(parser, data + pos, (length - pos < chunk_size) ? length - pos : chunk_size);
+
+    if (rc == cfx2_ok)
+        rc = cfx2_parser_finish(parser, doc_ptr);
+
+    cfx2_release_parser(&parser);
+    tests_assert(parser == NULL)
+
+    return rc;
+}
+
+int parse_chunks(void)
+{
+    const char** p_filename;
+    size_t i;
+
+    for (p_filename = &filenames[0]; *p_filename != NULL; p_filename++)
+    {
+        cfx2_Node* expected_doc;
+        cfx2_RdOpt rd_opt;
+        char* data, * expected;
+        size_t length, expected_len;
+        int expected_rc;
+
+        data = tests_read_file(*p_filename, &length);
+
+        /* the whole-document reader is the reference */
+        rd_opt.client_priv = NULL;
+        rd_opt.on_error = &tests_parse_error;
+        rd_opt.flags = 0;
+
+        expected_rc = cfx2_read_from_string(&expected_doc, data, &rd_opt);
+        expected = NULL;
+        expected_len = 0;
+
+        if (expected_rc == cfx2_ok)
+        {
+            expected = tests_serialize(expected_doc, &expected_len);
+            cfx2_release_node(&expected_doc);
+        }
+
+        for (i = 0; i < sizeof(chunk_sizes) / sizeof(*chunk_sizes); i++)
+        {
+            cfx2_Node* doc;
+            char* text;
+            size_t used;
+            int rc;
+
+            rc = parse_in_chunks(&doc, data, length, chunk_sizes[i]);
+
+            if (rc != expected_rc)
+                tests_fail(("'%s' in chunks of %u: got '%s', expected '%s'", *p_filename, (unsigned) chunk_sizes[i],
+                        cfx2_get_error_desc(rc), cfx2_get_error_desc(expected_rc)))
+
+            if (rc != cfx2_ok)
+                continue;
+
+            text = tests_serialize(doc, &used);
+            cfx2_release_node(&doc);
+
+            if (used != expected_len || memcmp(text, expected, used) != 0)
+                tests_fail(("'%s' in chunks of %u: document differs", *p_filename, (unsigned) chunk_sizes[i]))
+
+            free(text);
+        }
+
+        free(expected);
+        free(data);
+    }
+
+    return 0;
+}
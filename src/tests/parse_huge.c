@@ -3,11 +3,40 @@
 
 #include "huge.h"
 
+#include <string.h>
+
+typedef struct
+{
+    int depth;
+    size_t top_level_nodes;
+}
+NodeCounter;
+
+static int count_begin_node(void* user, const char* name, size_t name_length)
+{
+    NodeCounter* counter = (NodeCounter*) user;
+
+    if (counter->depth++ == 0)
+        counter->top_level_nodes++;
+
+    return cfx2_continue;
+}
+
+static int count_end_node(void* user)
+{
+    ((NodeCounter*) user)->depth--;
+    return cfx2_continue;
+}
+
 int parse_huge(void)
 {
     cfx2_Node* doc;
+    cfx2_RdOpt rd_opt;
+    cfx2_ReadHandler handler;
+    NodeCounter counter;
     tests_Perf perf;
 
+    size_t i;
     int rc;
 
     tests_perf_start(&perf);
@@ -23,7 +52,94 @@ int parse_huge(void)
 
     tests_memory_usage_check();
 
+    /* the first lookup indexes the root's children */
+    tests_perf_start(&perf);
+
+    for (i = 0; i < huge_node_count; i += huge_node_count / 1000)
+    {
+        const char* name = cfx2_item(doc->children, i, cfx2_Node*)->name;
+        cfx2_Node* found = cfx2_find_child(doc, name);
+
+        tests_assert(found != NULL && strcmp(found->name, name) == 0)
+    }
+
+    tests_perf_end(&perf, "find 1000 children by name");
+
+    tests_perf_start(&perf);
+    cfx2_release_node(&doc);
+    tests_perf_end(&perf, "release document");
+
+    rd_opt.on_error = NULL;
+    rd_opt.flags = cfx2_mapped_input;
+
+    tests_perf_start(&perf);
+
+    rc = cfx2_read_file(&doc, huge_filename, &rd_opt);
+
+    if (rc != cfx2_ok)
+        tests_fail(("failed to map '%s': %s", huge_filename, cfx2_get_error_desc(rc)))
+
+    tests_assert(cfx2_list_length(doc->children) == huge_node_count)
+
+    tests_perf_end(&perf, "load mapped document");
+
+    cfx2_release_node(&doc);
+
+    rd_opt.flags = cfx2_mapped_input | cfx2_arena_document;
+
+    tests_perf_start(&perf);
+
+    rc = cfx2_read_file(&doc, huge_filename, &rd_opt);
+
+    if (rc != cfx2_ok)
+        tests_fail(("failed to load '%s' into an arena: %s", huge_filename, cfx2_get_error_desc(rc)))
+
+    tests_assert(cfx2_list_length(doc->children) == huge_node_count)
+
+    tests_perf_end(&perf, "load mapped arena document");
+
+    tests_perf_start(&perf);
     cfx2_release_node(&doc);
+    tests_perf_end(&perf, "release arena document");
+
+    rd_opt.flags = cfx2_mapped_input | cfx2_parallel_input;
+    rd_opt.num_threads = 4;
+
+    tests_perf_start(&perf);
+
+    rc = cfx2_read_file(&doc, huge_filename, &rd_opt);
+
+    if (rc != cfx2_ok)
+        tests_fail(("failed to load '%s' in parallel: %s", huge_filename, cfx2_get_error_desc(rc)))
+
+    tests_assert(cfx2_list_length(doc->children) == huge_node_count)
+
+    tests_perf_end(&perf, "load mapped document on 4 threads");
+
+    cfx2_release_node(&doc);
+
+    rd_opt.flags = cfx2_mapped_input;
+
+    /* the same document without building a tree */
+    counter.depth = 0;
+    counter.top_level_nodes = 0;
+
+    memset(&handler, 0, sizeof(handler));
+    handler.user = &counter;
+    handler.begin_node = count_begin_node;
+    handler.end_node = count_end_node;
+
+    tests_perf_start(&perf);
+
+    rc = cfx2_read_events_from_file(&handler, huge_filename, &rd_opt);
+
+    if (rc != cfx2_ok)
+        tests_fail(("failed to read events from '%s': %s", huge_filename, cfx2_get_error_desc(rc)))
+
+    tests_assert(counter.top_level_nodes == huge_node_count)
+    tests_assert(counter.depth == 0)
+
+    tests_perf_end(&perf, "read mapped document as events");
 
     return 0;
 }
@@ -0,0 +1,189 @@
+
+#include "tests.h"
+
+#include <string.h>
+
+#define block_count     20000
+#define comment_lines   20000
+
+typedef struct
+{
+    int errors;
+    int first_line;
+    const char* first_desc;
+}
+ErrorLog;
+
+static const unsigned thread_counts[] = { 2, 3, 8 };
+
+#define num_thread_counts (sizeof(thread_counts) / sizeof(*thread_counts))
+
+/*
+ *  Every block has lines starting with no indentation that are not nodes:
+ *  attribute names, texts after ':' and the insides of comments and strings.
+ */
+static const char block_format[] =
+    "node%i: 'text %i' (a: 1,\n"
+    "b: 2)\n"
+    "  child (x: 'y')\n"
+    "    grandchild\n"
+    "{ comment\n"
+    "fake%i (c: 3)\n"
+    "}\n"
+    "named%i:\n"
+    "'text on a line of its own'\n"
+    "quoted%i: 'multi\n"
+    "line\n"
+    "notanode%i'\n"
+    "'quoted name %i'\n"
+    "\tchild:\n"
+    "  {}\n"
+    "'text after a comment'\n"
+    "\n";
+
+static int log_error(cfx2_RdOpt* rd_opt, int rc, int line, const char* desc)
+{
+    ErrorLog* log = (ErrorLog*) rd_opt->client_priv;
+
+    if (log->errors++ == 0)
+    {
+        log->first_line = line;
+        log->first_desc = desc;
+    }
+
+    return 0;
+}
+
+/* broken (if not NULL) follows block broken_block */
+static char* generate(int broken_block, const char* broken)
+{
+    char* text, * p;
+    int i;
+
+    text = (char*) malloc(block_count * (sizeof(block_format) + 64) + (broken != NULL ? strlen(broken) : 0));
+    tests_assert(text != NULL)
+
+    for (p = text, i = 0; i < block_count; i++)
+    {
+        p += sprintf(p, block_format, i, i, i, i, i, i, i);
+
+        if (i == broken_block)
+            p += sprintf(p, "%s", broken);
+    }
+
+    return text;
+}
+
+/* a comment longer than the pieces the input is split into, then line */
+static char* after_long_comment(const char* line)
+{
+    char* text, * p;
+    int i;
+
+    text = (char*) malloc(comment_lines * 64 + strlen(line) + 8);
+    tests_assert(text != NULL)
+
+    p = text;
+    *p++ = '{';
+
+    for (i = 0; i < comment_lines; i++)
+        p += sprintf(p, "%-62s\n", "node: 'inside a comment' (x: 1)");
+
+    sprintf(p, "}\n%s", line);
+    return text;
+}
+
+/* num_threads 1: read in one go */
+static int read_document(cfx2_Node** doc_ptr, const char* text, unsigned num_threads, ErrorLog* log)
+{
+    cfx2_RdOpt rd_opt;
+
+    memset(log, 0, sizeof(*log));
+
+    rd_opt.client_priv = log;
+    rd_opt.on_error = log_error;
+    rd_opt.flags = (num_threads > 1) ? cfx2_parallel_input : 0;
+    rd_opt.num_threads = num_threads;
+
+    return cfx2_read_from_string(doc_ptr, text, &rd_opt);
+}
+
+/* a syntax error far into the document is reported once, at the same line */
+static void check_error(const char* broken)
+{
+    cfx2_Node* doc;
+    ErrorLog expected_log, log;
+    char* text;
+    size_t i;
+
+    text = generate(block_count * 3 / 4, broken);
+
+    tests_assert(read_document(&doc, text, 1, &expected_log) == cfx2_syntax_error)
+    tests_assert(expected_log.errors == 1)
+
+    for (i = 0; i < num_thread_counts; i++)
+    {
+        tests_assert(read_document(&doc, text, thread_counts[i], &log) == cfx2_syntax_error)
+        tests_assert(log.errors == 1)
+        tests_assert(log.first_line == expected_log.first_line)
+        tests_assert(strcmp(log.first_desc, expected_log.first_desc) == 0)
+    }
+
+    free(text);
+}
+
+int parse_parallel(void)
+{
+    cfx2_Node* expected_doc, * doc;
+    char* text, * expected, * output, * broken;
+    size_t expected_len, output_len, i;
+    ErrorLog expected_log, log;
+    tests_Perf perf;
+
+    text = generate(-1, NULL);
+
+    tests_perf_start(&perf);
+    tests_assert(read_document(&expected_doc, text, 1, &expected_log) == cfx2_ok)
+    tests_perf_end(&perf, "read in one go");
+
+    tests_assert(cfx2_list_length(expected_doc->children) == 4 * block_count)
+    tests_assert(cfx2_find_child(expected_doc, "fake7") == NULL)
+    tests_assert(cfx2_find_child(expected_doc, "notanode7") == NULL)
+    tests_assert(strcmp(cfx2_find_child(expected_doc, "named7")->text, "text on a line of its own") == 0)
+
+    expected = tests_serialize(expected_doc, &expected_len);
+
+    for (i = 0; i < num_thread_counts; i++)
+    {
+        tests_perf_start(&perf);
+        tests_assert(read_document(&doc, text, thread_counts[i], &log) == cfx2_ok)
+        tests_perf_end(&perf, "read in parallel");
+
+        tests_assert(log.errors == 0)
+        tests_assert(cfx2_list_length(doc->children) == cfx2_list_length(expected_doc->children))
+
+        output = tests_serialize(doc, &output_len);
+        tests_assert(output_len == expected_len)
+        tests_assert(memcmp(output, expected, output_len) == 0)
+        free(output);
+
+        /* top-level nodes moved to another document keep their strings */
+        tests_assert(cfx2_rename_node(cfx2_item(doc->children, cfx2_list_length(doc->children) - 1, cfx2_Node*), "renamed") == cfx2_ok)
+        tests_assert(cfx2_find_child(doc, "renamed") != NULL)
+
+        cfx2_release_node(&doc);
+    }
+
+    free(expected);
+    cfx2_release_node(&expected_doc);
+    free(text);
+
+    check_error("broken: )\n");
+
+    /* a string where a node should start; past the comment, the input is split right there */
+    broken = after_long_comment("\"a string\" (x: 1)\n");
+    check_error(broken);
+    free(broken);
+
+    return 0;
+}
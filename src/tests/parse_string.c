@@ -0,0 +1,47 @@
+
+#include "tests.h"
+
+#include <string.h>
+
+/* string literals live in read-only memory, so any write by the lexer would crash */
+static const char document[] =
+    "Window: 'menu' (colour: '0.0, 0.0, 0.0, 0.6', visible: 0)\n"
+    "    Button: 'menu.new' (label: 'New', iconIndex: 4)\n"
+    "\n"
+    "Panel: 'toolbar'";
+
+int parse_string(void)
+{
+    cfx2_Node* doc;
+    char copy[sizeof(document)];
+    const char* value;
+
+    int rc;
+
+    memcpy(copy, document, sizeof(document));
+
+    rc = cfx2_read_from_string(&doc, document, NULL);
+
+    if (rc != cfx2_ok)
+        tests_fail(("failed to parse document: %s", cfx2_get_error_desc(rc)))
+
+    tests_assert(memcmp(copy, document, sizeof(document)) == 0)
+    tests_assert(cfx2_list_length(doc->children) == 2)
+
+    value = cfx2_query_value(doc, "Window/Button.label");
+    tests_assert(value != NULL)
+    tests_assert(strcmp(value, "New") == 0)
+
+    value = cfx2_query_value(doc, "Window.colour");
+    tests_assert(value != NULL)
+    tests_assert(strcmp(value, "0.0, 0.0, 0.0, 0.6") == 0)
+
+    /* the last token ends exactly at the end of input */
+    value = cfx2_query_value(doc, "Panel");
+    tests_assert(value != NULL)
+    tests_assert(strcmp(value, "toolbar") == 0)
+
+    cfx2_release_node(&doc);
+
+    return 0;
+}
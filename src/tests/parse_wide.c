@@ -0,0 +1,82 @@
+
+#include "tests.h"
+
+#include <string.h>
+
+/* far beyond the old limit of 0x7FFF attributes per node */
+#define wide_attrib_count   (300 * 1000)
+#define wide_child_count    (100 * 1000)
+
+static char* generate_wide(void)
+{
+    char* document, * p;
+    size_t i;
+
+    document = (char*) malloc(wide_attrib_count * 24 + wide_child_count * 16 + 64);
+    tests_assert(document != NULL)
+
+    p = document;
+    p += sprintf(p, "Table (");
+
+    for (i = 0; i < wide_attrib_count; i++)
+        p += sprintf(p, i + 1 < wide_attrib_count ? "key%lu: %lu, " : "key%lu: %lu)\n", (unsigned long) i, (unsigned long) i);
+
+    for (i = 0; i < wide_child_count; i++)
+        p += sprintf(p, "    row%lu\n", (unsigned long) i);
+
+    return document;
+}
+
+int parse_wide(void)
+{
+    cfx2_Node* doc, * table, * child;
+    cfx2_Attrib* attrib;
+    tests_Perf perf;
+    char* document;
+    char expected[32];
+    size_t i;
+
+    int rc;
+
+    document = generate_wide();
+
+    tests_perf_start(&perf);
+
+    rc = cfx2_read_from_string(&doc, document, NULL);
+
+    if (rc != cfx2_ok)
+        tests_fail(("failed to parse wide document: %s", cfx2_get_error_desc(rc)))
+
+    tests_perf_end(&perf, "parse wide node");
+
+    free(document);
+
+    tests_assert(cfx2_list_length(doc->children) == 1)
+    table = cfx2_item(doc->children, 0, cfx2_Node*);
+
+    tests_assert(cfx2_list_length(table->attributes) == wide_attrib_count)
+    tests_assert(cfx2_list_length(table->children) == wide_child_count)
+
+    for (i = 0; i < wide_attrib_count; i += 997)
+    {
+        attrib = &cfx2_item(table->attributes, i, cfx2_Attrib);
+
+        sprintf(expected, "key%lu", (unsigned long) i);
+        tests_assert(strcmp(attrib->name, expected) == 0)
+
+        sprintf(expected, "%lu", (unsigned long) i);
+        tests_assert(attrib->value != NULL && strcmp(attrib->value, expected) == 0)
+    }
+
+    /* a removed child keeps its strings after the table is gone */
+    child = cfx2_item(table->children, wide_child_count - 1, cfx2_Node*);
+    tests_assert(cfx2_remove_child(table, child) == cfx2_ok)
+
+    cfx2_release_node(&doc);
+
+    sprintf(expected, "row%lu", (unsigned long) (wide_child_count - 1));
+    tests_assert(strcmp(child->name, expected) == 0)
+    cfx2_release_node(&child);
+
+    return 0;
+}
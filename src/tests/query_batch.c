@@ -0,0 +1,123 @@
+
+#include "tests.h"
+
+#include "usertable.h"
+
+#include <string.h>
+
+/* a config tree deep_fanout wide and deep_depth deep */
+#define deep_fanout     8
+#define deep_depth      6
+#define deep_queries    512
+#define repeat_count    200
+
+static const char* const commands[] =
+{
+    "Users/root.homeDir",
+    "Users/root.passwordHash",
+    "Users/root",
+    "Users/guest.homeDir",
+    "Users/nobody.homeDir",
+    "Users/root.nothing",
+    "Users/root.homeDir:changed",
+    "Users/ro ot",
+    "Users/root.homeDir",
+    "",
+    "Users/randuser3.passwordHash",
+    "Users/randuser3/deeper"
+};
+
+#define num_commands (sizeof(commands) / sizeof(*commands))
+
+static void build_deep(cfx2_Node* node, int depth, char* path, size_t path_len)
+{
+    char name[16];
+    int i;
+
+    tests_assert(cfx2_set_node_text(node, path) == cfx2_ok)
+
+    if (depth == deep_depth)
+        return;
+
+    for (i = 0; i < deep_fanout; i++)
+    {
+        sprintf(name, "n%i", i);
+        sprintf(path + path_len, "%s%s", path_len > 0 ? "/" : "", name);
+        build_deep(cfx2_create_child(node, name, NULL, cfx2_multiple), depth + 1, path, strlen(path));
+    }
+
+    path[path_len] = 0;
+}
+
+int query_batch(void)
+{
+    cfx2_Node* doc;
+    cfx2_QueryBatch* batch;
+    const char* values[num_commands];
+    char* deep_commands[deep_queries];
+    const char* deep_values[deep_queries];
+    char path[64];
+    tests_Perf perf;
+    size_t i;
+    int j, rc;
+
+    rc = cfx2_read_file(&doc, usertable_filename, NULL);
+
+    if (rc != cfx2_ok)
+        tests_fail(("failed to load '%s': %s", usertable_filename, cfx2_get_error_desc(rc)))
+
+    tests_assert(cfx2_query_values(doc, commands, num_commands, values) == cfx2_ok)
+
+    for (i = 0; i < num_commands; i++)
+        tests_assert_2(values[i] == cfx2_query_value(doc, commands[i]), commands[i])
+
+    cfx2_release_node(&doc);
+
+    /* deep tree: every query shares most of its path with others */
+    doc = cfx2_new_node(NULL);
+    tests_assert(doc != NULL)
+
+    path[0] = 0;
+    build_deep(doc, 0, path, 0);
+
+    srand(0);
+
+    for (i = 0; i < deep_queries; i++)
+    {
+        path[0] = 0;
+
+        for (j = 0; j < deep_depth; j++)
+            sprintf(path + strlen(path), "%sn%i", j > 0 ? "/" : "", rand() % deep_fanout);
+
+        deep_commands[i] = (char*) malloc(strlen(path) + 1);
+        strcpy(deep_commands[i], path);
+    }
+
+    tests_assert(cfx2_compile_query_batch(&batch, (const char* const*) deep_commands, deep_queries) == cfx2_ok)
+
+    tests_perf_start(&perf);
+
+    for (j = 0; j < repeat_count; j++)
+        for (i = 0; i < deep_queries; i++)
+            deep_values[i] = cfx2_query_value(doc, deep_commands[i]);
+
+    tests_perf_end(&perf, "separate queries");
+
+    tests_perf_start(&perf);
+
+    for (j = 0; j < repeat_count; j++)
+        cfx2_execute_query_batch(batch, doc, deep_values);
+
+    tests_perf_end(&perf, "batch query");
+
+    for (i = 0; i < deep_queries; i++)
+    {
+        tests_assert(deep_values[i] != NULL && strcmp(deep_values[i], deep_commands[i]) == 0)
+        free(deep_commands[i]);
+    }
+
+    cfx2_release_query_batch(&batch);
+    cfx2_release_node(&doc);
+
+    return 0;
+}
@@ -0,0 +1,169 @@
+
+#include "tests.h"
+
+#include "usertable.h"
+
+#include <string.h>
+
+/* a tree iter_fanout wide and iter_depth deep, every node with a depth attribute */
+#define iter_fanout     4
+#define iter_depth      5
+
+static void build_tree(cfx2_Node* node, int depth)
+{
+    char name[16];
+    int i;
+
+    tests_assert(cfx2_set_node_attrib_int(node, "depth", depth) == cfx2_ok)
+
+    if (depth == iter_depth)
+        return;
+
+    for (i = 0; i < iter_fanout; i++)
+    {
+        sprintf(name, "n%i", i);
+        build_tree(cfx2_create_child(node, name, NULL, cfx2_multiple), depth + 1);
+    }
+}
+
+/* all nodes (or those at one depth) in document order */
+static size_t collect(cfx2_Node* node, int depth, int want_depth, cfx2_Node** nodes, size_t count)
+{
+    size_t i;
+
+    if (want_depth < 0 || depth == want_depth)
+        nodes[count++] = node;
+
+    for (i = 0; i < cfx2_list_length(node->children); i++)
+        count = collect(cfx2_item(node->children, i, cfx2_Node*), depth + 1, want_depth, nodes, count);
+
+    return count;
+}
+
+/* the nodes (or attributes) a command matches */
+static size_t query_all(cfx2_Node* base, const char* command, void** output, size_t max_count)
+{
+    cfx2_QueryIter* iter;
+    cfx2_ResultType type;
+    void* item;
+    size_t count;
+
+    tests_assert_2(cfx2_query_all(&iter, base, command) == cfx2_ok, command)
+
+    for (count = 0; (type = cfx2_query_iter_next(iter, &item)) != cfx2_void; count++)
+    {
+        tests_assert_2(type == cfx2_node || type == cfx2_attrib, command)
+        tests_assert_2(count < max_count, command)
+        output[count] = item;
+    }
+
+    cfx2_release_query_iter(&iter);
+    tests_assert(iter == NULL)
+    return count;
+}
+
+int query_iter(void)
+{
+    static cfx2_Node* expected[5000];
+    static void* output[5000];
+
+    const char* params[3];
+    cfx2_Node* doc, * users, * root;
+    cfx2_Query* query;
+    cfx2_QueryIter* iter;
+    cfx2_Attrib* attrib;
+    void* item;
+    size_t i, count;
+    int rc;
+
+    rc = cfx2_read_file(&doc, usertable_filename, NULL);
+
+    if (rc != cfx2_ok)
+        tests_fail(("failed to load '%s': %s", usertable_filename, cfx2_get_error_desc(rc)))
+
+    users = cfx2_find_child(doc, "Users");
+    root = cfx2_find_child(users, "root");
+    tests_assert(users != NULL && root != NULL)
+
+    /* any child */
+    count = query_all(doc, "Users/*", output, 5000);
+    tests_assert(count == cfx2_list_length(users->children))
+
+    for (i = 0; i < count; i++)
+        tests_assert(output[i] == cfx2_item(users->children, i, cfx2_Node*))
+
+    /* attributes of any child */
+    count = query_all(doc, "Users/*.homeDir", output, 5000);
+    tests_assert(count == cfx2_list_length(users->children))
+
+    for (i = 0; i < count; i++)
+        tests_assert(output[i] == cfx2_find_attrib(cfx2_item(users->children, i, cfx2_Node*), "homeDir"))
+
+    /* predicates */
+    tests_assert(query_all(doc, "Users/*[passwordHash=33]", output, 5000) == 9)
+    tests_assert(query_all(doc, "Users/*[passwordHash]", output, 5000) == 10)
+    tests_assert(query_all(doc, "Users/*[nothing]", output, 5000) == 0)
+    tests_assert(query_all(doc, "Users/*[hasPassword=1][passwordHash=51]", output, 5000) == 1 && output[0] == root)
+    tests_assert(query_all(doc, "**[hasPassword=0]", output, 5000) == 1 && output[0] == cfx2_find_child(users, "guest"))
+    tests_assert(query_all(doc, "Users/root[passwordHash=51]", output, 5000) == 1 && output[0] == root)
+    tests_assert(query_all(doc, "Users/root[passwordHash=33]", output, 5000) == 0)
+    tests_assert(query_all(doc, "Users/[hasPassword]", output, 5000) == 0)
+
+    /* the other query functions take the first match */
+    tests_assert(strcmp(cfx2_query_value(doc, "Users/*[passwordHash=51].homeDir"), "/root") == 0)
+    tests_assert(strcmp(cfx2_query_value(doc, "**[passwordHash=33].homeDir"), "/home/randuser1") == 0)
+    tests_assert(cfx2_query_value(doc, "**[passwordHash=34].homeDir") == NULL)
+    tests_assert(cfx2_query(doc, "Users/*.homeDir:changed", 1, NULL) == cfx2_fail)
+    tests_assert(strcmp(cfx2_query_value(doc, "Users/root.homeDir"), "/root") == 0)
+
+    /* syntax errors */
+    tests_assert(cfx2_query_all(&iter, doc, "Users/*[hasPassword") != cfx2_ok)
+    tests_assert(cfx2_query_all(&iter, doc, "Users/*[=1]") != cfx2_ok)
+    tests_assert(cfx2_query_all(&iter, doc, "Users/root.homeDir:x") == cfx2_param_invalid)
+
+    /* parameters */
+    tests_assert(cfx2_compile_query(&query, "%s/*[%s=%s].homeDir") == cfx2_ok)
+
+    params[0] = "Users";
+    params[1] = "passwordHash";
+    params[2] = "51";
+
+    tests_assert(cfx2_create_query_iter(&iter, query, doc, params) == cfx2_ok)
+    tests_assert(cfx2_query_iter_next(iter, &item) == cfx2_attrib)
+    attrib = (cfx2_Attrib*) item;
+    tests_assert(strcmp(attrib->value, "/root") == 0)
+    tests_assert(cfx2_query_iter_next(iter, NULL) == cfx2_void)
+    tests_assert(cfx2_query_iter_next(iter, NULL) == cfx2_void)
+    cfx2_release_query_iter(&iter);
+
+    tests_assert(cfx2_create_query_iter(&iter, query, doc, NULL) == cfx2_param_invalid)
+    cfx2_release_query(&query);
+
+    cfx2_release_node(&doc);
+
+    /* descendants come in document order */
+    doc = cfx2_new_node(NULL);
+    tests_assert(doc != NULL)
+    build_tree(doc, 0);
+
+    count = collect(doc, 0, -1, expected, 0);
+    tests_assert(query_all(doc, "**", output, 5000) == count)
+
+    for (i = 0; i < count; i++)
+        tests_assert(output[i] == expected[i])
+
+    count = collect(doc, 0, 3, expected, 0);
+    tests_assert(query_all(doc, "**[depth=3]", output, 5000) == count)
+    tests_assert(query_all(doc, "*/*/*", output, 5000) == count)
+
+    for (i = 0; i < count; i++)
+        tests_assert(output[i] == expected[i])
+
+    tests_assert(query_all(doc, "n1/**/n2[depth=5]", output, 5000) == iter_fanout * iter_fanout * iter_fanout)
+    tests_assert(query_all(doc, "**/n3", output, 5000) == 1 + 4 + 16 + 64 + 256)
+    tests_assert(query_all(doc, "**.depth", output, 5000) == collect(doc, 0, -1, expected, 0))
+
+    cfx2_release_node(&doc);
+
+    return 0;
+}
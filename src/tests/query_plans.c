@@ -0,0 +1,144 @@
+
+#include "tests.h"
+
+#include "usertable.h"
+
+#include <string.h>
+
+#define repeat_count    100000
+
+static const char* const commands[] =
+{
+    "",
+    "Users",
+    "Users/root",
+    "Users/root.homeDir",
+    "Users//guest.hasPassword",
+    "/Users/randuser5.passwordHash",
+    "Users/nobody",
+    "Users/root.nothing",
+    "Users/root.homeDir/x",
+    "Users/root.homeDir.x",
+    "Users/ro ot",
+    "Users/%s",
+    NULL
+};
+
+static void compare_with_query(cfx2_Node* doc, const char* command)
+{
+    cfx2_Query* query;
+    void* output1, * output2;
+    cfx2_ResultType type1, type2;
+    int rc;
+
+    output1 = NULL;
+    output2 = NULL;
+
+    type1 = cfx2_query(doc, command, 0, &output1);
+    rc = cfx2_compile_query(&query, command);
+
+    if (rc != cfx2_ok)
+    {
+        tests_assert_2(type1 == cfx2_fail, command)
+        return;
+    }
+
+    /* "%s" without parameters */
+    if (strchr(command, '%') != NULL)
+        type2 = cfx2_fail;
+    else
+        type2 = cfx2_execute_query(query, doc, NULL, 0, &output2);
+
+    tests_assert_2(type1 == type2 && output1 == output2, command)
+    cfx2_release_query(&query);
+}
+
+int query_plans(void)
+{
+    cfx2_Node* doc;
+    cfx2_Query* query;
+    cfx2_QueryCache* cache;
+    const cfx2_Query* cached, * cached2;
+    const char* params[2];
+    const char* value;
+    char command[64];
+    tests_Perf perf;
+    int i, rc;
+
+    rc = cfx2_read_file(&doc, usertable_filename, NULL);
+
+    if (rc != cfx2_ok)
+        tests_fail(("failed to load '%s': %s", usertable_filename, cfx2_get_error_desc(rc)))
+
+    for (i = 0; commands[i] != NULL; i++)
+        compare_with_query(doc, commands[i]);
+
+    /* parameters */
+    tests_assert(cfx2_compile_query(&query, "Users/%s.%s") == cfx2_ok)
+
+    params[0] = "root";
+    params[1] = "homeDir";
+    value = cfx2_execute_query_value(query, doc, params);
+    tests_assert(value != NULL && strcmp(value, "/root") == 0)
+
+    params[0] = "guest";
+    value = cfx2_execute_query_value(query, doc, params);
+    tests_assert(value != NULL && strcmp(value, "/home/guest") == 0)
+
+    tests_assert(cfx2_execute_query_value(query, doc, NULL) == NULL)
+    cfx2_release_query(&query);
+
+    /* modifications */
+    tests_assert(cfx2_compile_query(&query, "Users/%s.homeDir:%s") == cfx2_ok)
+
+    params[0] = "newuser";
+    params[1] = "/home/newuser";
+    tests_assert(cfx2_execute_query(query, doc, params, 0, NULL) == cfx2_fail)
+    tests_assert(cfx2_execute_query(query, doc, params, 1, NULL) == cfx2_void)
+    cfx2_release_query(&query);
+
+    value = cfx2_query_value(doc, "Users/newuser.homeDir");
+    tests_assert(value != NULL && strcmp(value, "/home/newuser") == 0)
+
+    /* the cache keeps recently used queries */
+    tests_assert(cfx2_create_query_cache(&cache, 2) == cfx2_ok)
+
+    cached = cfx2_cached_query(cache, "Users/%s.hasPassword");
+    tests_assert(cached != NULL)
+    tests_assert(cfx2_cached_query(cache, "Users/%s.passwordHash") != NULL)
+    tests_assert(cfx2_cached_query(cache, "Users/%s.hasPassword") == cached)
+    tests_assert(cfx2_cached_query(cache, "Users/%s.homeDir") != NULL)
+    tests_assert(cfx2_cached_query(cache, "Users/%s.hasPassword") == cached)
+    tests_assert(cfx2_cached_query(cache, "Users/ro ot") == NULL)
+
+    /* string queries vs. cached plans */
+    tests_perf_start(&perf);
+
+    for (i = 0; i < repeat_count; i++)
+    {
+        sprintf(command, "Users/randuser%i.passwordHash", i % 9 + 1);
+        value = cfx2_query_value(doc, command);
+        tests_assert(value != NULL)
+    }
+
+    tests_perf_end(&perf, "string queries");
+
+    tests_perf_start(&perf);
+
+    for (i = 0; i < repeat_count; i++)
+    {
+        sprintf(command, "randuser%i", i % 9 + 1);
+        params[0] = command;
+
+        cached2 = cfx2_cached_query(cache, "Users/%s.passwordHash");
+        value = cfx2_execute_query_value(cached2, doc, params);
+        tests_assert(value != NULL)
+    }
+
+    tests_perf_end(&perf, "cached query plans");
+
+    cfx2_release_query_cache(&cache);
+    cfx2_release_node(&doc);
+
+    return 0;
+}
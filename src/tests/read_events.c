@@ -0,0 +1,194 @@
+
+#include "tests.h"
+
+#include <string.h>
+
+/* events are recorded as text, so different readers can be compared */
+typedef struct
+{
+    char* text;
+    size_t length, capacity;
+
+    int nodes_left;
+}
+Trace;
+
+static void trace_append(Trace* trace, const char* str, size_t length)
+{
+    if (trace->length + length + 1 > trace->capacity)
+    {
+        trace->capacity = (trace->length + length + 1) * 2;
+        trace->text = (char*) realloc(trace->text, trace->capacity);
+    }
+
+    memcpy(trace->text + trace->length, str, length);
+    trace->length += length;
+    trace->text[trace->length] = 0;
+}
+
+static int trace_begin_node(void* user, const char* name, size_t name_length)
+{
+    Trace* trace = (Trace*) user;
+
+    trace_append(trace, "<", 1);
+    trace_append(trace, name, name_length);
+
+    if (trace->nodes_left > 0 && --trace->nodes_left == 0)
+        return cfx2_stop;
+
+    return cfx2_continue;
+}
+
+static int trace_node_text(void* user, const char* text, size_t length)
+{
+    trace_append((Trace*) user, ":", 1);
+    trace_append((Trace*) user, text, length);
+    return cfx2_continue;
+}
+
+static int trace_attrib(void* user, const char* name, size_t name_length, const char* value, size_t value_length)
+{
+    trace_append((Trace*) user, " ", 1);
+    trace_append((Trace*) user, name, name_length);
+
+    if (value != NULL)
+    {
+        trace_append((Trace*) user, "=", 1);
+        trace_append((Trace*) user, value, value_length);
+    }
+
+    return cfx2_continue;
+}
+
+static int trace_end_node(void* user)
+{
+    trace_append((Trace*) user, ">", 1);
+    return cfx2_continue;
+}
+
+static void trace_node(Trace* trace, cfx2_Node* node)
+{
+    size_t i;
+
+    trace_append(trace, "<", 1);
+    trace_append(trace, node->name, strlen(node->name));
+
+    if (node->text != NULL)
+        trace_node_text(trace, node->text, strlen(node->text));
+
+    for (i = 0; i < cfx2_list_length(node->attributes); i++)
+    {
+        cfx2_Attrib* attrib = &cfx2_item(node->attributes, i, cfx2_Attrib);
+
+        trace_attrib(trace, attrib->name, strlen(attrib->name), attrib->value,
+                attrib->value != NULL ? strlen(attrib->value) : 0);
+    }
+
+    for (i = 0; i < cfx2_list_length(node->children); i++)
+        trace_node(trace, cfx2_item(node->children, i, cfx2_Node*));
+
+    trace_append(trace, ">", 1);
+}
+
+static void init_trace(Trace* trace, cfx2_ReadHandler* handler, int nodes_left)
+{
+    trace->text = NULL;
+    trace->length = 0;
+    trace->capacity = 0;
+    trace->nodes_left = nodes_left;
+
+    trace_append(trace, "", 0);
+
+    handler->user = trace;
+    handler->begin_node = trace_begin_node;
+    handler->node_text = trace_node_text;
+    handler->attrib = trace_attrib;
+    handler->end_node = trace_end_node;
+}
+
+static const char document[] =
+    "Node: 'text' (flag, key: value)\n"
+    "    Child (empty)\n"
+    "Last";
+
+int read_events(void)
+{
+    static const char* filename = "usertable.cfx2";
+
+    cfx2_ReadHandler handler;
+    cfx2_Parser* parser;
+    cfx2_Node* doc;
+    Trace expected, trace, chunked;
+    FILE* file;
+    char buffer[1];
+    size_t i;
+    int rc;
+
+    /* the tree reader is the reference */
+    doc = cfx2_load_document(filename);
+    tests_assert(doc != NULL)
+
+    init_trace(&expected, &handler, 0);
+
+    for (i = 0; i < cfx2_list_length(doc->children); i++)
+        trace_node(&expected, cfx2_item(doc->children, i, cfx2_Node*));
+
+    cfx2_release_node(&doc);
+
+    /* whole document */
+    init_trace(&trace, &handler, 0);
+    rc = cfx2_read_events_from_file(&handler, filename, NULL);
+
+    if (rc != cfx2_ok)
+        tests_fail(("failed to read '%s': %s", filename, cfx2_get_error_desc(rc)))
+
+    tests_assert(strcmp(trace.text, expected.text) == 0)
+
+    /* one byte at a time; attribute names must survive the chunk boundaries */
+    init_trace(&chunked, &handler, 0);
+    rc = cfx2_create_event_parser(&parser, &handler, NULL);
+    tests_assert(rc == cfx2_ok)
+
+    file = fopen(filename, "rb");
+    tests_assert(file != NULL)
+
+    while (rc == cfx2_ok && fread(buffer, 1, 1, file) == 1)
+        rc = cfx2_parser_feed(parser, buffer, 1);
+
+    fclose(file);
+
+    if (rc == cfx2_ok)
+        rc = cfx2_parser_finish(parser, NULL);
+
+    cfx2_release_parser(&parser);
+
+    if (rc != cfx2_ok)
+        tests_fail(("failed to read '%s' incrementally: %s", filename, cfx2_get_error_desc(rc)))
+
+    tests_assert(strcmp(chunked.text, expected.text) == 0)
+
+    free(chunked.text);
+    free(trace.text);
+
+    /* stopping early */
+    init_trace(&trace, &handler, 3);
+    rc = cfx2_read_events_from_file(&handler, filename, NULL);
+
+    tests_assert(rc == cfx2_interrupted)
+    tests_assert(trace.length < expected.length)
+    tests_assert(strncmp(trace.text, expected.text, trace.length) == 0)
+
+    free(trace.text);
+    free(expected.text);
+
+    /* attributes with and without values */
+    init_trace(&trace, &handler, 0);
+    rc = cfx2_read_events_from_string(&handler, document, NULL);
+
+    tests_assert(rc == cfx2_ok)
+    tests_assert(strcmp(trace.text, "<Node:text flag key=value<Child empty>><Last>") == 0)
+
+    free(trace.text);
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+
+#include "tests.h"
+
+#include <string.h>
+
+#define max_items   40
+
+static size_t list_allocs(void)
+{
+    cfx2_MemoryStats stats;
+
+    tests_assert(cfx2_get_memory_stats(cfx2_mem_list, &stats) == cfx2_ok)
+    return stats.allocs + stats.reallocs;
+}
+
+/* attributes a0..a(count-1) except removed, children c0..c(count-1) in reverse */
+static void check_node(cfx2_Node* node, int count, int removed)
+{
+    char name[16];
+    long value;
+    int i, j;
+
+    tests_assert(cfx2_list_length(node->attributes) == (size_t) (count - (removed >= 0)))
+    tests_assert(cfx2_list_length(node->children) == (size_t) count)
+
+    for (i = 0, j = 0; i < count; i++)
+    {
+        sprintf(name, "a%i", i);
+
+        if (i == removed)
+        {
+            tests_assert(cfx2_find_attrib(node, name) == NULL)
+            continue;
+        }
+
+        tests_assert(strcmp(cfx2_item(node->attributes, j++, cfx2_Attrib).name, name) == 0)
+        tests_assert(cfx2_get_node_attrib_int(node, name, &value) == cfx2_ok && value == i)
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "c%i", count - 1 - i);
+        tests_assert(strcmp(cfx2_item(node->children, i, cfx2_Node*)->name, name) == 0)
+    }
+}
+
+static void fill(cfx2_Node* node, int count)
+{
+    char name[16];
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "a%i", i);
+        tests_assert(cfx2_set_node_attrib_int(node, name, i) == cfx2_ok)
+
+        sprintf(name, "c%i", i);
+        tests_assert(cfx2_insert_child(node, 0, cfx2_new_node(name)) == cfx2_ok)
+    }
+}
+
+int small_lists(void)
+{
+    static const char small_document[] =
+        "a: 'x' (one: 1)\n"
+        "  b\n"
+        "  c (d: 4)\n"
+        "e\n";
+
+    cfx2_Node* doc, * node, * child;
+    cfx2_RdOpt rd_opt;
+    int count, arena;
+
+    tests_assert(cfx2_enable_memory_stats(1) == cfx2_ok)
+
+    /* an attribute and two children need no list blocks */
+    tests_assert(cfx2_read_from_string(&doc, small_document, NULL) == cfx2_ok)
+    tests_assert(list_allocs() == 0)
+
+    node = cfx2_find_child(doc, "a");
+    tests_assert(node != NULL && cfx2_list_length(node->attributes) == 1)
+    tests_assert(cfx2_list_length(node->children) == 2)
+    tests_assert(strcmp(cfx2_query_value(doc, "a/c.d"), "4") == 0)
+
+    /* growing out of the node and back */
+    tests_assert(cfx2_set_node_attrib(node, "two", "2") == cfx2_ok)
+    tests_assert(list_allocs() == 1)
+    tests_assert(strcmp(cfx2_query_value(doc, "a.one"), "1") == 0)
+    tests_assert(strcmp(cfx2_query_value(doc, "a.two"), "2") == 0)
+
+    tests_assert(cfx2_remove_attrib(node, "one") == cfx2_ok)
+    tests_assert(cfx2_compact(doc) == cfx2_ok)
+    tests_assert(node->attributes.items == node->attributes.local.bytes)
+    tests_assert(strcmp(cfx2_query_value(doc, "a.two"), "2") == 0)
+
+    cfx2_release_node(&doc);
+    tests_assert(cfx2_enable_memory_stats(0) == cfx2_ok)
+
+    /* every size across the boundary, in heap and arena documents */
+    for (arena = 0; arena < 2; arena++)
+    {
+        for (count = 0; count < max_items; count++)
+        {
+            memset(&rd_opt, 0, sizeof(rd_opt));
+            rd_opt.flags = arena ? cfx2_arena_document : 0;
+
+            tests_assert(cfx2_read_from_string(&doc, "node\n", &rd_opt) == cfx2_ok)
+            node = cfx2_find_child(doc, "node");
+            tests_assert(node != NULL)
+
+            fill(node, count);
+            check_node(node, count, -1);
+
+            if (count > 0)
+            {
+                tests_assert(cfx2_remove_attrib(node, "a0") == cfx2_ok)
+                check_node(node, count, 0);
+
+                child = cfx2_item(node->children, 0, cfx2_Node*);
+                tests_assert(cfx2_remove_child(node, child) == cfx2_ok)
+                tests_assert(cfx2_list_length(node->children) == (size_t) count - 1)
+                cfx2_release_node(&child);
+            }
+
+            tests_assert(cfx2_compact(doc) == cfx2_ok)
+            tests_assert(cfx2_list_length(node->children) == (size_t) (count > 0 ? count - 1 : 0))
+
+            cfx2_release_node(&doc);
+        }
+    }
+
+    return 0;
+}
@@ -22,6 +22,7 @@
 */
 
 #include "tests.h"
+#include "timer.h"
 
 #include <string.h>
 
@@ -32,21 +33,65 @@
 #include <crtdbg.h>
 #endif
 
+int allocator(void);
+int attrib_names(void);
+int binary_roundtrip(void);
+int binary_view(void);
+int child_index(void);
+int compact(void);
+int frozen(void);
 int gen_huge(void);
+int lexer_vectors(void);
+int memory_stats(void);
 int parseerror(void);
+int parse_arena(void);
+int parse_chunks(void);
 int parse_huge(void);
+int parse_parallel(void);
+int parse_string(void);
+int parse_wide(void);
 int queries1(void);
+int query_batch(void);
+int query_iter(void);
+int query_plans(void);
+int read_events(void);
+int small_lists(void);
 int unparent(void);
+int write_buffered(void);
+int write_parallel(void);
+int write_sizes(void);
 
 static const tests_Case testcases[] =
 {
 #define entry(name_) { #name_, &name_ }
 
+    entry(allocator),
+    entry(attrib_names),
+    entry(binary_roundtrip),
+    entry(binary_view),
+    entry(child_index),
+    entry(compact),
+    entry(frozen),
     entry(gen_huge),
+    entry(lexer_vectors),
+    entry(memory_stats),
     entry(parseerror),
+    entry(parse_arena),
+    entry(parse_chunks),
     entry(parse_huge),
+    entry(parse_parallel),
+    entry(parse_string),
+    entry(parse_wide),
     entry(queries1),
+    entry(query_batch),
+    entry(query_iter),
+    entry(query_plans),
+    entry(read_events),
+    entry(small_lists),
     entry(unparent),
+    entry(write_buffered),
+    entry(write_parallel),
+    entry(write_sizes),
 
 #undef entry
 
@@ -110,14 +155,15 @@ int tests_parse_error( cfx2_RdOpt* rd_opt, int rc, int line, const char* desc )
     return 0;
 }
 
+/* wall time, so work on several threads is measured as it is */
 void tests_perf_start(tests_Perf* perf)
 {
-    perf->time0 = clock();
+    perf->time0 = tests_seconds();
 }
 
 void tests_perf_end(tests_Perf* perf, const char* desc)
 {
-    printf("#### %s:\ttime(%s): %i ms\n", current->name, desc, (int)((clock() - perf->time0) * 1000 / CLOCKS_PER_SEC));
+    printf("#### %s:\ttime(%s): %i ms\n", current->name, desc, (int)((tests_seconds() - perf->time0) * 1000));
 }
 
 void tests_print_node_recursive(cfx2_Node* node)
@@ -125,6 +171,124 @@ void tests_print_node_recursive(cfx2_Node* node)
     print_node(node, 0);
 }
 
+/* the whole file, with a NUL appended; size (may be NULL) doesn't count the NUL */
+char* tests_read_file(const char* filename, size_t* size)
+{
+    FILE* file;
+    char* data;
+    size_t length;
+
+    file = fopen(filename, "rb");
+
+    if (file == NULL)
+        tests_fail(("failed to open '%s'", filename))
+
+    fseek(file, 0, SEEK_END);
+    length = (size_t) ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    data = (char*) malloc(length + 1);
+    tests_assert(data != NULL)
+    tests_assert_2(fread(data, 1, length, file) == length, filename)
+    data[length] = 0;
+    fclose(file);
+
+    if (size != NULL)
+        *size = length;
+
+    return data;
+}
+
+/* count top-level nodes with attributes (one without a value), some texts and uneven subtrees */
+cfx2_Node* tests_build_doc(size_t count)
+{
+    cfx2_Node* doc, * node, * child;
+    char name[32], text[32];
+    size_t i;
+
+    doc = cfx2_new_node(NULL);
+    tests_assert(doc != NULL)
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "node%i", (int) i);
+        sprintf(text, "it's #%i", (int) i);
+
+        node = cfx2_create_child(doc, name, (i % 3) ? text : NULL, cfx2_multiple);
+        tests_assert(node != NULL)
+        tests_assert(cfx2_set_node_attrib_int(node, "index", (long) i) == cfx2_ok)
+        tests_assert(cfx2_set_node_attrib(node, "flag", NULL) == cfx2_ok)
+
+        if (i % 7 == 0)
+        {
+            child = cfx2_create_child(node, "child", "a \\ b", cfx2_multiple);
+            tests_assert(child != NULL)
+            tests_assert(cfx2_create_child(child, "grandchild", NULL, cfx2_multiple) != NULL)
+            tests_assert(cfx2_create_child(node, "child", NULL, cfx2_multiple) != NULL)
+        }
+    }
+
+    return doc;
+}
+
+/* the document as NUL-terminated text; length (may be NULL) doesn't count the NUL */
+char* tests_serialize(cfx2_Node* doc, size_t* length)
+{
+    char* text;
+    size_t size, used;
+
+    /* measured first, so that the text is ours to free whichever allocator the library uses */
+    if (cfx2_measure_document(doc, &size) != cfx2_ok)
+        tests_fail(("failed to measure document"))
+
+    text = (char*) malloc(size + 1);
+    tests_assert(text != NULL)
+
+    if (cfx2_write_to_fixed_buffer(doc, text, size, &used) != cfx2_ok)
+        tests_fail(("failed to serialize document"))
+
+    tests_assert(used == size)
+    text[used] = 0;
+
+    if (length != NULL)
+        *length = used;
+
+    return text;
+}
+
+static size_t collect_write(cfx2_WrOpt* wr_opt, const char* buffer, size_t length)
+{
+    tests_Collected* collected = (tests_Collected*) wr_opt->stream_priv;
+
+    if (collected->length + length > collected->capacity)
+    {
+        collected->capacity = (collected->length + length) * 2;
+        collected->text = (char*) realloc(collected->text, collected->capacity);
+        tests_assert(collected->text != NULL)
+    }
+
+    memcpy(collected->text + collected->length, buffer, length);
+    collected->length += length;
+    collected->calls++;
+    return length;
+}
+
+static void collect_close(cfx2_WrOpt* wr_opt)
+{
+    (void) wr_opt;
+}
+
+/* clears wr_opt and collected; the caller frees collected->text */
+void tests_collect_output(cfx2_WrOpt* wr_opt, tests_Collected* collected)
+{
+    memset(collected, 0, sizeof(*collected));
+    memset(wr_opt, 0, sizeof(*wr_opt));
+
+    wr_opt->stream_priv = collected;
+    wr_opt->stream_write = collect_write;
+    wr_opt->stream_close = collect_close;
+}
+
 static int perform_test(const tests_Case* testcase)
 {
     current = testcase;
@@ -45,10 +45,20 @@ tests_Case;
 
 typedef struct
 {
-    clock_t         time0;
+    double          time0;
 }
 tests_Perf;
 
+/* output of a writer set up by tests_collect_output; text isn't NUL-terminated */
+typedef struct
+{
+    char*           text;
+    size_t          length, capacity;
+    size_t          calls;
+    int             errors;     /* for the test's own on_error */
+}
+tests_Collected;
+
 #define tests_assert(assertion_) { if (!(assertion_)) tests_fail(("failed assertion '%s'", #assertion_)); }
 #define tests_assert_2(assertion_, error_) { if (!(assertion_)) tests_fail(("failed assertion '%s': %s", #assertion_, error_)); }
 #define tests_info(error_) { printf("#### %s:\t", tests_get_current_name()); printf error_; printf("\n"); }
@@ -57,6 +67,10 @@ tests_Perf;
 const char*     tests_get_current_name(void);
 void            tests_memory_usage_check(void);
 void            tests_print_node_recursive(cfx2_Node* node);
+char*           tests_serialize(cfx2_Node* doc, size_t* length);
+char*           tests_read_file(const char* filename, size_t* size);
+cfx2_Node*      tests_build_doc(size_t count);
+void            tests_collect_output(cfx2_WrOpt* wr_opt, tests_Collected* collected);
 
 void            tests_perf_start(tests_Perf* perf);
 void            tests_perf_end(tests_Perf* perf, const char* desc);
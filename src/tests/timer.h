@@ -0,0 +1,8 @@
+
+#ifndef libcfx2_timer_h_included
+#define libcfx2_timer_h_included
+
+/* seconds on a monotonic clock from an arbitrary start; for measuring wall time */
+double tests_seconds(void);
+
+#endif
@@ -0,0 +1,117 @@
+
+#include "tests.h"
+
+#include <string.h>
+
+#define chain_depth     100
+#define long_length     100000
+
+static const char small_expected[] =
+    "'a b': 'it\\'s \\\\ here' (x: '1', 'y z': '\\'')\n"
+    "  c\n"
+    "\n"
+    "d\n";
+
+/* buffer sizes to write with; 0 writes everything straight to the stream */
+static const size_t buffer_sizes[] = { 0, 1, 7, 64, 4096 };
+
+#define num_buffer_sizes (sizeof(buffer_sizes) / sizeof(*buffer_sizes))
+
+/* buffer_size < 0: the default buffer */
+static void write_collected(cfx2_Node* doc, int buffer_size, tests_Collected* collected)
+{
+    cfx2_WrOpt wr_opt;
+
+    tests_collect_output(&wr_opt, collected);
+
+    if (buffer_size >= 0)
+    {
+        wr_opt.flags |= cfx2_output_buffer_size;
+        wr_opt.buffer_size = buffer_size;
+    }
+
+    tests_assert(cfx2_write(doc, &wr_opt) == cfx2_ok)
+}
+
+int write_buffered(void)
+{
+    cfx2_Node* doc, * node, * doc2;
+    tests_Collected collected, expected;
+    char* long_text;
+    size_t i;
+
+    /* escaping */
+    doc = cfx2_new_node(NULL);
+    node = cfx2_create_child(doc, "a b", "it's \\ here", cfx2_multiple);
+    tests_assert(node != NULL)
+    tests_assert(cfx2_set_node_attrib(node, "x", "1") == cfx2_ok)
+    tests_assert(cfx2_set_node_attrib(node, "y z", "'") == cfx2_ok)
+    tests_assert(cfx2_create_child(node, "c", NULL, cfx2_multiple) != NULL)
+    tests_assert(cfx2_create_child(doc, "d", NULL, cfx2_multiple) != NULL)
+
+    for (i = 0; i < num_buffer_sizes; i++)
+    {
+        write_collected(doc, (int) buffer_sizes[i], &collected);
+        tests_assert(collected.length == strlen(small_expected))
+        tests_assert(memcmp(collected.text, small_expected, collected.length) == 0)
+        free(collected.text);
+    }
+
+    write_collected(doc, -1, &collected);
+    tests_assert(collected.calls == 1)
+    tests_assert(memcmp(collected.text, small_expected, collected.length) == 0)
+    free(collected.text);
+
+    cfx2_release_node(&doc);
+
+    /* deep indentation and long texts with scattered quotes */
+    long_text = (char*) malloc(long_length + 1);
+
+    for (i = 0; i < long_length; i++)
+        long_text[i] = (i % 1000 == 999) ? '\'' : (i % 777 == 776) ? '\\' : 'a' + i % 26;
+
+    long_text[long_length] = 0;
+
+    doc = cfx2_new_node(NULL);
+
+    for (node = doc, i = 0; i < chain_depth; i++)
+    {
+        node = cfx2_create_child(node, "level", i == chain_depth / 2 ? long_text : NULL, cfx2_multiple);
+        tests_assert(node != NULL)
+    }
+
+    write_collected(doc, 0, &expected);
+
+    for (i = 1; i < num_buffer_sizes; i++)
+    {
+        write_collected(doc, (int) buffer_sizes[i], &collected);
+        tests_assert(collected.length == expected.length)
+        tests_assert(memcmp(collected.text, expected.text, collected.length) == 0)
+        tests_assert(collected.calls <= expected.calls)
+        free(collected.text);
+    }
+
+    write_collected(doc, -1, &collected);
+    tests_assert(collected.length == expected.length)
+    tests_assert(memcmp(collected.text, expected.text, collected.length) == 0)
+    tests_assert(collected.calls <= collected.length / 4096 + 1)
+    free(collected.text);
+
+    /* and it reads back (escape sequences are kept as written) */
+    expected.text = (char*) realloc(expected.text, expected.length + 1);
+    expected.text[expected.length] = 0;
+    tests_assert(cfx2_read_from_string(&doc2, expected.text, NULL) == cfx2_ok)
+
+    for (node = doc2, i = 0; i < chain_depth && node != NULL; i++)
+    {
+        node = cfx2_find_child(node, "level");
+        tests_assert(node != NULL && (node->text != NULL) == (i == chain_depth / 2))
+    }
+
+    cfx2_release_node(&doc2);
+    cfx2_release_node(&doc);
+    free(expected.text);
+    free(long_text);
+
+    return 0;
+}
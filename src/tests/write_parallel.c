@@ -0,0 +1,86 @@
+
+#include "tests.h"
+
+#include <string.h>
+
+#define small_count     3000
+
+static const unsigned thread_counts[] = { 2, 3, 8, 0 };
+
+#define num_thread_counts (sizeof(thread_counts) / sizeof(*thread_counts))
+
+static int collect_error(cfx2_WrOpt* wr_opt, int rc, int line, const char* desc)
+{
+    (void) rc;
+    (void) line;
+    (void) desc;
+
+    ((tests_Collected*) wr_opt->stream_priv)->errors++;
+    return 0;
+}
+
+/* num_threads 1: the sequential writer */
+static int write_collected(cfx2_Node* doc, unsigned num_threads, tests_Collected* collected)
+{
+    cfx2_WrOpt wr_opt;
+
+    tests_collect_output(&wr_opt, collected);
+    wr_opt.on_error = collect_error;
+
+    if (num_threads != 1)
+    {
+        wr_opt.flags |= cfx2_parallel_output;
+        wr_opt.num_threads = num_threads;
+    }
+
+    return cfx2_write(doc, &wr_opt);
+}
+
+static void compare_writers(cfx2_Node* doc, int expected_rc)
+{
+    tests_Collected expected, collected;
+    size_t i;
+
+    tests_assert(write_collected(doc, 1, &expected) == expected_rc)
+
+    for (i = 0; i < num_thread_counts; i++)
+    {
+        tests_assert(write_collected(doc, thread_counts[i], &collected) == expected_rc)
+        tests_assert(collected.length == expected.length)
+        tests_assert(collected.length == 0 || memcmp(collected.text, expected.text, collected.length) == 0)
+        tests_assert(collected.errors == expected.errors)
+        free(collected.text);
+    }
+
+    free(expected.text);
+}
+
+int write_parallel(void)
+{
+    cfx2_Node* doc, * node;
+
+    /* nothing, one and two top-level nodes */
+    doc = cfx2_new_node(NULL);
+    tests_assert(doc != NULL)
+    compare_writers(doc, cfx2_ok);
+
+    tests_assert(cfx2_create_child(doc, "first", NULL, cfx2_multiple) != NULL)
+    compare_writers(doc, cfx2_ok);
+
+    tests_assert(cfx2_create_child(doc, "second", "text", cfx2_multiple) != NULL)
+    compare_writers(doc, cfx2_ok);
+    cfx2_release_node(&doc);
+
+    /* many */
+    doc = tests_build_doc(small_count);
+    compare_writers(doc, cfx2_ok);
+
+    /* errors stop the output at the same place, reported once */
+    node = cfx2_item(doc->children, small_count / 2, cfx2_Node*);
+    tests_assert(cfx2_create_child(node, "", NULL, cfx2_multiple) != NULL)
+    tests_assert(cfx2_create_child(cfx2_item(doc->children, small_count - 1, cfx2_Node*), "", NULL, cfx2_multiple) != NULL)
+    compare_writers(doc, cfx2_missing_node_name);
+    cfx2_release_node(&doc);
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+
+#include "tests.h"
+
+#include <string.h>
+
+static const char* filenames[] =
+{
+    "unparent.cfx2",
+    "usertable.cfx2",
+    NULL
+};
+
+#define guard_byte  0x5A
+#define prefix      "prefix\n"
+
+static void check_document(cfx2_Node* doc, const char* filename)
+{
+    cfx2_MemoryStats stats;
+    char* text, * fixed;
+    size_t size, capacity, used, growths, step;
+
+    tests_assert_2(cfx2_measure_document(doc, &size) == cfx2_ok, filename)
+    tests_assert_2(size > 0, filename)
+
+    /* grown geometrically, in a few reallocations however the writer splits the output */
+    text = NULL;
+    capacity = 0;
+    used = 0;
+
+    for (growths = 0, step = 64; step < size; step *= 2)
+        growths++;
+
+    tests_assert_2(cfx2_enable_memory_stats(1) == cfx2_ok, filename)
+    tests_assert_2(cfx2_write_to_buffer(doc, &text, &capacity, &used) == cfx2_ok, filename)
+    tests_assert_2(used == size && capacity >= size, filename)
+
+    /* the writer's own buffer and stream, then the text */
+    tests_assert_2(cfx2_get_memory_stats(cfx2_mem_output, &stats) == cfx2_ok, filename)
+    tests_assert_2(stats.allocs + stats.reallocs <= 2 + 1 + growths, filename)
+    tests_assert_2(cfx2_enable_memory_stats(0) == cfx2_ok, filename)
+
+    free(text);
+    text = (char*) malloc(strlen(prefix));
+    memcpy(text, prefix, strlen(prefix));
+    capacity = strlen(prefix);
+    used = capacity;
+
+    tests_assert_2(cfx2_write_to_buffer(doc, &text, &capacity, &used) == cfx2_ok, filename)
+    tests_assert_2(used == strlen(prefix) + size && capacity >= used, filename)
+    tests_assert_2(memcmp(text, prefix, strlen(prefix)) == 0, filename)
+
+    /* fixed buffers: exact, too small by one byte and none at all */
+    fixed = (char*) malloc(size + 1);
+
+    memset(fixed, guard_byte, size + 1);
+    tests_assert_2(cfx2_write_to_fixed_buffer(doc, fixed, size, &used) == cfx2_ok, filename)
+    tests_assert_2(used == size, filename)
+    tests_assert_2(memcmp(fixed, text + strlen(prefix), size) == 0, filename)
+    tests_assert_2(fixed[size] == guard_byte, filename)
+
+    memset(fixed, guard_byte, size + 1);
+    tests_assert_2(cfx2_write_to_fixed_buffer(doc, fixed, size - 1, &used) == cfx2_buffer_overflow, filename)
+    tests_assert_2(used == size, filename)
+    tests_assert_2(memcmp(fixed, text + strlen(prefix), size - 1) == 0, filename)
+    tests_assert_2(fixed[size - 1] == guard_byte, filename)
+
+    tests_assert_2(cfx2_write_to_fixed_buffer(doc, NULL, 0, &used) == cfx2_buffer_overflow, filename)
+    tests_assert_2(used == size, filename)
+
+    free(fixed);
+    free(text);
+}
+
+int write_sizes(void)
+{
+    cfx2_Node* doc, * node;
+    size_t i, size, used;
+    char buffer[16], name[16];
+
+    for (i = 0; filenames[i] != NULL; i++)
+    {
+        doc = cfx2_load_document(filenames[i]);
+        tests_assert_2(doc != NULL, filenames[i])
+
+        check_document(doc, filenames[i]);
+        cfx2_release_node(&doc);
+    }
+
+    /* an empty document */
+    doc = cfx2_new_node(NULL);
+    tests_assert(cfx2_measure_document(doc, &size) == cfx2_ok && size == 0)
+    tests_assert(cfx2_write_to_fixed_buffer(doc, buffer, 0, &used) == cfx2_ok && used == 0)
+
+    /* a long attribute list */
+    node = cfx2_create_child(doc, "node", NULL, cfx2_multiple);
+    tests_assert(node != NULL)
+
+    for (i = 0; i < 10000; i++)
+    {
+        sprintf(name, "a%i", (int) i);
+        tests_assert(cfx2_set_node_attrib_int(node, name, (long) i) == cfx2_ok)
+    }
+
+    check_document(doc, "wide attribute list");
+    cfx2_release_node(&doc);
+
+    return 0;
+}
@@ -0,0 +1,209 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+#include "alloc.h"
+#include "thread.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+typedef struct
+{
+    cfx2_TaskFunc func;
+    char* tasks;
+    size_t task_size, num_tasks;
+
+    size_t next_task;
+
+#ifdef _WIN32
+    CRITICAL_SECTION lock;
+#else
+    pthread_mutex_t lock;
+#endif
+}
+TaskQueue_t;
+
+static int next_task( TaskQueue_t* queue, size_t* task )
+{
+    int have_task;
+
+#ifdef _WIN32
+    EnterCriticalSection( &queue->lock );
+#else
+    pthread_mutex_lock( &queue->lock );
+#endif
+
+    have_task = ( queue->next_task < queue->num_tasks );
+
+    if ( have_task )
+        *task = queue->next_task++;
+
+#ifdef _WIN32
+    LeaveCriticalSection( &queue->lock );
+#else
+    pthread_mutex_unlock( &queue->lock );
+#endif
+
+    return have_task;
+}
+
+static void run_queue( TaskQueue_t* queue )
+{
+    size_t task;
+
+    while ( next_task( queue, &task ) )
+        queue->func( queue->tasks + task * queue->task_size );
+}
+
+#ifdef _WIN32
+typedef HANDLE Thread_t;
+
+static DWORD WINAPI worker_main( LPVOID queue )
+{
+    run_queue( ( TaskQueue_t* )queue );
+    return 0;
+}
+
+static int start_thread( Thread_t* thread, TaskQueue_t* queue )
+{
+    *thread = CreateThread( NULL, 0, worker_main, queue, 0, NULL );
+    return *thread != NULL;
+}
+
+static void join_thread( Thread_t thread )
+{
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread );
+}
+
+unsigned cfx2_processor_count( void )
+{
+    SYSTEM_INFO info;
+
+    GetSystemInfo( &info );
+    return info.dwNumberOfProcessors > 0 ? ( unsigned ) info.dwNumberOfProcessors : 1;
+}
+#else
+typedef pthread_t Thread_t;
+
+static void* worker_main( void* queue )
+{
+    run_queue( ( TaskQueue_t* )queue );
+    return NULL;
+}
+
+static int start_thread( Thread_t* thread, TaskQueue_t* queue )
+{
+    return pthread_create( thread, NULL, worker_main, queue ) == 0;
+}
+
+static void join_thread( Thread_t thread )
+{
+    pthread_join( thread, NULL );
+}
+
+unsigned cfx2_processor_count( void )
+{
+    long count;
+
+    count = sysconf( _SC_NPROCESSORS_ONLN );
+    return count > 0 ? ( unsigned ) count : 1;
+}
+#endif
+
+void cfx2_run_tasks( cfx2_TaskFunc func, void* tasks, size_t task_size, size_t num_tasks, unsigned num_threads )
+{
+    TaskQueue_t queue;
+    Thread_t* threads;
+    unsigned i, started;
+
+    queue.func = func;
+    queue.tasks = ( char* )tasks;
+    queue.task_size = task_size;
+    queue.num_tasks = num_tasks;
+    queue.next_task = 0;
+
+    if ( num_threads > num_tasks )
+        num_threads = ( unsigned ) num_tasks;
+
+    threads = NULL;
+    started = 0;
+
+    if ( num_threads > 1 )
+        threads = ( Thread_t* )libcfx2_malloc( ( num_threads - 1 ) * sizeof( Thread_t ), cfx2_mem_other );
+
+#ifdef _WIN32
+    InitializeCriticalSection( &queue.lock );
+#else
+    pthread_mutex_init( &queue.lock, NULL );
+#endif
+
+    if ( threads != NULL )
+        for ( ; started < num_threads - 1; started++ )
+            if ( !start_thread( &threads[started], &queue ) )
+                break;
+
+    run_queue( &queue );
+
+    for ( i = 0; i < started; i++ )
+        join_thread( threads[i] );
+
+#ifdef _WIN32
+    DeleteCriticalSection( &queue.lock );
+#else
+    pthread_mutex_destroy( &queue.lock );
+#endif
+
+    libcfx2_free( threads );
+}
+
+#ifdef _WIN32
+static SRWLOCK global_lock = SRWLOCK_INIT;
+
+void cfx2_global_lock( void )
+{
+    AcquireSRWLockExclusive( &global_lock );
+}
+
+void cfx2_global_unlock( void )
+{
+    ReleaseSRWLockExclusive( &global_lock );
+}
+#else
+static pthread_mutex_t global_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void cfx2_global_lock( void )
+{
+    pthread_mutex_lock( &global_lock );
+}
+
+void cfx2_global_unlock( void )
+{
+    pthread_mutex_unlock( &global_lock );
+}
+#endif
@@ -0,0 +1,46 @@
+/*
+    Copyright (c) 2014 Xeatheran Minexew
+
+    This software is provided 'as-is', without any express or implied
+    warranty. In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+    claim that you wrote the original software. If you use this software
+    in a product, an acknowledgment in the product documentation would be
+    appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+    misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source
+    distribution.
+*/
+
+#ifndef libcfx2_thread_h
+#define libcfx2_thread_h
+
+#include <stddef.h>
+
+/*
+ *  Runs func on every task, on up to num_threads threads (the calling thread included).
+ *  Tasks are handed out in order, one at a time, so uneven tasks still balance.
+ *  Returns once all tasks are done. If no threads can be started, the calling thread
+ *  runs everything.
+ */
+typedef void ( *cfx2_TaskFunc )( void* task );
+
+void cfx2_run_tasks( cfx2_TaskFunc func, void* tasks, size_t task_size, size_t num_tasks, unsigned num_threads );
+
+/* the number of processors available (at least 1) */
+unsigned cfx2_processor_count( void );
+
+/* a lock for library-wide bookkeeping; not recursive */
+void cfx2_global_lock( void );
+void cfx2_global_unlock( void );
+
+#endif
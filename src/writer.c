@@ -21,125 +21,246 @@
     distribution.
 */
 
+#include "alloc.h"
+#include "config.h"
 #include "io.h"
 #include "lexer.h"
+#include "thread.h"
 
 #include <confix2.h>
 #include <stdio.h>
 #include <string.h>
 
-static char err_desc_buffer[200];
+/*
+ *  Output is collected in a buffer and handed to stream_write in large blocks;
+ *  without a buffer (capacity 0) every write goes straight to the stream.
+ *  Without a stream (wr_opt NULL) the buffer grows to hold all of the output.
+ */
+typedef struct
+{
+    cfx2_WrOpt* wr_opt;
+
+    char* buffer;
+    size_t capacity, used;
+
+    int failed;     /* the stream took less than it was given (or the buffer couldn't grow) */
+    char err_desc[200];
+}
+Output_t;
+
+static void out_init( Output_t* out, cfx2_WrOpt* wr_opt )
+{
+    out->wr_opt = wr_opt;
+    out->buffer = NULL;
+    out->capacity = 0;
+    out->used = 0;
+    out->failed = 0;
+}
+
+static int out_grow( Output_t* out, size_t length )
+{
+    char* buffer;
+    size_t capacity;
+
+    capacity = out->capacity * 2;
+
+    if ( capacity < out->used + length )
+        capacity = out->used + length;
+
+    if ( capacity < WRITER_BUFFER_SIZE )
+        capacity = WRITER_BUFFER_SIZE;
+
+    buffer = ( char* )libcfx2_realloc( out->buffer, capacity, cfx2_mem_output );
+
+    if ( buffer == NULL )
+    {
+        out->failed = 1;
+        return 0;
+    }
+
+    out->buffer = buffer;
+    out->capacity = capacity;
+    return 1;
+}
+
+static void out_stream( Output_t* out, const char* data, size_t length )
+{
+    if ( out->wr_opt->stream_write( out->wr_opt, data, length ) != length )
+        out->failed = 1;
+}
+
+static void out_flush( Output_t* out )
+{
+    if ( out->used > 0 )
+    {
+        out_stream( out, out->buffer, out->used );
+        out->used = 0;
+    }
+}
+
+static void out_write( Output_t* out, const char* data, size_t length )
+{
+    if ( length == 0 )
+        return;
+
+    if ( length > out->capacity - out->used )
+    {
+        if ( out->wr_opt == NULL )
+        {
+            if ( !out_grow( out, length ) )
+                return;
+        }
+        else
+        {
+            out_flush( out );
 
-static void write_string( const char* text, cfx2_WrOpt* wr_opt )
+            /* too big to be worth copying */
+            if ( length >= out->capacity )
+            {
+                out_stream( out, data, length );
+                return;
+            }
+        }
+    }
+
+    memcpy( out->buffer + out->used, data, length );
+    out->used += length;
+}
+
+static void out_char( Output_t* out, char c )
 {
-    wr_opt->stream_write( wr_opt, text, strlen( text ) );
+    if ( out->used < out->capacity )
+        out->buffer[out->used++] = c;
+    else
+        out_write( out, &c, 1 );
 }
 
-static void write_string_safe( const char* text, cfx2_WrOpt* wr_opt )
+static void write_indent( Output_t* out, unsigned depth )
 {
-    const static char apo = '\'', esc = '\\';
+    static const char spaces[] = "                                                                ";
+    size_t length;
 
-    wr_opt->stream_write( wr_opt, &apo, 1 );
+    for ( length = depth * 2; length > sizeof( spaces ) - 1; length -= sizeof( spaces ) - 1 )
+        out_write( out, spaces, sizeof( spaces ) - 1 );
 
-    while ( *text )
+    out_write( out, spaces, length );
+}
+
+static void write_string_safe( const char* text, Output_t* out )
+{
+    static const char apo = '\'', esc = '\\';
+    static const char special[] = { apo, esc, 0 };
+    size_t run;
+
+    out_char( out, apo );
+
+    for ( ; ; )
     {
-        if ( *text == apo || *text == esc )
-            wr_opt->stream_write( wr_opt, &esc, 1 );
+        /* copy everything up to the next character that needs escaping at once */
+        run = strcspn( text, special );
+        out_write( out, text, run );
+        text += run;
 
-        wr_opt->stream_write( wr_opt, text, 1 );
-        text++;
+        if ( *text == 0 )
+            break;
+
+        out_char( out, esc );
+        out_char( out, *text++ );
     }
 
-    wr_opt->stream_write( wr_opt, &apo, 1 );
+    out_char( out, apo );
 }
 
-static void write_string_escaped( const char* text, cfx2_WrOpt* wr_opt )
+static void write_string_escaped( const char* text, Output_t* out )
 {
     const char* text2;
 
     for ( text2 = text; *text2; text2++ )
         if ( !is_ident_char( *text2 ) )
         {
-            write_string_safe( text, wr_opt );
+            write_string_safe( text, out );
             return;
         }
 
-    write_string( text, wr_opt );
+    out_write( out, text, text2 - text );
 }
 
-static int write_node( cfx2_Node* node, unsigned depth, cfx2_WrOpt* wr_opt,
+static int write_node( cfx2_Node* node, unsigned depth, Output_t* out,
         cfx2_Node* parent, int is_last )
 {
     unsigned i;
     int rc;
 
-    for ( i = 0; i < depth; i++ )
-        wr_opt->stream_write( wr_opt, "  ", 2 );
+    write_indent( out, depth );
 
     if ( !node->name || !node->name[0] )
     {
         /* node name can't be empty except for the top node */
-        libcfx2_snprintf( err_desc_buffer, sizeof( err_desc_buffer ) / sizeof( *err_desc_buffer ),
+        libcfx2_snprintf( out->err_desc, sizeof( out->err_desc ) / sizeof( *out->err_desc ),
                 "Node name empty or not specified. Parent node: %s%s%s", parent ? "`" : "", parent ? parent->name : "document root", parent ? "`" : "" );
 
-        wr_opt->on_error( wr_opt, cfx2_missing_node_name, -1, err_desc_buffer );
+        /* without a stream, the error is reported by whoever collects the output */
+        if ( out->wr_opt != NULL )
+            out->wr_opt->on_error( out->wr_opt, cfx2_missing_node_name, -1, out->err_desc );
+
         return cfx2_missing_node_name;
     }
     else
     {
-        write_string_escaped( node->name, wr_opt );
+        write_string_escaped( node->name, out );
 
         if ( node->text )
         {
-            write_string( ": ", wr_opt );
-            write_string_safe( node->text, wr_opt );
+            out_write( out, ": ", 2 );
+            write_string_safe( node->text, out );
         }
 
         if ( cfx2_list_length( node->attributes ) > 0 )
         {
-            write_string( " (", wr_opt );
+            out_write( out, " (", 2 );
             for ( i = 0; i < cfx2_list_length( node->attributes ); i++ )
             {
-                write_string_escaped( cfx2_item( node->attributes, i, cfx2_Attrib ).name, wr_opt );
+                write_string_escaped( cfx2_item( node->attributes, i, cfx2_Attrib ).name, out );
 
                 /* FIXME: This must be asserted */
                 if ( cfx2_item( node->attributes, i, cfx2_Attrib ).value != NULL )
                 {
-                    write_string( ": ", wr_opt );
-                    write_string_safe( cfx2_item( node->attributes, i, cfx2_Attrib ).value, wr_opt );
+                    out_write( out, ": ", 2 );
+                    write_string_safe( cfx2_item( node->attributes, i, cfx2_Attrib ).value, out );
                 }
 
                 if ( i + 1 < cfx2_list_length( node->attributes ) )
-                    write_string( ", ", wr_opt );
+                    out_write( out, ", ", 2 );
             }
-            write_string( ")", wr_opt );
+            out_char( out, ')' );
         }
 
-        write_string( "\n", wr_opt );
+        out_char( out, '\n' );
 
         for ( i = 0; i < cfx2_list_length( node->children ); i++ )
         {
-            rc = write_node( cfx2_item( node->children, i, cfx2_Node* ), depth + 1, wr_opt, node, i >= cfx2_list_length( node->children ) - 1 );
+            rc = write_node( cfx2_item( node->children, i, cfx2_Node* ), depth + 1, out, node, i >= cfx2_list_length( node->children ) - 1 );
 
             if ( rc != 0 )
                 return rc;
         }
 
         if ( depth == 0 && !is_last )
-            write_string( "\n", wr_opt );
+            out_char( out, '\n' );
     }
 
     return cfx2_ok;
 }
 
-static int write_top_node( cfx2_WrOpt* wr_opt, cfx2_Node* doc )
+/* top-level nodes [first, end) of doc */
+static int write_nodes( Output_t* out, cfx2_Node* doc, size_t first, size_t end )
 {
-    unsigned i;
+    size_t i;
     int rc;
 
-    for ( i = 0; i < cfx2_list_length( doc->children ); i++ )
+    for ( i = first; i < end; i++ )
     {
-        rc = write_node( cfx2_item( doc->children, i, cfx2_Node* ), 0, wr_opt, 0, i >= cfx2_list_length( doc->children ) - 1 );
+        rc = write_node( cfx2_item( doc->children, i, cfx2_Node* ), 0, out, 0, i >= cfx2_list_length( doc->children ) - 1 );
 
         if ( rc != 0 )
             return rc;
@@ -148,13 +269,160 @@ static int write_top_node( cfx2_WrOpt* wr_opt, cfx2_Node* doc )
     return cfx2_ok;
 }
 
+/* -------------------------------------------------------------------------- */
+/*  Parallel Output                                                           */
+/* -------------------------------------------------------------------------- */
+
+/*
+ *  Runs of top-level nodes are written into separate growing buffers on worker threads,
+ *  a batch at a time, and the buffers are passed on in document order. Every node is
+ *  written exactly as by write_nodes (blank lines between top-level nodes included),
+ *  so the output is the same; on an error, it stops at the same place too.
+ */
+
+typedef struct
+{
+    cfx2_Node* doc;
+    size_t first, end;
+
+    Output_t out;
+    int rc;
+}
+WriteTask_t;
+
+static void write_task( void* task_ptr )
+{
+    WriteTask_t* task = ( WriteTask_t* )task_ptr;
+
+    task->rc = write_nodes( &task->out, task->doc, task->first, task->end );
+
+    if ( task->rc == cfx2_ok && task->out.failed )
+        task->rc = cfx2_alloc_error;
+}
+
+static int write_parallel( Output_t* out, cfx2_Node* doc, unsigned num_threads )
+{
+    WriteTask_t* tasks;
+    size_t num_nodes, nodes_per_task, batch_size, next, i, count;
+    int rc;
+
+    num_nodes = cfx2_list_length( doc->children );
+    nodes_per_task = num_nodes / ( num_threads * WRITER_TASKS_PER_THREAD ) + 1;
+    batch_size = num_threads * WRITER_BATCH_PER_THREAD;
+
+    tasks = ( WriteTask_t* )libcfx2_malloc( batch_size * sizeof( WriteTask_t ), cfx2_mem_output );
+
+    if ( tasks == NULL )
+        return write_nodes( out, doc, 0, num_nodes );
+
+    rc = cfx2_ok;
+
+    for ( next = 0; next < num_nodes && rc == cfx2_ok; )
+    {
+        for ( count = 0; count < batch_size && next < num_nodes; count++ )
+        {
+            tasks[count].doc = doc;
+            tasks[count].first = next;
+            tasks[count].end = ( num_nodes - next > nodes_per_task ) ? next + nodes_per_task : num_nodes;
+            out_init( &tasks[count].out, NULL );
+
+            next = tasks[count].end;
+        }
+
+        cfx2_run_tasks( write_task, tasks, sizeof( WriteTask_t ), count, num_threads );
+
+        for ( i = 0; i < count; i++ )
+        {
+            if ( rc == cfx2_ok )
+            {
+                out_write( out, tasks[i].out.buffer, tasks[i].out.used );
+                rc = tasks[i].rc;
+
+                if ( rc == cfx2_missing_node_name )
+                    out->wr_opt->on_error( out->wr_opt, rc, -1, tasks[i].out.err_desc );
+            }
+
+            libcfx2_free( tasks[i].out.buffer );
+        }
+    }
+
+    libcfx2_free( tasks );
+    return rc;
+}
+
 libcfx2 int cfx2_write( cfx2_Node* doc, cfx2_WrOpt* wr_opt )
 {
+    Output_t out;
+    unsigned num_threads;
     int rc;
 
-    rc = write_top_node( wr_opt, doc );
+    out_init( &out, wr_opt );
+    out.capacity = ( wr_opt->flags & cfx2_output_buffer_size ) ? wr_opt->buffer_size : WRITER_BUFFER_SIZE;
+
+    /* still correct (just slower) without the buffer */
+    if ( out.capacity > 0 && ( out.buffer = ( char* )libcfx2_malloc( out.capacity, cfx2_mem_output ) ) == NULL )
+        out.capacity = 0;
+
+    num_threads = 1;
+
+    if ( wr_opt->flags & cfx2_parallel_output )
+        num_threads = ( wr_opt->num_threads > 0 ) ? wr_opt->num_threads : cfx2_processor_count();
+
+    if ( num_threads > 1 && cfx2_list_length( doc->children ) > 1 )
+        rc = write_parallel( &out, doc, num_threads );
+    else
+        rc = write_nodes( &out, doc, 0, cfx2_list_length( doc->children ) );
+
+    out_flush( &out );
+
+    libcfx2_free( out.buffer );
+
     wr_opt->stream_close( wr_opt );
- 
+
+    if ( rc == cfx2_ok && out.failed )
+        return cfx2_write_error;
+
+    return rc;
+}
+
+libcfx2 int cfx2_measure_document( cfx2_Node* doc, size_t* size )
+{
+    cfx2_WrOpt wr_opt;
+    int rc;
+
+    *size = 0;
+
+    /* a fixed stream with no room only counts; no point buffering */
+    wr_opt.flags = cfx2_output_buffer_size;
+    wr_opt.buffer_size = 0;
+    rc = cfx2_fixed_stream( &wr_opt, NULL, 0, size );
+
+    if ( rc != 0 )
+        return rc;
+
+    return cfx2_write( doc, &wr_opt );
+}
+
+libcfx2 int cfx2_write_to_fixed_buffer( cfx2_Node* doc, char* buffer, size_t capacity, size_t* used )
+{
+    cfx2_WrOpt wr_opt;
+    int rc;
+
+    *used = 0;
+
+    /* output is copied straight into the caller's buffer */
+    wr_opt.flags = cfx2_output_buffer_size;
+    wr_opt.buffer_size = 0;
+    rc = cfx2_fixed_stream( &wr_opt, buffer, capacity, used );
+
+    if ( rc != 0 )
+        return rc;
+
+    rc = cfx2_write( doc, &wr_opt );
+
+    if ( rc == cfx2_ok && *used > capacity )
+        return cfx2_buffer_overflow;
+
     return rc;
 }
 
@@ -163,6 +431,8 @@ libcfx2 int cfx2_write_to_buffer( cfx2_Node* doc, char** text, size_t* capacity,
     cfx2_WrOpt wr_opt;
     int rc;
 
+    /* one pass: the writer's buffer batches the output, the stream grows geometrically */
+    wr_opt.flags = 0;
     rc = cfx2_memory_stream( &wr_opt, text, capacity, used );
 
     if ( rc != 0 )
@@ -176,6 +446,22 @@ libcfx2 int cfx2_save_document( cfx2_Node* doc, const char* filename )
     cfx2_WrOpt wr_opt;
     int rc;
 
+    wr_opt.flags = 0;
+    rc = cfx2_file_stream( &wr_opt, filename );
+
+    if ( rc != 0 )
+        return rc;
+
+    return cfx2_write( doc, &wr_opt );
+}
+
+libcfx2 int cfx2_save_document_parallel( cfx2_Node* doc, const char* filename, unsigned num_threads )
+{
+    cfx2_WrOpt wr_opt;
+    int rc;
+
+    wr_opt.flags = cfx2_parallel_output;
+    wr_opt.num_threads = num_threads;
     rc = cfx2_file_stream( &wr_opt, filename );
 
     if ( rc != 0 )